@@ -0,0 +1,62 @@
+// FILE: appendbench.cpp
+// PURPOSE: fields/sec of bulk addBits against a loop of single addBits calls
+
+#include <dynamicbitstring.h>
+#include <staticbitstring.h>
+#include "benchutil.h"
+
+#include <memory>
+#include <vector>
+#include <random>
+
+template<typename _C> void runAppend( const std::string &name, unsigned int nFields ) {
+    using Field = typename _C::Field;
+    std::mt19937 rng(42);
+    std::vector<Field> fields( nFields );
+    std::vector<unsigned int> values( nFields );
+    for( unsigned int i = 0; i < nFields; ++i ) {
+        fields[i] = Field{ static_cast<unsigned int>(rng()),
+                           static_cast<unsigned int>(1 + (rng() % 32)) };
+        values[i] = static_cast<unsigned int>(rng());
+    }
+    const unsigned int reps = 20;
+    // instances live on the heap, the static variant is too big for the stack
+
+    double t = lxbench::timeIt( reps, [&]() {
+        auto a = std::make_unique<_C>();
+        for( auto &f: fields ) {
+            a->addBits( f.value, f.nBits );
+        }
+        lxbench::keep( *a );
+    } );
+    lxbench::report( name + " single/variable", double(nFields) * reps, t, "fields" );
+
+    t = lxbench::timeIt( reps, [&]() {
+        auto a = std::make_unique<_C>();
+        a->addBits( fields );
+        lxbench::keep( *a );
+    } );
+    lxbench::report( name + " bulk/variable", double(nFields) * reps, t, "fields" );
+
+    t = lxbench::timeIt( reps, [&]() {
+        auto a = std::make_unique<_C>();
+        for( auto v: values ) {
+            a->addBits( v, 13 );
+        }
+        lxbench::keep( *a );
+    } );
+    lxbench::report( name + " single/fixed13", double(nFields) * reps, t, "fields" );
+
+    t = lxbench::timeIt( reps, [&]() {
+        auto a = std::make_unique<_C>();
+        a->addBits( values, 13 );
+        lxbench::keep( *a );
+    } );
+    lxbench::report( name + " bulk/fixed13", double(nFields) * reps, t, "fields" );
+}
+
+int main() {
+    runAppend< lxutil::dynamicbitstring<> >( "dynamic", 1000000 );
+    runAppend< lxutil::staticbitstring<32 * 1000000> >( "static", 1000000 );
+    return 0;
+}
@@ -0,0 +1,68 @@
+// FILE: arenabench.cpp
+// PURPOSE: per-request build and teardown of a few thousand bitstrings,
+//          default allocator against a monotonic arena (pmr) that is
+//          released in one go at the end of each request
+
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <memory_resource>
+#include <random>
+#include <vector>
+#include <string>
+
+// one request: build nStrings bitstrings, combine them a bit, drop them all
+template<typename _Strings> unsigned long long request( _Strings &strings, unsigned int seed ) {
+    const unsigned int nStrings = 2000;
+    std::minstd_rand rng( seed );
+    strings.reserve( nStrings );
+    for( unsigned int i = 0; i < nStrings; ++i ) {
+        strings.emplace_back();
+        unsigned int nWords = 2 + (rng() % 14);
+        for( unsigned int w = 0; w < nWords; ++w ) {
+            strings.back().addBits( static_cast<unsigned int>(rng()), 32 );
+        }
+    }
+    unsigned long long sum = 0;
+    for( unsigned int i = 1; i < nStrings; ++i ) {
+        strings[i] ^= strings[i - 1];
+        sum += strings[i].read( 0, 32 );
+    }
+    return sum;
+}
+
+int main() {
+    const unsigned int nRequests = 2000;
+    unsigned long long sum = 0;
+
+    double t = lxbench::timeIt( 1, [&]() {
+        for( unsigned int r = 0; r < nRequests; ++r ) {
+            std::vector< lxutil::dynamicbitstring<> > strings;
+            sum += request( strings, r );
+        }
+    } );
+    lxbench::report( "default allocator", nRequests, t, "requests" );
+
+    t = lxbench::timeIt( 1, [&]() {
+        for( unsigned int r = 0; r < nRequests; ++r ) {
+            std::pmr::unsynchronized_pool_resource pool;
+            std::pmr::vector< lxutil::pmr_dynamicbitstring<> > strings( &pool );
+            sum += request( strings, r );
+        }
+    } );
+    lxbench::report( "pmr pool per request", nRequests, t, "requests" );
+
+    // the arena's first buffer is reused by every request
+    std::vector<std::byte> buffer( 1 << 20 );
+    t = lxbench::timeIt( 1, [&]() {
+        for( unsigned int r = 0; r < nRequests; ++r ) {
+            std::pmr::monotonic_buffer_resource arena( buffer.data(), buffer.size() );
+            std::pmr::vector< lxutil::pmr_dynamicbitstring<> > strings( &arena );
+            sum += request( strings, r );
+        }
+    } );
+    lxbench::report( "monotonic arena", nRequests, t, "requests" );
+
+    lxbench::keep( sum );
+    return 0;
+}
@@ -0,0 +1,77 @@
+// FILE: atomicbench.cpp
+// PURPOSE: worker threads marking items done in a shared 16M bit map:
+//          a dynamicbitstring behind a mutex against atomic_bitstring,
+//          at 1 to 8 threads
+
+#include <atomic_bitstring.h>
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+    const unsigned int nBits = 1u << 24;
+    const unsigned int perThread = 2000000;
+    std::vector<unsigned int> items( perThread * 8 );
+    std::mt19937 rng(42);
+    for( auto &i: items ) {
+        i = rng() % nBits;
+    }
+
+    // fn( thread number ) on n threads at once
+    auto onThreads = []( unsigned int n, auto &&fn ) {
+        std::vector<std::thread> pool;
+        for( unsigned int t = 0; t < n; ++t ) {
+            pool.emplace_back( fn, t );
+        }
+        for( auto &th: pool ) {
+            th.join();
+        }
+    };
+
+    for( unsigned int nThreads: { 1u, 2u, 4u, 8u } ) {
+        std::string threads = std::to_string( nThreads ) + " threads";
+        lxutil::dynamicbitstring< std::vector<uint64_t> > locked;
+        locked.resize( nBits );
+        std::mutex mutex;
+        double t = lxbench::timeIt( 1, [&]() {
+            onThreads( nThreads, [&]( unsigned int th ) {
+                for( unsigned int i = th * perThread; i < (th + 1) * perThread; ++i ) {
+                    std::lock_guard<std::mutex> hold( mutex );
+                    locked.write( 1, items[i], 1 );
+                }
+            } );
+        } );
+        lxbench::report( "mutex set, " + threads, double(perThread) * nThreads, t, "bits" );
+
+        lxutil::atomic_bitstring<> shared( nBits );
+        t = lxbench::timeIt( 1, [&]() {
+            onThreads( nThreads, [&]( unsigned int th ) {
+                for( unsigned int i = th * perThread; i < (th + 1) * perThread; ++i ) {
+                    shared.setBit( items[i], std::memory_order_relaxed );
+                }
+            } );
+        } );
+        lxbench::report( "atomic set, " + threads, double(perThread) * nThreads, t, "bits" );
+
+        // claiming items: each is handed out once however many ask
+        shared.clear();
+        std::atomic<unsigned int> claimed( 0 );
+        t = lxbench::timeIt( 1, [&]() {
+            onThreads( nThreads, [&]( unsigned int th ) {
+                unsigned int mine = 0;
+                for( unsigned int i = th * perThread; i < (th + 1) * perThread; ++i ) {
+                    mine += !shared.testAndSet( items[i] );
+                }
+                claimed += mine;
+            } );
+        } );
+        lxbench::report( "atomic testAndSet, " + threads, double(perThread) * nThreads, t, "bits" );
+        lxbench::keep( claimed );
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// FILE: benchutil.h
+// PURPOSE: tiny timing helpers shared by the bitstring benchmarks.
+//          No dependencies beyond the standard library.
+//
+// OUTPUT: report() prints a line of text, or with LXBENCH_FORMAT=csv
+//          (or json) in the environment a CSV row (a JSON object per
+//          line), so runs of any benchmark can be diffed between commits.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <stdlib.h> // getenv
+#include <string.h> // strcmp
+
+namespace lxbench {
+
+// keeps the optimizer from throwing away a result
+template<typename _T> inline void keep( const _T &value ) {
+    asm volatile( "" : : "g"(&value) : "memory" );
+}
+
+// runs fn() reps times, returns elapsed seconds
+template<typename _Fn> double timeIt( unsigned int reps, _Fn &&fn ) {
+    auto start = std::chrono::steady_clock::now();
+    for( unsigned int r = 0; r < reps; ++r ) {
+        fn();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// seconds per call of fn(): calls are batched until a batch takes
+// minSeconds, and the best of rounds batches is kept
+template<typename _Fn> double measure( _Fn &&fn, double minSeconds = 0.05, unsigned int rounds = 3 ) {
+    unsigned long long batch = 1;
+    double t = timeIt( 1, fn );
+    while( t < minSeconds ) {
+        batch = ( t > 0 ) ? (unsigned long long)( batch * (minSeconds / t) * 1.2 ) + 1 : batch * 10;
+        t = timeIt( (unsigned int)batch, fn );
+    }
+    double best = t / batch;
+    for( unsigned int r = 1; r < rounds; ++r ) {
+        t = timeIt( (unsigned int)batch, fn ) / batch;
+        best = ( t < best ) ? t : best;
+    }
+    return best;
+}
+
+enum class Format { Text, Csv, Json };
+
+inline Format &formatRef() {
+    static Format format = []() {
+        const char *f = getenv( "LXBENCH_FORMAT" );
+        if( f && strcmp( f, "csv" ) == 0 ) return Format::Csv;
+        if( f && strcmp( f, "json" ) == 0 ) return Format::Json;
+        return Format::Text;
+    }();
+    return format;
+}
+
+// how report() prints, LXBENCH_FORMAT unless set here
+inline Format format() {
+    return formatRef();
+}
+inline void setFormat( Format f ) {
+    formatRef() = f;
+}
+
+inline void report( const std::string &name, double items, double seconds,
+                    const std::string &unit = "items" ) {
+    switch( format() ) {
+    case Format::Csv: {
+        static bool header = false;
+        if( !header ) {
+            std::cout << "name,rate,unit,seconds" << std::endl;
+            header = true;
+        }
+        std::cout << '"' << name << "\"," << (items / seconds) << "," << unit << "/sec,"
+                  << seconds << std::endl;
+        break;
+    }
+    case Format::Json:
+        std::cout << "{\"name\": \"" << name << "\", \"rate\": " << (items / seconds)
+                  << ", \"unit\": \"" << unit << "/sec\", \"seconds\": " << seconds << "}" << std::endl;
+        break;
+    default:
+        std::cout << name << ": " << (items / seconds) << " " << unit << "/sec"
+                  << " (" << seconds << " s)" << std::endl;
+        break;
+    }
+}
+
+} // namespace lxbench
@@ -0,0 +1,72 @@
+// FILE: blockbench.cpp
+// PURPOSE: the same work over every block width (8 to 128 bits):
+//          append, read, compare and logical ops on 1M bit strings
+
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <random>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+template<typename _BlockType> void run( const std::string &width ) {
+    using Bits = lxutil::dynamicbitstring< std::vector<_BlockType> >;
+    const unsigned int nBits = 1 << 20;
+    const unsigned int fieldBits = 7; // fits every width
+    std::mt19937 rng(42);
+    std::vector<unsigned int> fields( nBits / fieldBits );
+    for( auto &f: fields ) {
+        f = static_cast<unsigned int>(rng()) & 0x7F;
+    }
+
+    Bits a, b;
+    double t = lxbench::timeIt( 1, [&]() {
+        for( auto f: fields ) {
+            a.addBits( _BlockType(f), fieldBits );
+        }
+    } );
+    lxbench::report( width + " append", double(fields.size()), t, "fields" );
+    b = a;
+
+    unsigned long long sum = 0;
+    t = lxbench::timeIt( 5, [&]() {
+        for( unsigned int pos = 0; pos + 32 <= a.sizeInBits(); pos += 32 ) {
+            sum += uint64_t( a.read( pos, 32 ) );
+        }
+    } );
+    lxbench::report( width + " read 32", 5.0 * (a.sizeInBits() / 32), t, "reads" );
+
+    t = lxbench::timeIt( 5, [&]() {
+        for( unsigned int pos = 0; pos + 64 <= a.sizeInBits(); pos += 61 ) {
+            sum += uint64_t( a.read( pos, 64 ) );
+        }
+    } );
+    lxbench::report( width + " read 64", 5.0 * (a.sizeInBits() / 61), t, "reads" );
+
+    t = lxbench::timeIt( 100, [&]() {
+        sum += (a == b);
+        sum += (a < b);
+    } );
+    lxbench::report( width + " compare", 200.0 * a.sizeInBits() / 8, t, "bytes" );
+
+    t = lxbench::timeIt( 100, [&]() {
+        a ^= b;
+        a |= b;
+        a &= b;
+    } );
+    lxbench::report( width + " logic", 300.0 * a.sizeInBits() / 8, t, "bytes" );
+    lxbench::keep( sum );
+    lxbench::keep( a );
+}
+
+int main() {
+    run<unsigned char>( "8" );
+    run<unsigned short>( "16" );
+    run<unsigned int>( "32" );
+    run<uint64_t>( "64" );
+#ifdef __SIZEOF_INT128__
+    run<unsigned __int128>( "128" );
+#endif
+    return 0;
+}
@@ -0,0 +1,99 @@
+// FILE: codesbench.cpp
+// PURPOSE: integers/sec of bitstring_codes.h encoding and decoding, for
+//          each code, on 1M values of 1 to 20 bits (log-uniform, as gaps
+//          of a posting list come). Gamma is also run the hand-rolled way,
+//          addBits and read(pos, 1) a bit at a time, for comparison
+
+#include <bitstring_codes.h>
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace {
+
+const unsigned int nValues = 1000000;
+
+template<typename _Bits, lxutil::codes::code _Code>
+void runCode( const std::string &name, const std::vector<uint64_t> &values, unsigned int k = 0 ) {
+    using namespace lxutil::codes;
+    _Bits bits;
+    double t = lxbench::measure( [&]() {
+        bits.clear();
+        encode<_Code>( bits, std::span<const uint64_t>( values ), k );
+        lxbench::keep( bits );
+    } );
+    lxbench::report( name + " encode", nValues, t, "integers" );
+
+    std::vector<uint64_t> out( values.size() );
+    t = lxbench::measure( [&]() {
+        lxbench::keep( decode<_Code>( bits, std::span<uint64_t>( out ), k ) );
+    } );
+    lxbench::report( name + " decode", nValues, t, "integers" );
+    if( out != values ) {
+        std::cout << name << ": decoded values differ" << std::endl;
+    }
+}
+
+// gamma one bit at a time, the way it is done without a coding layer
+template<typename _Bits> void runBitAtATime( const std::string &name, const std::vector<uint64_t> &values ) {
+    _Bits bits;
+    double t = lxbench::measure( [&]() {
+        bits.clear();
+        for( uint64_t v: values ) {
+            unsigned int n = 63 - __builtin_clzll( v );
+            for( unsigned int i = 0; i < n; ++i ) {
+                bits.addBits( 0, 1 );
+            }
+            for( int i = n; i >= 0; --i ) {
+                bits.addBits( (v >> i) & 1, 1 );
+            }
+        }
+        lxbench::keep( bits );
+    } );
+    lxbench::report( name + " encode, bit at a time", nValues, t, "integers" );
+
+    std::vector<uint64_t> out( values.size() );
+    t = lxbench::measure( [&]() {
+        unsigned int pos = 0;
+        for( auto &v: out ) {
+            unsigned int n = 0;
+            while( bits.read( pos++, 1 ) == 0 ) {
+                ++n;
+            }
+            v = 1;
+            for( unsigned int i = 0; i < n; ++i ) {
+                v = (v << 1) | bits.read( pos++, 1 );
+            }
+        }
+        lxbench::keep( out );
+    } );
+    lxbench::report( name + " decode, bit at a time", nValues, t, "integers" );
+}
+
+template<typename _Bits> void runBlocks( const std::string &blocks ) {
+    using lxutil::codes::code;
+    std::mt19937_64 rng( 42 );
+    std::vector<uint64_t> values( nValues );
+    for( auto &v: values ) {
+        unsigned int nBits = 1 + rng() % 20;
+        v = ( rng() & ((uint64_t(1) << nBits) - 1) ) | (uint64_t(1) << (nBits - 1));
+    }
+    runCode<_Bits, code::Gamma>( blocks + " gamma", values );
+    runCode<_Bits, code::Delta>( blocks + " delta", values );
+    runCode<_Bits, code::Rice>( blocks + " rice(k=16)", values, 16 );
+    runCode<_Bits, code::Leb128>( blocks + " leb128", values );
+    runBitAtATime<_Bits>( blocks + " gamma", values );
+}
+
+} // namespace
+
+int main() {
+    runBlocks< lxutil::dynamicbitstring<> >( "32 bit blocks" );
+    runBlocks< lxutil::dynamicbitstring< std::vector<uint64_t> > >( "64 bit blocks" );
+    return 0;
+}
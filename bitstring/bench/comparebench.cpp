@@ -0,0 +1,49 @@
+// FILE: comparebench.cpp
+// PURPOSE: blocks/sec of <, == and commonPrefixLength on long strings
+//          that only differ near the end, at every SIMD level the CPU
+//          supports, against a block at a time loop
+
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <random>
+#include <string>
+
+int main() {
+    const unsigned int nBlocks = 50000;
+    const unsigned int reps = 2000;
+    std::mt19937 rng(42);
+    lxutil::dynamicbitstring<> a;
+    for( unsigned int i = 0; i < nBlocks; ++i ) {
+        a.addBits( static_cast<unsigned int>(rng()), 32 );
+    }
+    lxutil::dynamicbitstring<> b( a );
+    b.write( a.bitAt( 32 * nBlocks - 40 ) ? 0 : 1, 32 * nBlocks - 40, 1 );
+
+    unsigned long long sum = 0;
+    double t = lxbench::timeIt( reps, [&]() {
+        const unsigned int *x = a.data();
+        const unsigned int *y = b.data();
+        unsigned int i = 0;
+        while( (i < nBlocks) && (x[i] == y[i]) ) {
+            ++i;
+        }
+        sum += i;
+    } );
+    lxbench::report( "block loop", double(nBlocks) * reps, t, "blocks" );
+
+    const char *names[] = { "scalar", "sse2", "avx2", "avx512" };
+    auto detected = lxutil::simd::detectedLevel();
+    for( int l = 0; l <= static_cast<int>(detected); ++l ) {
+        lxutil::simd::setLevel( static_cast<lxutil::simd::Level>(l) );
+        std::string name = names[l];
+        t = lxbench::timeIt( reps, [&]() { sum += (a < b); } );
+        lxbench::report( name + " <", double(nBlocks) * reps, t, "blocks" );
+        t = lxbench::timeIt( reps, [&]() { sum += (a == b); } );
+        lxbench::report( name + " ==", double(nBlocks) * reps, t, "blocks" );
+        t = lxbench::timeIt( reps, [&]() { sum += lxutil::commonPrefixLength( a, b ); } );
+        lxbench::report( name + " commonPrefixLength", double(nBlocks) * reps, t, "blocks" );
+    }
+    lxbench::keep( sum );
+    return 0;
+}
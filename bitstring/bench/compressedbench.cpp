@@ -0,0 +1,91 @@
+// FILE: compressedbench.cpp
+// PURPOSE: compressedbitmap against a plain dynamicbitstring on 256M bit
+//          membership bitmaps: sparse (1 in 10000), dense (half, at
+//          random) and clustered (runs of ids). Memory of each, then
+//          &=, |=, ^= and countOnes throughput, and conversion
+
+#include <compressedbitmap.h>
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Plain = lxutil::dynamicbitstring<>;
+const unsigned int nBits = 1u << 28;
+
+// the ones of a pattern; each pattern makes two different bitmaps
+Plain make( const std::string &pattern, unsigned int seed ) {
+    std::mt19937 rng( seed );
+    Plain bits;
+    bits.resize( nBits );
+    if( pattern == "sparse" ) {
+        for( unsigned int i = 0; i < nBits / 10000; ++i ) {
+            bits.write( 1, rng() % nBits, 1 );
+        }
+    } else if( pattern == "dense" ) {
+        for( unsigned int pos = 0; pos < nBits; pos += 32 ) {
+            bits.write( rng(), pos, 32 );
+        }
+    } else {
+        // runs of 1 to 4096 ids, gaps of up to 64K
+        for( unsigned int pos = rng() % 65536; pos < nBits; ) {
+            unsigned int length = 1 + rng() % 4096;
+            for( unsigned int i = 0; (i < length) && (pos < nBits); ++i, ++pos ) {
+                bits.write( 1, pos, 1 );
+            }
+            pos += rng() % 65536;
+        }
+    }
+    return bits;
+}
+
+void runPattern( const std::string &pattern ) {
+    Plain a = make( pattern, 1 );
+    Plain b = make( pattern, 2 );
+    lxutil::compressedbitmap ca( a );
+    lxutil::compressedbitmap cb( b );
+    const double bytes = nBits / 8.0;
+
+    std::cout << pattern << " memory: plain " << (a.sizeInBlocks() * sizeof(Plain::BlockType))
+              << " bytes, compressed " << ca.bytesUsed() << " bytes" << std::endl;
+
+    Plain x;
+    double t = lxbench::measure( [&]() { x = a; x &= b; } );
+    lxbench::report( pattern + " and, plain", bytes, t, "bytes" );
+    lxutil::compressedbitmap cx;
+    t = lxbench::measure( [&]() { cx = ca; cx &= cb; } );
+    lxbench::report( pattern + " and, compressed", bytes, t, "bytes" );
+
+    t = lxbench::measure( [&]() { x = a; x |= b; } );
+    lxbench::report( pattern + " or, plain", bytes, t, "bytes" );
+    t = lxbench::measure( [&]() { cx = ca; cx |= cb; } );
+    lxbench::report( pattern + " or, compressed", bytes, t, "bytes" );
+
+    t = lxbench::measure( [&]() { x = a; x ^= b; } );
+    lxbench::report( pattern + " xor, plain", bytes, t, "bytes" );
+    t = lxbench::measure( [&]() { cx = ca; cx ^= cb; } );
+    lxbench::report( pattern + " xor, compressed", bytes, t, "bytes" );
+
+    t = lxbench::measure( [&]() { lxbench::keep( a.countOnes() ); } );
+    lxbench::report( pattern + " countOnes, plain", bytes, t, "bytes" );
+    t = lxbench::measure( [&]() { lxbench::keep( ca.countOnes() ); } );
+    lxbench::report( pattern + " countOnes, compressed", bytes, t, "bytes" );
+
+    t = lxbench::measure( [&]() { lxutil::compressedbitmap c( a ); lxbench::keep( c ); } );
+    lxbench::report( pattern + " from bitstring", bytes, t, "bytes" );
+    t = lxbench::measure( [&]() { ca.toBits( x ); lxbench::keep( x ); } );
+    lxbench::report( pattern + " to bitstring", bytes, t, "bytes" );
+}
+
+} // namespace
+
+int main() {
+    for( const char *pattern: { "sparse", "dense", "clustered" } ) {
+        runPattern( pattern );
+    }
+    return 0;
+}
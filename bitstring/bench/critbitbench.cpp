@@ -0,0 +1,106 @@
+// FILE: critbitbench.cpp
+// PURPOSE: critbitmap against std::map keyed on bitstring, 1M keys
+//          with long shared prefixes: insert, lookup, ordered walk,
+//          and a prefix query
+
+#include <dynamicbitstring.h>
+#include <critbitmap.h>
+#include "benchutil.h"
+
+#include <map>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+int main() {
+    using Key = lxutil::dynamicbitstring<>;
+    const unsigned int nKeys = 1000000;
+    std::mt19937 rng(42);
+    std::vector<Key> keys( nKeys );
+    for( auto &k: keys ) {
+        // shared prefixes, like routing keys
+        k.addBits( static_cast<unsigned int>(rng() % 16), 32 );
+        k.addBits( static_cast<unsigned int>(rng()), 32 );
+        k.addBits( static_cast<unsigned int>(rng()), 1 + (rng() % 32) );
+    }
+
+    std::map<Key, unsigned int> ordered;
+    double t = lxbench::timeIt( 1, [&]() {
+        unsigned int v = 0;
+        for( auto &k: keys ) {
+            ordered.emplace( k, v++ );
+        }
+    } );
+    lxbench::report( "std::map insert", nKeys, t, "keys" );
+
+    lxutil::critbitmap<Key, unsigned int> tree;
+    t = lxbench::timeIt( 1, [&]() {
+        unsigned int v = 0;
+        for( auto &k: keys ) {
+            tree.insert( k, v++ );
+        }
+    } );
+    lxbench::report( "critbitmap insert", nKeys, t, "keys" );
+
+    std::shuffle( keys.begin(), keys.end(), rng );
+    unsigned long long sum = 0;
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: keys ) {
+            sum += ordered.find( k )->second;
+        }
+    } );
+    lxbench::report( "std::map find", nKeys, t, "keys" );
+
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: keys ) {
+            sum += tree.find( k )->second;
+        }
+    } );
+    lxbench::report( "critbitmap find", nKeys, t, "keys" );
+
+    t = lxbench::timeIt( 5, [&]() {
+        for( auto &kv: ordered ) {
+            sum += kv.second;
+        }
+    } );
+    lxbench::report( "std::map walk", double(nKeys) * 5, t, "keys" );
+
+    t = lxbench::timeIt( 5, [&]() {
+        for( auto &kv: tree ) {
+            sum += kv.second;
+        }
+    } );
+    lxbench::report( "critbitmap walk", double(nKeys) * 5, t, "keys" );
+
+    // every key under a 40 bit prefix: lower_bound and scan against prefixRange
+    std::vector<Key> prefixes( 10000 );
+    for( unsigned int i = 0; i < prefixes.size(); ++i ) {
+        prefixes[i].addBits( keys[i].read( 0, 32 ), 32 );
+        prefixes[i].addBits( keys[i].read( 32, 8 ), 8 );
+    }
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &p: prefixes ) {
+            for( auto it = ordered.lower_bound( p ); it != ordered.end(); ++it ) {
+                if( it->first.sizeInBits() < 40 || it->first.read( 0, 32 ) != p.read( 0, 32 ) ||
+                    it->first.read( 32, 8 ) != p.read( 32, 8 ) ) {
+                    break;
+                }
+                sum += it->second;
+            }
+        }
+    } );
+    lxbench::report( "std::map prefix", double(prefixes.size()), t, "queries" );
+
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &p: prefixes ) {
+            auto range = tree.prefixRange( p );
+            for( auto it = range.first; it != range.second; ++it ) {
+                sum += it->second;
+            }
+        }
+    } );
+    lxbench::report( "critbitmap prefix", double(prefixes.size()), t, "queries" );
+
+    lxbench::keep( sum );
+    return 0;
+}
@@ -0,0 +1,77 @@
+// FILE: exprbench.cpp
+// PURPOSE: a four bitmap filter, (a & b) | (c & ~d), one operator at a
+//          time on a copy against a fused bitstring_expr.h expression,
+//          and counting its ones without storing it, at 64K and 64M bits
+
+#include <bitstring_expr.h>
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace {
+
+using Bits = lxutil::dynamicbitstring< std::vector<uint64_t> >;
+
+Bits random( unsigned int nBits, uint64_t seed ) {
+    Bits bits;
+    bits.loadBlocks( nBits, [&]( uint64_t *blocks, unsigned int n ) {
+        for( unsigned int i = 0; i < n; ++i ) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            blocks[i] = seed;
+        }
+    } );
+    return bits;
+}
+
+void runSize( unsigned int nBits ) {
+    Bits a = random( nBits, 1 );
+    Bits b = random( nBits, 2 );
+    Bits c = random( nBits, 3 );
+    Bits d = random( nBits, 4 );
+    const double bytes = nBits / 8.0;
+    std::string size = ", " + std::to_string( nBits ) + " bits";
+
+    Bits r;
+    Bits t;
+    double s = lxbench::measure( [&]() {
+        r = a;
+        r &= b;
+        t = c;
+        t.andNot( d );
+        r |= t;
+        lxbench::keep( r );
+    } );
+    lxbench::report( "operator at a time" + size, bytes, s, "bytes" );
+
+    s = lxbench::measure( [&]() {
+        r = (lxutil::lazy( a ) & b) | (lxutil::lazy( c ) & ~lxutil::lazy( d ));
+        lxbench::keep( r );
+    } );
+    lxbench::report( "fused" + size, bytes, s, "bytes" );
+
+    s = lxbench::measure( [&]() {
+        r = a;
+        r &= b;
+        t = c;
+        t.andNot( d );
+        r |= t;
+        lxbench::keep( r.countOnes() );
+    } );
+    lxbench::report( "count, operator at a time" + size, bytes, s, "bytes" );
+
+    s = lxbench::measure( [&]() {
+        lxbench::keep( ((lxutil::lazy( a ) & b) | (lxutil::lazy( c ) & ~lxutil::lazy( d ))).countOnes() );
+    } );
+    lxbench::report( "count, fused" + size, bytes, s, "bytes" );
+}
+
+} // namespace
+
+int main() {
+    runSize( 1u << 16 );
+    runSize( 1u << 26 );
+    return 0;
+}
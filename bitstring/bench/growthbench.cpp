@@ -0,0 +1,74 @@
+// FILE: growthbench.cpp
+// PURPOSE: the growth policies side by side: appending 7 bit fields to
+//          an empty string, with and without reserveBits() first, and a
+//          string growing and shrinking by turns. Each row also prints
+//          the reallocations counted and the capacity left at the end
+
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// small enough for exact, which copies the whole string on every new block
+const unsigned int nFields = 100000;
+
+template<typename _Policy> void runPolicy( const std::string &name ) {
+    using Counted = lxutil::growth::counting<_Policy>;
+    using Bits = lxutil::dynamicbitstring< std::vector<unsigned int>, Counted >;
+    const unsigned int reps = 10;
+    unsigned int capacity = 0;
+
+    Counted::reset();
+    double t = lxbench::timeIt( reps, [&]() {
+        Bits a;
+        for( unsigned int i = 0; i < nFields; ++i ) {
+            a.addBits( i, 7 );
+        }
+        capacity = a.capacityInBlocks();
+        lxbench::keep( a );
+    } );
+    lxbench::report( name + " append", double(nFields) * reps, t, "fields" );
+    std::cout << name << " append: " << Counted::counts().grows.load() / reps << " grows, "
+              << capacity << " blocks of capacity" << std::endl;
+
+    Counted::reset();
+    t = lxbench::timeIt( reps, [&]() {
+        Bits a;
+        a.reserveBits( nFields * 7 );
+        for( unsigned int i = 0; i < nFields; ++i ) {
+            a.addBits( i, 7 );
+        }
+        capacity = a.capacityInBlocks();
+        lxbench::keep( a );
+    } );
+    lxbench::report( name + " append, reserved", double(nFields) * reps, t, "fields" );
+    std::cout << name << " append, reserved: " << Counted::counts().grows.load() / reps << " grows, "
+              << capacity << " blocks of capacity" << std::endl;
+
+    // a work buffer: filled to a varying length, then cut back
+    Counted::reset();
+    Bits a;
+    t = lxbench::timeIt( reps, [&]() {
+        for( unsigned int round = 0; round < 100; ++round ) {
+            a.resize( (round % 10 == 0) ? 1000000 : 1000 * (1 + round % 10) );
+            a.resize( 100 );
+        }
+        lxbench::keep( a );
+    } );
+    lxbench::report( name + " grow/shrink", 200.0 * reps, t, "resizes" );
+    std::cout << name << " grow/shrink: " << (Counted::counts().grows.load() +
+                                              Counted::counts().shrinks.load()) / reps
+              << " reallocations, " << a.capacityInBlocks() << " blocks of capacity" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    runPolicy<lxutil::growth::nevershrink>( "nevershrink" );
+    runPolicy<lxutil::growth::geometric>( "geometric" );
+    runPolicy<lxutil::growth::exact>( "exact" );
+    return 0;
+}
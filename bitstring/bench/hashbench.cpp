@@ -0,0 +1,70 @@
+// FILE: hashbench.cpp
+// PURPOSE: std::map against std::unordered_map keyed on bitstring,
+//          1M keys, insert and lookup
+
+#include <dynamicbitstring.h>
+#include <bitstring_hash.h>
+#include "benchutil.h"
+
+#include <map>
+#include <unordered_map>
+#include <random>
+#include <vector>
+
+int main() {
+    using Key = lxutil::dynamicbitstring<>;
+    const unsigned int nKeys = 1000000;
+    std::mt19937 rng(42);
+    std::vector<Key> keys( nKeys );
+    for( auto &k: keys ) {
+        // shared prefixes, like routing keys
+        k.addBits( static_cast<unsigned int>(rng() % 16), 32 );
+        k.addBits( static_cast<unsigned int>(rng()), 32 );
+        k.addBits( static_cast<unsigned int>(rng()), 1 + (rng() % 32) );
+    }
+
+    std::map<Key, unsigned int> ordered;
+    double t = lxbench::timeIt( 1, [&]() {
+        unsigned int v = 0;
+        for( auto &k: keys ) {
+            ordered.emplace( k, v++ );
+        }
+    } );
+    lxbench::report( "std::map insert", nKeys, t, "keys" );
+
+    std::unordered_map<Key, unsigned int> hashed;
+    hashed.reserve( nKeys );
+    t = lxbench::timeIt( 1, [&]() {
+        unsigned int v = 0;
+        for( auto &k: keys ) {
+            hashed.emplace( k, v++ );
+        }
+    } );
+    lxbench::report( "std::unordered_map insert", nKeys, t, "keys" );
+
+    std::shuffle( keys.begin(), keys.end(), rng );
+    unsigned long long sum = 0;
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: keys ) {
+            sum += ordered.find( k )->second;
+        }
+    } );
+    lxbench::report( "std::map find", nKeys, t, "keys" );
+
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: keys ) {
+            sum += hashed.find( k )->second;
+        }
+    } );
+    lxbench::report( "std::unordered_map find", nKeys, t, "keys" );
+
+    std::hash<Key> hasher;
+    t = lxbench::timeIt( 10, [&]() {
+        for( auto &k: keys ) {
+            sum += hasher( k );
+        }
+    } );
+    lxbench::report( "hash only", double(nKeys) * 10, t, "keys" );
+    lxbench::keep( sum );
+    return 0;
+}
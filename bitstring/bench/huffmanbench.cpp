@@ -0,0 +1,105 @@
+// FILE: huffmanbench.cpp
+// PURPOSE: MB/s of huffman.h on 16MB of skewed bytes (about 5 bits of
+//          entropy each, as log text has): building the code, encoding,
+//          and decoding through the tables against the usual canonical
+//          decode a bit at a time with read(pos, 1)
+
+#include <huffman.h>
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace {
+
+const size_t nBytes = 16u << 20;
+
+// bit at a time: a code is complete once it is under the first code of
+// the next length
+template<typename _Bits> size_t decodeBitAtATime( const lxutil::huffman &h, const _Bits &bits,
+                                                  std::span<uint8_t> out ) {
+    std::vector<uint32_t> count( 32, 0 );
+    for( unsigned int s = 0; s < h.symbolCount(); ++s ) {
+        ++count[h.codeLength( s )];
+    }
+    std::vector<uint8_t> sorted; // symbols by code
+    for( unsigned int l = 1; l < 32; ++l ) {
+        for( unsigned int s = 0; s < h.symbolCount(); ++s ) {
+            if( h.codeLength( s ) == l ) {
+                sorted.push_back( uint8_t( s ) );
+            }
+        }
+    }
+    unsigned int pos = 0;
+    size_t n = 0;
+    while( (n < out.size()) && (pos < bits.sizeInBits()) ) {
+        uint32_t code = 0;
+        uint32_t first = 0;
+        uint32_t index = 0;
+        for( unsigned int l = 1; l < 32; ++l ) {
+            code |= uint32_t( bits.read( pos++, 1 ) );
+            if( code - first < count[l] ) {
+                out[n++] = sorted[index + (code - first)];
+                break;
+            }
+            index += count[l];
+            first = (first + count[l]) << 1;
+            code <<= 1;
+        }
+    }
+    return n;
+}
+
+template<typename _Bits> void runBlocks( const std::string &blocks, const std::vector<uint8_t> &text ) {
+    std::vector<uint64_t> freqs( 256, 0 );
+    for( uint8_t c: text ) {
+        ++freqs[c];
+    }
+    lxutil::huffman h;
+    double t = lxbench::measure( [&]() {
+        h.build( freqs );
+        lxbench::keep( h );
+    } );
+    lxbench::report( blocks + " build", 1, t, "codes" );
+
+    _Bits bits;
+    t = lxbench::measure( [&]() {
+        bits.clear();
+        h.encode( bits, std::span<const uint8_t>( text ) );
+        lxbench::keep( bits );
+    } );
+    lxbench::report( blocks + " encode", text.size() / 1e6, t, "MB" );
+    std::cout << blocks << ": " << bits.sizeInBits() / 8 << " bytes coded" << std::endl;
+
+    std::vector<uint8_t> out( text.size() );
+    t = lxbench::measure( [&]() {
+        lxbench::keep( h.decode( bits, std::span<uint8_t>( out ) ) );
+    } );
+    lxbench::report( blocks + " decode, tables", text.size() / 1e6, t, "MB" );
+    if( out != text ) {
+        std::cout << blocks << ": decoded text differs" << std::endl;
+    }
+
+    t = lxbench::measure( [&]() {
+        lxbench::keep( decodeBitAtATime( h, bits, std::span<uint8_t>( out ) ) );
+    } );
+    lxbench::report( blocks + " decode, bit at a time", text.size() / 1e6, t, "MB" );
+}
+
+} // namespace
+
+int main() {
+    std::mt19937_64 rng( 42 );
+    std::geometric_distribution<unsigned int> skew( 0.06 );
+    std::vector<uint8_t> text( nBytes );
+    for( auto &c: text ) {
+        c = uint8_t( skew( rng ) );
+    }
+    runBlocks< lxutil::dynamicbitstring<> >( "32 bit blocks", text );
+    runBlocks< lxutil::dynamicbitstring< std::vector<uint64_t> > >( "64 bit blocks", text );
+    return 0;
+}
@@ -0,0 +1,39 @@
+// FILE: logicbench.cpp
+// PURPOSE: blocks/sec of the logical operators at every SIMD level
+//          the CPU supports
+
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <random>
+#include <string>
+
+int main() {
+    const unsigned int nBlocks = 50000;
+    const unsigned int reps = 2000;
+    std::mt19937 rng(42);
+    lxutil::dynamicbitstring<> a;
+    lxutil::dynamicbitstring<> b;
+    for( unsigned int i = 0; i < nBlocks; ++i ) {
+        a.addBits( static_cast<unsigned int>(rng()), 32 );
+        b.addBits( static_cast<unsigned int>(rng()), 32 );
+    }
+
+    const char *names[] = { "scalar", "sse2", "avx2", "avx512" };
+    auto detected = lxutil::simd::detectedLevel();
+    for( int l = 0; l <= static_cast<int>(detected); ++l ) {
+        lxutil::simd::setLevel( static_cast<lxutil::simd::Level>(l) );
+        std::string name = names[l];
+        double t = lxbench::timeIt( reps, [&]() { a &= b; lxbench::keep( a ); } );
+        lxbench::report( name + " and", double(nBlocks) * reps, t, "blocks" );
+        t = lxbench::timeIt( reps, [&]() { a |= b; lxbench::keep( a ); } );
+        lxbench::report( name + " or", double(nBlocks) * reps, t, "blocks" );
+        t = lxbench::timeIt( reps, [&]() { a ^= b; lxbench::keep( a ); } );
+        lxbench::report( name + " xor", double(nBlocks) * reps, t, "blocks" );
+        t = lxbench::timeIt( reps, [&]() { a.andNot( b ); lxbench::keep( a ); } );
+        lxbench::report( name + " andnot", double(nBlocks) * reps, t, "blocks" );
+        t = lxbench::timeIt( reps, [&]() { a.flip(); lxbench::keep( a ); } );
+        lxbench::report( name + " not", double(nBlocks) * reps, t, "blocks" );
+    }
+    return 0;
+}
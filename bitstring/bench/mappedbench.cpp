@@ -0,0 +1,77 @@
+// FILE: mappedbench.cpp
+// PURPOSE: a 1 Gbit bitmap on disk: reading the file into a vector
+//          backed dynamicbitstring and then probing it, against opening
+//          it as a mappedview and probing in place
+
+#include <mappedbitstring.h>
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+int main() {
+    const unsigned int nBits = 1u << 30;
+    const unsigned int nProbes = 1000000;
+    std::string path = "/tmp/mappedbench." + std::to_string( getpid() ) + ".lxbm";
+
+    double t = lxbench::timeIt( 1, [&]() {
+        lxutil::mappedbitstring<> m;
+        m.create( path.c_str() );
+        std::mt19937_64 fill(7);
+        for( unsigned int i = 0; i < nBits; i += 64 ) {
+            m.addBits( fill(), 64 );
+        }
+        m.flush();
+    } );
+    lxbench::report( "mapped build", double(nBits) / 64, t, "blocks" );
+
+    std::mt19937 rng(42);
+    std::vector<unsigned int> probes( nProbes );
+    for( auto &p: probes ) {
+        p = rng() % nBits;
+    }
+
+    unsigned long long sum = 0;
+    // the usual way: the whole file into memory first
+    t = lxbench::timeIt( 1, [&]() {
+        std::ifstream in( path, std::ios::binary );
+        in.seekg( 64 );
+        lxutil::dynamicbitstring< std::vector<uint64_t> > loaded;
+        loaded.loadBlocks( nBits, [&]( uint64_t *blocks, unsigned int nBlocks ) {
+            in.read( reinterpret_cast<char *>( blocks ), std::streamsize(nBlocks) * sizeof(uint64_t) );
+        } );
+        for( auto p: probes ) {
+            sum += loaded.bitAt( p );
+        }
+    } );
+    lxbench::report( "load and probe", nProbes, t, "probes" );
+
+    t = lxbench::timeIt( 1, [&]() {
+        lxutil::mappedview<> reader;
+        reader.open( path.c_str() );
+        auto v = reader.view();
+        for( auto p: probes ) {
+            sum += v.bitAt( p );
+        }
+    } );
+    lxbench::report( "map and probe", nProbes, t, "probes" );
+
+    // 1000 probes, as a short lived reader would do
+    t = lxbench::timeIt( 100, [&]() {
+        lxutil::mappedview<> reader;
+        reader.open( path.c_str() );
+        auto v = reader.view();
+        for( unsigned int i = 0; i < 1000; ++i ) {
+            sum += v.bitAt( probes[i] );
+        }
+    } );
+    lxbench::report( "open, 1000 probes", 100, t, "opens" );
+
+    unlink( path.c_str() );
+    lxbench::keep( sum );
+    return 0;
+}
@@ -0,0 +1,205 @@
+// FILE: microbench.cpp
+// PURPOSE: the hot paths of bitstring_core.h in one run, for spotting
+//          regressions between commits: addBits, read, write, resize,
+//          comparisons, &= and |=, and std::map insertion, for static
+//          and dynamic strings over several sizes and block types.
+//
+// USAGE: microbench [--format=text|csv|json] [--filter=substring]
+//                   [--min-time=seconds]
+//          Each case is named op/variant/block bits/size in bits and
+//          reports nanoseconds per operation. csv and json (a JSON
+//          array) are for diffing; LXBENCH_FORMAT picks the default.
+
+#include <dynamicbitstring.h>
+#include <staticbitstring.h>
+#include "benchutil.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace {
+
+struct row {
+    std::string name;
+    std::string op;
+    std::string variant;
+    unsigned int blockBits;
+    unsigned int sizeBits;
+    double ns; // per operation
+};
+
+std::vector<row> rows;
+std::string filter;
+double minSeconds = 0.05;
+
+template<typename _Fn> void run( const std::string &op, const std::string &variant,
+                                 unsigned int blockBits, unsigned int sizeBits,
+                                 unsigned int opsPerCall, _Fn &&fn ) {
+    std::string name = op + "/" + variant + "/" + std::to_string( blockBits ) + "/" +
+                       std::to_string( sizeBits );
+    if( !filter.empty() && name.find( filter ) == std::string::npos ) {
+        return;
+    }
+    double seconds = lxbench::measure( fn, minSeconds );
+    rows.push_back( { name, op, variant, blockBits, sizeBits, seconds * 1e9 / opsPerCall } );
+}
+
+// sizeBits of a fixed pattern, a block's worth (up to 32 bits) at a time
+template<typename _C> void fill( _C &c, unsigned int sizeBits, unsigned int seed = 1 ) {
+    constexpr unsigned int chunk = ( _C::bitsPerBlock() < 32 ) ? _C::bitsPerBlock() : 32;
+    for( unsigned int i = 0; i < sizeBits; i += chunk ) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int n = ( sizeBits - i < chunk ) ? (sizeBits - i) : chunk;
+        c.addBits( typename _C::BlockType( seed >> 1 ), n );
+    }
+}
+
+template<typename _C> void runAll( const std::string &variant, unsigned int sizeBits ) {
+    constexpr unsigned int blockBits = _C::bitsPerBlock();
+    const unsigned int nOffsets = 256;
+    std::vector<unsigned int> offsets( nOffsets );
+    unsigned int seed = 7;
+    for( auto &o: offsets ) {
+        seed = seed * 1103515245 + 12345;
+        o = (seed >> 8) % (sizeBits - 32 + 1);
+    }
+
+    run( "addBits", variant, blockBits, sizeBits, 1, [&]() {
+        _C c;
+        fill( c, sizeBits );
+        lxbench::keep( c );
+    } );
+
+    _C a;
+    fill( a, sizeBits );
+    run( "read", variant, blockBits, sizeBits, nOffsets, [&]() {
+        uint64_t sum = 0;
+        for( auto o: offsets ) {
+            sum += uint64_t( a.read( o, 32 ) );
+        }
+        lxbench::keep( sum );
+    } );
+
+    run( "write", variant, blockBits, sizeBits, nOffsets, [&]() {
+        unsigned int v = 0;
+        for( auto o: offsets ) {
+            a.write( v++, o, 32 );
+        }
+        lxbench::keep( a );
+    } );
+
+    run( "resize", variant, blockBits, sizeBits, 1, [&]() {
+        a.resize( sizeBits / 2 );
+        a.resize( sizeBits );
+        lxbench::keep( a );
+    } );
+
+    // equal up to the last bit, so the whole string is looked at
+    _C x;
+    _C b;
+    fill( x, sizeBits );
+    fill( b, sizeBits );
+    b.write( x.bitAt( sizeBits - 1 ) ? 0 : 1, sizeBits - 1, 1 );
+    run( "compare", variant, blockBits, sizeBits, 1, [&]() {
+        bool less = x < b;
+        lxbench::keep( less );
+    } );
+    run( "equal", variant, blockBits, sizeBits, 1, [&]() {
+        bool same = x == b;
+        lxbench::keep( same );
+    } );
+
+    _C c;
+    fill( c, sizeBits, 3 );
+    run( "and", variant, blockBits, sizeBits, 1, [&]() {
+        a &= c;
+        lxbench::keep( a );
+    } );
+    run( "or", variant, blockBits, sizeBits, 1, [&]() {
+        a |= c;
+        lxbench::keep( a );
+    } );
+
+    // keys sharing everything but the last 16 bits
+    const unsigned int nKeys = 256;
+    std::vector<_C> keys( nKeys, b );
+    for( unsigned int i = 0; i < nKeys; ++i ) {
+        keys[i].write( (i * 40503u) & 0xFFFF, sizeBits - 16, 16 );
+    }
+    run( "mapinsert", variant, blockBits, sizeBits, nKeys, [&]() {
+        std::map<_C, unsigned int> m;
+        for( unsigned int i = 0; i < nKeys; ++i ) {
+            m.emplace( keys[i], i );
+        }
+        lxbench::keep( m );
+    } );
+}
+
+template<unsigned int _Bits> void runSize() {
+    runAll< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "dynamic", _Bits );
+    runAll< lxutil::dynamicbitstring<> >( "dynamic", _Bits );
+    runAll< lxutil::dynamicbitstring< std::vector<uint64_t> > >( "dynamic", _Bits );
+    runAll< lxutil::staticbitstring<_Bits> >( "static", _Bits );
+    runAll< lxutil::staticbitstring<_Bits, lxutil::BitSizedArray<_Bits, uint64_t> > >( "static", _Bits );
+}
+
+void print() {
+    switch( lxbench::format() ) {
+    case lxbench::Format::Csv:
+        std::cout << "name,op,variant,block_bits,size_bits,ns_per_op" << std::endl;
+        for( auto &r: rows ) {
+            std::cout << r.name << "," << r.op << "," << r.variant << "," << r.blockBits << ","
+                      << r.sizeBits << "," << r.ns << std::endl;
+        }
+        break;
+    case lxbench::Format::Json:
+        std::cout << "[" << std::endl;
+        for( size_t i = 0; i < rows.size(); ++i ) {
+            auto &r = rows[i];
+            std::cout << "  {\"name\": \"" << r.name << "\", \"op\": \"" << r.op
+                      << "\", \"variant\": \"" << r.variant << "\", \"block_bits\": " << r.blockBits
+                      << ", \"size_bits\": " << r.sizeBits << ", \"ns_per_op\": " << r.ns << "}"
+                      << ( (i + 1 < rows.size()) ? "," : "" ) << std::endl;
+        }
+        std::cout << "]" << std::endl;
+        break;
+    default:
+        for( auto &r: rows ) {
+            std::string name = r.name;
+            name.resize( ( name.size() < 32 ) ? 32 : name.size(), ' ' );
+            std::cout << name << " " << r.ns << " ns/op" << std::endl;
+        }
+        break;
+    }
+}
+
+} // namespace
+
+int main( int argc, char **argv ) {
+    for( int i = 1; i < argc; ++i ) {
+        std::string arg = argv[i];
+        if( arg == "--format=csv" ) {
+            lxbench::setFormat( lxbench::Format::Csv );
+        } else if( arg == "--format=json" ) {
+            lxbench::setFormat( lxbench::Format::Json );
+        } else if( arg == "--format=text" ) {
+            lxbench::setFormat( lxbench::Format::Text );
+        } else if( arg.rfind( "--filter=", 0 ) == 0 ) {
+            filter = arg.substr( 9 );
+        } else if( arg.rfind( "--min-time=", 0 ) == 0 ) {
+            minSeconds = std::stod( arg.substr( 11 ) );
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--format=text|csv|json] [--filter=substring] [--min-time=seconds]" << std::endl;
+            return 1;
+        }
+    }
+
+    runSize<64>();
+    runSize<1024>();
+    runSize<16384>();
+    print();
+    return 0;
+}
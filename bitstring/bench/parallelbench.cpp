@@ -0,0 +1,65 @@
+// FILE: parallelbench.cpp
+// PURPOSE: bitstring_parallel.h on a 1G bit (128MB) string: &=, |=,
+//          compare, countOnes and serialize over pools of 1 thread up
+//          to one per core, next to the serial code, to see where the
+//          memory bus stops it scaling
+
+#include <bitstring_parallel.h>
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+int main() {
+    using Bits = lxutil::dynamicbitstring< std::vector<uint64_t> >;
+    const unsigned int nBits = 1u << 30;
+    const double bytes = nBits / 8.0;
+    auto random = []( uint64_t seed ) {
+        Bits bits;
+        bits.loadBlocks( nBits, [&]( uint64_t *blocks, unsigned int n ) {
+            for( unsigned int i = 0; i < n; ++i ) {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                blocks[i] = seed;
+            }
+        } );
+        return bits;
+    };
+    Bits a = random( 1 );
+    Bits b = random( 2 );
+    Bits x = random( 3 );
+    Bits same = x; // equal to the end: compare looks at all of it
+    std::vector<unsigned char> out( lxutil::serializedSize( a ) );
+
+    double t = lxbench::timeIt( 3, [&]() { a &= b; } ) / 3;
+    lxbench::report( "and, serial", bytes, t, "bytes" );
+    t = lxbench::timeIt( 3, [&]() { a |= b; } ) / 3;
+    lxbench::report( "or, serial", bytes, t, "bytes" );
+    t = lxbench::timeIt( 3, [&]() { lxbench::keep( x < same ); } ) / 3;
+    lxbench::report( "compare, serial", bytes, t, "bytes" );
+    t = lxbench::timeIt( 3, [&]() { lxbench::keep( a.countOnes() ); } ) / 3;
+    lxbench::report( "countOnes, serial", bytes, t, "bytes" );
+    t = lxbench::timeIt( 3, [&]() { lxutil::serialize( a, std::span<unsigned char>( out ) ); } ) / 3;
+    lxbench::report( "serialize, serial", bytes, t, "bytes" );
+
+    unsigned int cores = std::thread::hardware_concurrency();
+    for( unsigned int n = 1; n <= cores; n *= 2 ) {
+        lxutil::parallel::threadpool pool( n );
+        std::string threads = ", " + std::to_string( n ) + " threads";
+        t = lxbench::timeIt( 3, [&]() { lxutil::parallel::andWith( a, b, pool ); } ) / 3;
+        lxbench::report( "and" + threads, bytes, t, "bytes" );
+        t = lxbench::timeIt( 3, [&]() { lxutil::parallel::orWith( a, b, pool ); } ) / 3;
+        lxbench::report( "or" + threads, bytes, t, "bytes" );
+        t = lxbench::timeIt( 3, [&]() { lxbench::keep( lxutil::parallel::compare( x, same, pool ) < 0 ); } ) / 3;
+        lxbench::report( "compare" + threads, bytes, t, "bytes" );
+        t = lxbench::timeIt( 3, [&]() { lxbench::keep( lxutil::parallel::countOnes( a, pool ) ); } ) / 3;
+        lxbench::report( "countOnes" + threads, bytes, t, "bytes" );
+        t = lxbench::timeIt( 3, [&]() {
+            lxutil::parallel::serialize( a, std::span<unsigned char>( out ), pool );
+        } ) / 3;
+        lxbench::report( "serialize" + threads, bytes, t, "bytes" );
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+// FILE: serialbench.cpp
+// PURPOSE: snapshot and reload of 1M bitstring keys: 32 bits at a time
+//          through read/addBits, against serialize/deserialize and a pack
+
+#include <dynamicbitstring.h>
+#include <bitstring_serial.h>
+#include "benchutil.h"
+
+#include <random>
+#include <vector>
+
+int main() {
+    using Key = lxutil::dynamicbitstring<>;
+    const unsigned int nKeys = 1000000;
+    std::mt19937 rng(42);
+    std::vector<Key> keys( nKeys );
+    for( auto &k: keys ) {
+        unsigned int words = 1 + (rng() % 8);
+        for( unsigned int w = 0; w < words; ++w ) {
+            k.addBits( static_cast<unsigned int>(rng()), 32 );
+        }
+        k.addBits( static_cast<unsigned int>(rng()), 1 + (rng() % 31) );
+    }
+
+    // the old way: length, then 32 bits at a time
+    std::vector<unsigned int> words;
+    words.reserve( nKeys * 6 );
+    double t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: keys ) {
+            unsigned int n = k.sizeInBits();
+            words.push_back( n );
+            for( unsigned int pos = 0; pos < n; pos += 32 ) {
+                unsigned int chunk = (n - pos < 32) ? (n - pos) : 32;
+                words.push_back( static_cast<unsigned int>( k.read( pos, chunk ) ) );
+            }
+        }
+    } );
+    lxbench::report( "read 32 at a time", nKeys, t, "keys" );
+
+    std::vector<Key> loaded( nKeys );
+    t = lxbench::timeIt( 1, [&]() {
+        size_t at = 0;
+        for( auto &k: loaded ) {
+            unsigned int n = words[at++];
+            for( unsigned int pos = 0; pos < n; pos += 32 ) {
+                unsigned int chunk = (n - pos < 32) ? (n - pos) : 32;
+                k.addBits( words[at++], chunk );
+            }
+        }
+    } );
+    lxbench::report( "addBits 32 at a time", nKeys, t, "keys" );
+
+    std::vector<unsigned char> bytes;
+    bytes.reserve( words.size() * sizeof(unsigned int) );
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: keys ) {
+            lxutil::serialize( k, bytes );
+        }
+    } );
+    lxbench::report( "serialize", nKeys, t, "keys" );
+
+    std::vector<Key> reloaded( nKeys );
+    t = lxbench::timeIt( 1, [&]() {
+        std::span<const unsigned char> in( bytes );
+        for( auto &k: reloaded ) {
+            in = in.subspan( lxutil::deserialize( k, in ) );
+        }
+    } );
+    lxbench::report( "deserialize", nKeys, t, "keys" );
+
+    lxutil::packwriter writer;
+    std::vector<unsigned char> pack;
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: keys ) {
+            writer.add( k );
+        }
+        writer.writeTo( pack );
+    } );
+    lxbench::report( "pack write", nKeys, t, "keys" );
+
+    unsigned long long sum = 0;
+    t = lxbench::timeIt( 1, [&]() {
+        lxutil::packreader reader;
+        reader.open( pack );
+        for( size_t i = 0; i < reader.count(); ++i ) {
+            sum += reader.view( i ).read( 0, 32 );
+        }
+    } );
+    lxbench::report( "pack open and view", nKeys, t, "keys" );
+
+    lxbench::keep( sum );
+    lxbench::keep( loaded );
+    lxbench::keep( reloaded );
+    return 0;
+}
@@ -0,0 +1,66 @@
+// FILE: shiftbench.cpp
+// PURPOSE: block-wise shift operators against shifting through read/write
+
+#include <dynamicbitstring.h>
+#include <staticbitstring.h>
+#include "benchutil.h"
+
+#include <memory>
+#include <random>
+
+// the old way: copy every field to its new place
+template<typename _C> void shiftByReadWrite( _C &to, _C &from, unsigned int nBits ) {
+    unsigned int total = from.sizeInBits();
+    unsigned int pos = 0;
+    for( ; pos + nBits + 32 <= total; pos += 32 ) {
+        to.write( from.read( pos + nBits, 32 ), pos, 32 );
+    }
+    if( pos + nBits < total ) {
+        unsigned int rest = total - pos - nBits;
+        to.write( from.read( pos + nBits, rest ), pos, rest );
+        pos += rest;
+    }
+    for( ; pos < total; ++pos ) {
+        to.write( 0, pos, 1 );
+    }
+}
+
+template<typename _C> void runShift( const std::string &name, unsigned int nBlocks ) {
+    std::mt19937 rng(42);
+    auto a = std::make_unique<_C>();
+    for( unsigned int i = 0; i < nBlocks; ++i ) {
+        a->addBits( static_cast<unsigned int>(rng()), 32 );
+    }
+    auto b = std::make_unique<_C>( *a );
+    const unsigned int reps = 200;
+
+    double t = lxbench::timeIt( reps, [&]() {
+        shiftByReadWrite( *b, *a, 13 );
+        lxbench::keep( *b );
+    } );
+    lxbench::report( name + " read/write shift", double(nBlocks) * reps, t, "blocks" );
+
+    t = lxbench::timeIt( reps, [&]() {
+        *b <<= 13;
+        lxbench::keep( *b );
+    } );
+    lxbench::report( name + " <<= 13", double(nBlocks) * reps, t, "blocks" );
+
+    t = lxbench::timeIt( reps, [&]() {
+        *b >>= 77;
+        lxbench::keep( *b );
+    } );
+    lxbench::report( name + " >>= 77", double(nBlocks) * reps, t, "blocks" );
+
+    t = lxbench::timeIt( reps, [&]() {
+        b->rotateLeft( 1000 );
+        lxbench::keep( *b );
+    } );
+    lxbench::report( name + " rotateLeft 1000", double(nBlocks) * reps, t, "blocks" );
+}
+
+int main() {
+    runShift< lxutil::dynamicbitstring<> >( "dynamic", 100000 );
+    runShift< lxutil::staticbitstring<32 * 100000> >( "static", 100000 );
+    return 0;
+}
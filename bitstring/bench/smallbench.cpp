@@ -0,0 +1,58 @@
+// FILE: smallbench.cpp
+// PURPOSE: dynamicbitstring against smalldynamicbitstring for short
+//          keys (under 128 bits): build, copy, and a std::map of 1M keys
+
+#include <dynamicbitstring.h>
+#include "benchutil.h"
+
+#include <map>
+#include <random>
+#include <vector>
+#include <string>
+
+template<typename _Key> void run( const std::string &name ) {
+    const unsigned int nKeys = 1000000;
+    std::mt19937 rng(42);
+    std::vector<_Key> keys;
+    keys.reserve( nKeys );
+    double t = lxbench::timeIt( 1, [&]() {
+        for( unsigned int i = 0; i < nKeys; ++i ) {
+            _Key k;
+            k.addBits( static_cast<unsigned int>(rng() % 16), 32 );
+            k.addBits( static_cast<unsigned int>(rng()), 32 );
+            k.addBits( static_cast<unsigned int>(rng()), 1 + (rng() % 32) );
+            keys.push_back( std::move( k ) );
+        }
+    } );
+    lxbench::report( name + " build", nKeys, t, "keys" );
+
+    std::vector<_Key> copies;
+    t = lxbench::timeIt( 1, [&]() {
+        copies = keys;
+    } );
+    lxbench::report( name + " copy", nKeys, t, "keys" );
+
+    std::map<_Key, unsigned int> ordered;
+    t = lxbench::timeIt( 1, [&]() {
+        unsigned int v = 0;
+        for( auto &k: keys ) {
+            ordered.emplace( k, v++ );
+        }
+    } );
+    lxbench::report( name + " map insert", nKeys, t, "keys" );
+
+    unsigned long long sum = 0;
+    t = lxbench::timeIt( 1, [&]() {
+        for( auto &k: copies ) {
+            sum += ordered.find( k )->second;
+        }
+    } );
+    lxbench::report( name + " map find", nKeys, t, "keys" );
+    lxbench::keep( sum );
+}
+
+int main() {
+    run< lxutil::dynamicbitstring<> >( "vector" );
+    run< lxutil::smalldynamicbitstring<128> >( "inline" );
+    return 0;
+}
@@ -0,0 +1,54 @@
+// FILE: viewbench.cpp
+// PURPOSE: parsing bit-packed payloads from a byte buffer: copying each
+//          one into a bitstring with addBits first, against reading it
+//          in place through a bitstring_view
+
+#include <dynamicbitstring.h>
+#include <bitstring_view.h>
+#include "benchutil.h"
+
+#include <random>
+#include <vector>
+
+int main() {
+    using Bits = lxutil::dynamicbitstring< std::vector<unsigned char> >;
+    using View = lxutil::bitstring_view<unsigned char>;
+    const unsigned int payloadBytes = 64;
+    const unsigned int nPayloads = 100000;
+    const unsigned int fieldBits = 11;
+    std::mt19937 rng(42);
+    std::vector<unsigned char> buffer( payloadBytes * nPayloads );
+    for( auto &b: buffer ) {
+        b = static_cast<unsigned char>(rng());
+    }
+    unsigned int payloadBits = payloadBytes * 8;
+
+    unsigned long long sum = 0;
+    double t = lxbench::timeIt( 1, [&]() {
+        for( unsigned int p = 0; p < nPayloads; ++p ) {
+            Bits bits;
+            const unsigned char *bytes = buffer.data() + p * payloadBytes;
+            for( unsigned int i = 0; i < payloadBytes; ++i ) {
+                bits.addBits( bytes[i], 8 );
+            }
+            for( unsigned int pos = 0; pos + fieldBits <= payloadBits; pos += fieldBits ) {
+                sum += bits.read( pos, fieldBits );
+            }
+        }
+    } );
+    lxbench::report( "copy then read", nPayloads, t, "payloads" );
+
+    t = lxbench::timeIt( 1, [&]() {
+        for( unsigned int p = 0; p < nPayloads; ++p ) {
+            auto view = View::fromStream( std::span<const unsigned char>(
+                            buffer.data() + p * payloadBytes, payloadBytes ), payloadBits );
+            for( unsigned int pos = 0; pos + fieldBits <= payloadBits; pos += fieldBits ) {
+                sum += view.read( pos, fieldBits );
+            }
+        }
+    } );
+    lxbench::report( "view read", nPayloads, t, "payloads" );
+
+    lxbench::keep( sum );
+    return 0;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+// FILE: atomic_bitstring.h
+// PURPOSE: fixed size bitstring that many threads can set, clear and
+//          test at once without a lock, e.g. worker pools marking the
+//          items they have done in a shared bitmap.
+//
+// Every operation is atomic per block: a single bit, or the part of a
+// range inside one block. A range across blocks is a block at a time,
+// so another thread may see part of it done. Reads of many blocks
+// (countOnes, snapshots) see each block at some point while they run,
+// not the whole string at one instant.
+//
+// The layout is bitstring's (bit 0 at the top of block 0, the last
+// block right aligned), so snapshotTo() hands the blocks over as they
+// are to any bitstring for comparisons and logical operations.
+
+#include <dynamicbitstring.h>
+#include <atomic>
+#include <memory> // std::unique_ptr
+#include <vector>
+#include <stdint.h>
+
+namespace lxutil {
+
+template<typename _BlockType = uint64_t> class atomic_bitstring {
+    static_assert( std::atomic<_BlockType>::is_always_lock_free,
+                   "blocks must be lock free atomics (64 bits at most)" );
+public:
+    using BlockType = _BlockType;
+
+    // nBits bits, all zero
+    explicit atomic_bitstring( unsigned int nBits ):
+            nBits(nBits), nBlocks((nBits + bitsInBlock - 1) / bitsInBlock),
+            blocks(new std::atomic<BlockType>[nBlocks]) {
+        for( unsigned int i = 0; i < nBlocks; ++i ) {
+            blocks[i].store( 0, std::memory_order_relaxed );
+        }
+    }
+
+    atomic_bitstring( const atomic_bitstring & ) = delete;
+    atomic_bitstring &operator=( const atomic_bitstring & ) = delete;
+
+    unsigned int sizeInBits() const {
+        return nBits;
+    }
+    unsigned int sizeInBlocks() const {
+        return nBlocks;
+    }
+    static constexpr unsigned int bitsPerBlock() {
+        return bitsInBlock;
+    }
+    unsigned int bitsInBlockAt( unsigned int block ) const {
+        return ( (block + 1) < nBlocks ) ? bitsInBlock : (nBits - block * bitsInBlock);
+    }
+
+    // positions must be below sizeInBits(), as with bitstring::bitAt
+    bool testBit( unsigned int pos, std::memory_order order = std::memory_order_seq_cst ) const {
+        return ( blocks[pos / bitsInBlock].load( order ) & bitMask( pos ) ) != 0;
+    }
+    void setBit( unsigned int pos, std::memory_order order = std::memory_order_seq_cst ) {
+        blocks[pos / bitsInBlock].fetch_or( bitMask( pos ), order );
+    }
+    void clearBit( unsigned int pos, std::memory_order order = std::memory_order_seq_cst ) {
+        blocks[pos / bitsInBlock].fetch_and( BlockType( ~bitMask( pos ) ), order );
+    }
+
+    // sets the bit and returns what it was: of threads racing for the
+    // same bit, exactly one sees false
+    bool testAndSet( unsigned int pos, std::memory_order order = std::memory_order_seq_cst ) {
+        BlockType mask = bitMask( pos );
+        return ( blocks[pos / bitsInBlock].fetch_or( mask, order ) & mask ) != 0;
+    }
+    bool testAndClear( unsigned int pos, std::memory_order order = std::memory_order_seq_cst ) {
+        BlockType mask = bitMask( pos );
+        return ( blocks[pos / bitsInBlock].fetch_and( BlockType( ~mask ), order ) & mask ) != 0;
+    }
+
+    // ors the low nBits (up to 64) of value into the bits from startingBit
+    // on, as write() would lay them out; returns what those bits were.
+    // Bits that would land past the end, the lowest of value, are left
+    // out, and the result has only the ones that exist
+    uint64_t fetchOr( unsigned int startingBit, uint64_t value, unsigned int nBits,
+                      std::memory_order order = std::memory_order_seq_cst ) {
+        if( nBits > 64 ) {
+            nBits = 64;
+        }
+        unsigned int inside = bitsFrom( startingBit, nBits );
+        if( inside < nBits ) {
+            value = ( inside > 0 ) ? (value >> (nBits - inside)) : 0;
+            nBits = inside;
+        }
+        uint64_t was = 0;
+        while( nBits > 0 ) {
+            unsigned int block = startingBit / bitsInBlock;
+            unsigned int left = bitsInBlockAt( block ) - (startingBit % bitsInBlock); // bits from here on
+            unsigned int n = ( nBits < left ) ? nBits : left;
+            BlockType part = BlockType( value >> (nBits - n) ) & lowMask( n ); // the top n still to go
+            unsigned int shift = left - n;
+            BlockType before = blocks[block].fetch_or( BlockType( part << shift ), order );
+            uint64_t old = uint64_t( (before >> shift) & lowMask( n ) );
+            was = ( n < 64 ) ? ( (was << n) | old ) : old;
+            startingBit += n;
+            nBits -= n;
+        }
+        return was;
+    }
+
+    // sets (clears) the nBits bits from startingBit on, a block at a time;
+    // the part of the range past the end is left out
+    void setRange( unsigned int startingBit, unsigned int nBits,
+                   std::memory_order order = std::memory_order_seq_cst ) {
+        eachBlock( startingBit, nBits, [&]( std::atomic<BlockType> &b, BlockType mask ) {
+            b.fetch_or( mask, order );
+        } );
+    }
+    void clearRange( unsigned int startingBit, unsigned int nBits,
+                     std::memory_order order = std::memory_order_seq_cst ) {
+        eachBlock( startingBit, nBits, [&]( std::atomic<BlockType> &b, BlockType mask ) {
+            b.fetch_and( BlockType( ~mask ), order );
+        } );
+    }
+
+    // all bits to zero
+    void clear( std::memory_order order = std::memory_order_seq_cst ) {
+        for( unsigned int i = 0; i < nBlocks; ++i ) {
+            blocks[i].store( 0, order );
+        }
+    }
+
+    // a count while others may be changing bits, so relaxed is enough
+    unsigned int countOnes( std::memory_order order = std::memory_order_relaxed ) const {
+        unsigned int count = 0;
+        for( unsigned int i = 0; i < nBlocks; ++i ) {
+            count += blockbits::popcount( blocks[i].load( order ) );
+        }
+        return count;
+    }
+
+    // the bits into bits, replacing what it held; false if static
+    // storage is too small. Block types have to match
+    template<typename _Bits> bool snapshotTo( _Bits &bits,
+                                              std::memory_order order = std::memory_order_acquire ) const {
+        static_assert( std::is_same<typename _Bits::BlockType, BlockType>::value,
+                       "snapshot into a bitstring with the same block type" );
+        return bits.loadBlocks( nBits, [&]( BlockType *to, unsigned int n ) {
+            for( unsigned int i = 0; i < n; ++i ) {
+                to[i] = blocks[i].load( order );
+            }
+        } );
+    }
+
+    dynamicbitstring< std::vector<BlockType> > snapshot( std::memory_order order = std::memory_order_acquire ) const {
+        dynamicbitstring< std::vector<BlockType> > bits;
+        snapshotTo( bits, order );
+        return bits;
+    }
+
+private:
+    static constexpr unsigned int bitsInBlock = (sizeof(BlockType) * 8);
+
+    static constexpr BlockType lowMask( unsigned int n ) {
+        return ( n >= bitsInBlock ) ? BlockType(~BlockType(0)) :
+                    BlockType( (BlockType(1) << n) - 1 );
+    }
+
+    BlockType bitMask( unsigned int pos ) const {
+        unsigned int block = pos / bitsInBlock;
+        return BlockType( BlockType(1) << (bitsInBlockAt( block ) - 1 - (pos % bitsInBlock)) );
+    }
+
+    // how many of the nBits from startingBit on are there
+    unsigned int bitsFrom( unsigned int startingBit, unsigned int nBits ) const {
+        if( startingBit >= this->nBits ) {
+            return 0;
+        }
+        return ( nBits < (this->nBits - startingBit) ) ? nBits : (this->nBits - startingBit);
+    }
+
+    // fn( block, mask ) for each block the range touches, mask covering
+    // the range's bits in it
+    template<typename _Fn> void eachBlock( unsigned int startingBit, unsigned int nBits, _Fn &&fn ) {
+        nBits = bitsFrom( startingBit, nBits );
+        while( nBits > 0 ) {
+            unsigned int block = startingBit / bitsInBlock;
+            unsigned int left = bitsInBlockAt( block ) - (startingBit % bitsInBlock);
+            unsigned int n = ( nBits < left ) ? nBits : left;
+            fn( blocks[block], BlockType( lowMask( n ) << (left - n) ) );
+            startingBit += n;
+            nBits -= n;
+        }
+    }
+
+    unsigned int nBits;
+    unsigned int nBlocks;
+    std::unique_ptr< std::atomic<BlockType>[] > blocks;
+};
+
+} // namespace lxutil
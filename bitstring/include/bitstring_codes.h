@@ -0,0 +1,425 @@
+#pragma once
+
+// FILE: bitstring_codes.h
+// PURPOSE: variable length integer codes over bitstrings: Elias gamma,
+//          Elias delta, Golomb-Rice and LEB128, one value at a time
+//          (encoder, decoder) or a whole array (encode, decode).
+//
+// The codes, for a value v with N = floor(log2 v):
+//     gamma     N zeros, then the N + 1 bits of v. v from 1
+//     delta     gamma(N + 1), then the low N bits of v. v from 1
+//     rice(k)   v >> k in unary as that many zeros and a one, then the
+//               low k bits of v. v from 0, k up to 63, v >> k
+//               below 2^32
+//     leb128    7 bits at a time from the low end, one byte each, the
+//               top bit set on every byte but the last. v from 0
+// Unary runs of zeros ending in a one are what countl_zero finds, so
+// the prefixes decode in one step instead of a bit at a time.
+//
+// encoder appends through the bitstring's writer, whole codes as one
+// field where they fit in 64 bits. decoder reads a bitstring or a
+// bitstring_view through a 64 bit buffer, refilled a block at a time;
+// a code is usually decoded from the buffer alone.
+// Encoding fails (false) on a value the code can't take, decoding on a
+// code cut short by the end of the bits or too big for 64 bits.
+
+#include <bitstring_core.h>
+#include <span>
+#include <stdint.h>
+
+namespace lxutil {
+namespace codes {
+
+enum class code { Gamma, Delta, Rice, Leb128 };
+
+// signed values for the codes above: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+inline uint64_t zigzagEncode( int64_t v ) {
+    return ( uint64_t(v) << 1 ) ^ uint64_t( v >> 63 );
+}
+inline int64_t zigzagDecode( uint64_t v ) {
+    return int64_t( v >> 1 ) ^ -int64_t( v & 1 );
+}
+
+namespace detail {
+
+inline uint64_t lowMask( unsigned int n ) {
+    return ( n >= 64 ) ? ~uint64_t(0) : ( (uint64_t(1) << n) - 1 );
+}
+
+inline unsigned int log2( uint64_t v ) {
+    return 63 - blockbits::countl_zero( v );
+}
+
+} // namespace detail
+
+// appends codes to a bitstring. As with its writer, the bitstring is
+// only up to date after flush() (or destruction)
+template<typename _Bits> class encoder {
+    using BlockType = typename _Bits::BlockType;
+    // the most put() hands the writer at once
+    static constexpr unsigned int chunkBits = ( _Bits::bitsPerBlock() < 64 ) ? _Bits::bitsPerBlock() : 64;
+public:
+    // the longest unary part rice() writes
+    static constexpr uint64_t maxRiceQuotient = 0xFFFFFFFFu;
+
+    explicit encoder( _Bits &to ): out(to) {}
+
+    // the low nBits of v, up to 64
+    bool put( uint64_t v, unsigned int nBits ) {
+        while( nBits > chunkBits ) {
+            nBits -= chunkBits;
+            if( !out.writeBits( BlockType( v >> nBits ), chunkBits ) ) {
+                return false;
+            }
+        }
+        return out.writeBits( BlockType( v ), nBits );
+    }
+
+    bool gamma( uint64_t v ) {
+        if( v == 0 ) {
+            return false;
+        }
+        unsigned int n = detail::log2( v );
+        if( 2 * n + 1 <= 64 ) {
+            return put( v, 2 * n + 1 ); // the zeros come with it
+        }
+        return put( 0, n ) && put( v, n + 1 );
+    }
+
+    bool delta( uint64_t v ) {
+        if( v == 0 ) {
+            return false;
+        }
+        unsigned int n = detail::log2( v );
+        return gamma( n + 1 ) && put( v, n );
+    }
+
+    // a bitstring holds fewer than 2^32 bits, so v >> k must be below
+    // that; false right away for a longer unary part
+    bool rice( uint64_t v, unsigned int k ) {
+        if( (k > 63) || ((v >> k) > maxRiceQuotient) ) {
+            return false;
+        }
+        uint64_t q = v >> k;
+        uint64_t low = v & detail::lowMask( k );
+        if( q <= 63 - k ) {
+            return put( (uint64_t(1) << k) | low, (unsigned int)( q + 1 + k ) );
+        }
+        for( ; q > 0; q -= ( q < 64 ) ? q : 64 ) {
+            if( !put( 0, ( q < 64 ) ? (unsigned int)q : 64 ) ) {
+                return false;
+            }
+        }
+        return put( 1, 1 ) && put( low, k );
+    }
+
+    // up to 8 bytes go as one field
+    bool leb128( uint64_t v ) {
+        uint64_t field = 0;
+        unsigned int nBytes = 0;
+        while( v >= 0x80 ) {
+            field = (field << 8) | (v & 0x7F) | 0x80;
+            v >>= 7;
+            if( ++nBytes == 8 ) {
+                if( !put( field, 64 ) ) {
+                    return false;
+                }
+                field = 0;
+                nBytes = 0;
+            }
+        }
+        field = (field << 8) | v;
+        return put( field, 8 * (nBytes + 1) );
+    }
+
+    template<code _Code> bool put( uint64_t v, unsigned int k = 0 ) {
+        if constexpr( _Code == code::Gamma ) {
+            return gamma( v );
+        } else if constexpr( _Code == code::Delta ) {
+            return delta( v );
+        } else if constexpr( _Code == code::Rice ) {
+            return rice( v, k );
+        } else {
+            return leb128( v );
+        }
+    }
+
+    void flush() {
+        out.flush();
+    }
+
+private:
+    typename _Bits::writer out;
+};
+
+// reads codes from a bitstring or a bitstring_view, front to back.
+// The source must not change while it is read
+template<typename _Source> class decoder {
+    using BlockType = typename _Source::BlockType;
+    static constexpr unsigned int bitsInBlock = _Source::bitsPerBlock();
+public:
+    explicit decoder( const _Source &from, unsigned int startBit = 0 ):
+            source(from), nBlocks(from.sizeInBlocks()), nBits(from.sizeInBits()) {
+        seek( startBit );
+    }
+
+    void seek( unsigned int bitPos ) {
+        pos = ( bitPos < nBits ) ? bitPos : nBits;
+        block = pos / bitsInBlock;
+        taken = pos % bitsInBlock;
+        if( (block < nBlocks) && (taken == source.bitsInBlockAt( block )) ) {
+            ++block; // at the end of a partial last block
+            taken = 0;
+        }
+        buffer = 0;
+        avail = 0;
+        refill();
+    }
+
+    unsigned int position() const {
+        return pos;
+    }
+    bool atEnd() const {
+        return pos >= nBits;
+    }
+
+    // the next nBits, up to 64
+    bool get( uint64_t &v, unsigned int nBits ) {
+        if( avail < nBits ) {
+            refill();
+            if( avail < nBits ) {
+                return false;
+            }
+        }
+        v = ( nBits > 0 ) ? ( buffer >> (64 - nBits) ) : 0;
+        skip( nBits );
+        return true;
+    }
+
+    // the next nBits (up to 64) without moving forward, zeros past the
+    // end; with consume(), for codes read through a table (huffman.h)
+    uint64_t peek( unsigned int nBits ) {
+        if( avail < nBits ) {
+            refill();
+        }
+        return ( nBits > 0 ) ? ( buffer >> (64 - nBits) ) : 0;
+    }
+
+    // bits peek() has ready: 64 after a peek, unless near the end
+    unsigned int buffered() const {
+        return avail;
+    }
+
+    // move forward nBits of what peek() saw; false past the end
+    bool consume( unsigned int nBits ) {
+        if( nBits > avail ) {
+            return false;
+        }
+        skip( nBits );
+        return true;
+    }
+
+    // the fast paths refill only when the code isn't all in the buffer
+    bool gamma( uint64_t &v ) {
+        if( buffer == 0 ) {
+            refill();
+        }
+        if( buffer != 0 ) {
+            unsigned int n = blockbits::countl_zero( buffer );
+            if( 2 * n + 1 > avail ) {
+                refill();
+            }
+            if( 2 * n + 1 <= avail ) {
+                v = buffer >> (63 - 2 * n);
+                skip( 2 * n + 1 );
+                return true;
+            }
+        }
+        // longer than the buffer: the zeros first
+        uint64_t n;
+        if( !unary( n ) || (n > 63) ) {
+            return false;
+        }
+        uint64_t rest;
+        if( !get( rest, (unsigned int)n ) ) {
+            return false;
+        }
+        v = (uint64_t(1) << n) | rest;
+        return true;
+    }
+
+    bool delta( uint64_t &v ) {
+        uint64_t n;
+        if( !gamma( n ) || (n > 64) ) {
+            return false;
+        }
+        uint64_t rest;
+        if( !get( rest, (unsigned int)(n - 1) ) ) {
+            return false;
+        }
+        v = (uint64_t(1) << (n - 1)) | rest;
+        return true;
+    }
+
+    bool rice( uint64_t &v, unsigned int k ) {
+        if( k > 63 ) {
+            return false;
+        }
+        if( buffer == 0 ) {
+            refill();
+        }
+        uint64_t q;
+        if( buffer != 0 ) {
+            unsigned int n = blockbits::countl_zero( buffer );
+            if( n + 1 + k > avail ) {
+                refill();
+            }
+            if( n + 1 + k <= avail ) {
+                skip( n + 1 );
+                v = ( uint64_t(n) << k ) | ( ( k > 0 ) ? (buffer >> (64 - k)) : 0 );
+                skip( k );
+                return true;
+            }
+        }
+        uint64_t low;
+        if( !unary( q ) || (q > (~uint64_t(0) >> k)) || !get( low, k ) ) {
+            return false;
+        }
+        v = (q << k) | low;
+        return true;
+    }
+
+    bool leb128( uint64_t &v ) {
+        uint64_t stops = stopBytes();
+        if( stops == 0 ) {
+            refill();
+            stops = stopBytes();
+        }
+        if( stops != 0 ) {
+            // the whole code is in the buffer: its bytes from the top
+            unsigned int nBytes = blockbits::countl_zero( stops ) / 8 + 1;
+            uint64_t value = 0;
+            for( unsigned int i = 0; i < nBytes; ++i ) {
+                value |= ( (buffer >> (56 - 8 * i)) & 0x7F ) << (7 * i);
+            }
+            v = value;
+            skip( 8 * nBytes );
+            return true;
+        }
+        uint64_t value = 0;
+        for( unsigned int shift = 0; shift < 70; shift += 7 ) {
+            uint64_t byte;
+            if( !get( byte, 8 ) ) {
+                return false;
+            }
+            if( (shift == 63) && ((byte & 0x7F) > 1) ) {
+                return false; // past 64 bits
+            }
+            value |= (byte & 0x7F) << shift;
+            if( (byte & 0x80) == 0 ) {
+                v = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<code _Code> bool get( uint64_t &v, unsigned int k = 0 ) {
+        if constexpr( _Code == code::Gamma ) {
+            return gamma( v );
+        } else if constexpr( _Code == code::Delta ) {
+            return delta( v );
+        } else if constexpr( _Code == code::Rice ) {
+            return rice( v, k );
+        } else {
+            return leb128( v );
+        }
+    }
+
+private:
+    // the top bits of the buffered bytes that end a LEB128 code
+    uint64_t stopBytes() const {
+        uint64_t whole = ( avail >= 64 ) ? ~uint64_t(0) : ~( ~uint64_t(0) >> (avail & ~7u) );
+        return ~buffer & whole & 0x8080808080808080ull;
+    }
+
+    // zeros up to a one, the one consumed as well
+    bool unary( uint64_t &count ) {
+        count = 0;
+        for( ;; ) {
+            if( avail < 64 ) {
+                refill();
+            }
+            if( avail == 0 ) {
+                return false;
+            }
+            if( buffer == 0 ) {
+                count += avail;
+                skip( avail );
+                continue;
+            }
+            unsigned int n = blockbits::countl_zero( buffer );
+            count += n;
+            skip( n + 1 );
+            return true;
+        }
+    }
+
+    void skip( unsigned int n ) {
+        buffer = ( n < 64 ) ? (buffer << n) : 0;
+        avail -= n;
+        pos += n;
+    }
+
+    // the buffer topped up to 64 bits, or to the end of the source
+    void refill() {
+        while( (avail < 64) && (block < nBlocks) ) {
+            unsigned int left = source.bitsInBlockAt( block ) - taken;
+            unsigned int take = ( left < 64 - avail ) ? left : (64 - avail);
+            uint64_t bits = uint64_t( source.blockAt( block ) >> (left - take) ) & detail::lowMask( take );
+            buffer |= bits << (64 - avail - take);
+            avail += take;
+            taken += take;
+            if( take == left ) {
+                ++block;
+                taken = 0;
+            }
+        }
+    }
+
+    const _Source &source;
+    unsigned int nBlocks;
+    unsigned int nBits;
+    uint64_t buffer;    // next bits, left aligned, zeros past avail
+    unsigned int avail; // valid bits in buffer
+    unsigned int block; // next block to load from
+    unsigned int taken; // bits of it already loaded
+    unsigned int pos;   // bits consumed so far
+};
+
+// all of values appended to bits with _Code (k: the Rice parameter).
+// False at the first value the code can't take, those before it stay
+template<code _Code, typename _Bits> bool encode( _Bits &bits, std::span<const uint64_t> values, unsigned int k = 0 ) {
+    encoder<_Bits> e( bits );
+    for( uint64_t v: values ) {
+        if( !e.template put<_Code>( v, k ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// values decoded from startBit on into out, until out is full or the
+// bits run out; how many there were
+template<code _Code, typename _Source> size_t decode( const _Source &bits, std::span<uint64_t> out,
+                                                      unsigned int k = 0, unsigned int startBit = 0 ) {
+    decoder<_Source> d( bits, startBit );
+    size_t n = 0;
+    while( (n < out.size()) && !d.atEnd() && d.template get<_Code>( out[n], k ) ) {
+        ++n;
+    }
+    return n;
+}
+
+} // namespace codes
+} // namespace lxutil
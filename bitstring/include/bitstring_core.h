@@ -5,23 +5,175 @@
 //          "bucket of bits" storing an array of bits,
 //          up to a compile-time-defined maximum number of bits.
 
-#include <string.h> // memset
+#include <string.h> // memset, memmove, memcpy
 #include <utility> // std::move
 #include <type_traits> // std::conditional
+#include <memory> // std::uses_allocator
+#include <span> // std::span
+#include <cstdint> // uint64_t
+#include <bit> // std::popcount, std::countl_zero, std::countr_zero
+#include <iterator> // std::forward_iterator_tag
+#include <cstddef> // std::ptrdiff_t
+#include <compare> // std::strong_ordering
+#include <functional> // std::less, for pointers into other storage
+#include <atomic> // growth::counting
+#include <bitstring_simd.h>
 
 
 namespace lxutil {
 
+// std::popcount & co. for any block type. The std ones only take
+// unsigned __int128 in gnu++ modes, so it is done in two halves here
+namespace blockbits {
+
+template<typename _T> constexpr unsigned int popcount( _T v ) {
+    if constexpr( sizeof(_T) > sizeof(uint64_t) ) {
+        return std::popcount( uint64_t(v >> 64) ) + std::popcount( uint64_t(v) );
+    } else {
+        return std::popcount( v );
+    }
+}
+
+template<typename _T> constexpr unsigned int countl_zero( _T v ) {
+    if constexpr( sizeof(_T) > sizeof(uint64_t) ) {
+        uint64_t hi = uint64_t(v >> 64);
+        return hi ? std::countl_zero( hi ) : 64 + std::countl_zero( uint64_t(v) );
+    } else {
+        return std::countl_zero( v );
+    }
+}
+
+template<typename _T> constexpr unsigned int countr_zero( _T v ) {
+    if constexpr( sizeof(_T) > sizeof(uint64_t) ) {
+        uint64_t lo = uint64_t(v);
+        return lo ? std::countr_zero( lo ) : 64 + std::countr_zero( uint64_t(v >> 64) );
+    } else {
+        return std::countr_zero( v );
+    }
+}
+
+// index of the first of n blocks where a and b differ, n if none
+template<typename _T> inline unsigned int firstDifferent( const _T *a, const _T *b, unsigned int n ) {
+    if( n * sizeof(_T) < 64 ) {
+        // short keys, the common case: not worth the SIMD dispatch
+        unsigned int i = 0;
+        while( (i < n) && (a[i] == b[i]) ) {
+            ++i;
+        }
+        return i;
+    }
+    return (unsigned int)( simd::firstDifference( a, b, size_t(n) * sizeof(_T) ) / sizeof(_T) );
+}
+
+} // namespace blockbits
+
+// read-only bits over someone else's memory, see bitstring_view.h
+template<typename _BlockType> class bitstring_view;
+
+// the storage's allocator_type, when it has one (std::vector, std::pmr::vector)
+struct noallocator {};
+template<typename _StorageType, typename = void> struct storageallocator {
+    using type = noallocator;
+};
+template<typename _StorageType>
+struct storageallocator<_StorageType, std::void_t<typename _StorageType::allocator_type> > {
+    using type = typename _StorageType::allocator_type;
+};
+
+// growth policies for expandable storage: how many blocks to make room
+// for when it runs out, and how many to keep when the string gets
+// shorter. A policy has
+//     static size_t grow( size_t capacity, size_t needed ): at least needed
+//     static size_t shrink( size_t capacity, size_t used ): at least used,
+//                          capacity to keep what there is
+namespace growth {
+
+// twice the capacity at a time, so appending costs O(1) amortized;
+// hands memory back once under a quarter of it is used, keeping
+// twice what is, so a string going up and down doesn't reallocate
+struct geometric {
+    static size_t grow( size_t capacity, size_t needed ) {
+        return ( 2 * capacity > needed ) ? 2 * capacity : needed;
+    }
+    static size_t shrink( size_t capacity, size_t used ) {
+        return ( used < capacity / 4 ) ? 2 * used : capacity;
+    }
+};
+
+// what is needed and no more: the least memory, a reallocation every
+// time the string grows past a block. For strings sized once
+struct exact {
+    static size_t grow( size_t capacity, size_t needed ) {
+        return needed;
+    }
+    static size_t shrink( size_t capacity, size_t used ) {
+        return used;
+    }
+};
+
+// grows like geometric and keeps whatever it has until shrink_to_fit(),
+// as std::vector does. The default
+struct nevershrink {
+    static size_t grow( size_t capacity, size_t needed ) {
+        return geometric::grow( capacity, needed );
+    }
+    static size_t shrink( size_t capacity, size_t used ) {
+        return capacity;
+    }
+};
+
+// _Policy, counting the reallocations it asks for: to tune a use site,
+// give it its own _Tag and read counts() after a run
+template<typename _Policy, typename _Tag = void> struct counting {
+    struct stats {
+        std::atomic<uint64_t> grows{0};
+        std::atomic<uint64_t> shrinks{0};
+        std::atomic<uint64_t> blocks{0}; // allocated by the grows
+    };
+    static stats &counts() {
+        static stats s;
+        return s;
+    }
+    static void reset() {
+        counts().grows = 0;
+        counts().shrinks = 0;
+        counts().blocks = 0;
+    }
+
+    static size_t grow( size_t capacity, size_t needed ) {
+        size_t n = _Policy::grow( capacity, needed );
+        counts().grows.fetch_add( 1, std::memory_order_relaxed );
+        counts().blocks.fetch_add( n, std::memory_order_relaxed );
+        return n;
+    }
+    static size_t shrink( size_t capacity, size_t used ) {
+        size_t n = _Policy::shrink( capacity, used );
+        if( n < capacity ) {
+            counts().shrinks.fetch_add( 1, std::memory_order_relaxed );
+        }
+        return n;
+    }
+};
+
+} // namespace growth
+
 
 template<unsigned int _InitialBitCapacity, 
         bool _AllowExpand,
         bool _AutoZeroInit,
-        typename _StorageType > class bitstring {
+        typename _StorageType,
+        typename _GrowthPolicy = growth::nevershrink > class bitstring {
 
 public:
     using BlockType = typename _StorageType::value_type;
+    // what read() and write() take: 64 bits, or a whole block if wider
+    using ValueType = typename std::conditional<(sizeof(BlockType) < sizeof(uint64_t)),
+                                                uint64_t, BlockType>::type;
+    // noallocator for storage that doesn't take one; with an allocator,
+    // std containers (std::pmr::vector of bitstrings, say) pass theirs on
+    using allocator_type = typename storageallocator<_StorageType>::type;
 public:
-    bitstring( ): usedBlocks(0), totalUsedBits(0), usedBits(bitsInBlock) {
+    bitstring( ): usedBlocks(0), usedBits(bitsInBlock), totalUsedBits(0) {
         if( _AllowExpand ) {
             resizer.reserve( storage, intialBlocks );
         } else {
@@ -33,8 +185,8 @@ public:
     // default assignment operator ok
     // default destructor ok
     // add special constructor - only useful for dynamic size
-    bitstring( unsigned int rtInitBits ): usedBlocks(0), totalUsedBits(0), usedBits(bitsInBlock) {
-        unsigned int iblocks = (rtInitBits - bitsInBlock - 1 )  / bitsInBlock;
+    bitstring( unsigned int rtInitBits ): usedBlocks(0), usedBits(bitsInBlock), totalUsedBits(0) {
+        unsigned int iblocks = (rtInitBits + bitsInBlock - 1 )  / bitsInBlock; // ceil
         if( _AllowExpand ) {
             resizer.reserve( storage, iblocks );
         } else {
@@ -45,10 +197,10 @@ public:
 
     // copy constructor - plain vanilla
     bitstring(const bitstring &from ):
+            storage(from.storage),
             usedBlocks(from.usedBlocks),
             usedBits(from.usedBits),
-            totalUsedBits(from.totalUsedBits),
-            storage(from.storage) {
+            totalUsedBits(from.totalUsedBits) {
     }
 
     // copy constructor - plain vanilla
@@ -57,29 +209,108 @@ public:
         usedBits = from.usedBits;
         totalUsedBits = from.totalUsedBits;
         storage = from.storage;
+        noteChange( 0 );
         return (*this);
     }
 
 
     // move constructor is just a little special
     bitstring(bitstring &&from ):
+            storage(std::move(from.storage)), // move constructor
             usedBlocks(std::move(from.usedBlocks)),
             usedBits(from.usedBits),
-            totalUsedBits(std::move(from.totalUsedBits)),
-            storage(std::move(from.storage)) { // move constructor
+            totalUsedBits(std::move(from.totalUsedBits)) {
         // empty state is special
+        from.usedBlocks = 0;
         from.usedBits = bitsInBlock;
+        from.totalUsedBits = 0;
+    }
+
+    // move assignment, so moves don't fall back to copying storage
+    bitstring& operator=(bitstring &&from ) {
+        if( this != &from ) {
+            usedBlocks = from.usedBlocks;
+            usedBits = from.usedBits;
+            totalUsedBits = from.totalUsedBits;
+            storage = std::move(from.storage);
+            noteChange( 0 );
+            from.usedBlocks = 0;
+            from.usedBits = bitsInBlock;
+            from.totalUsedBits = 0;
+            from.noteChange( 0 );
+        }
+        return (*this);
+    }
+
+    // allocator-aware versions of the above, for storage that has an
+    // allocator. Storage comes from alloc; for the move, the blocks
+    // are only taken over when the allocators are equal
+    template<typename _Alloc = allocator_type,
+             typename = std::enable_if_t< std::uses_allocator_v<_StorageType, _Alloc> > >
+    explicit bitstring( const _Alloc &alloc ):
+            storage(alloc), usedBlocks(0), usedBits(bitsInBlock), totalUsedBits(0) {
+        resizer.reserve( storage, intialBlocks );
+    }
+
+    template<typename _Alloc = allocator_type,
+             typename = std::enable_if_t< std::uses_allocator_v<_StorageType, _Alloc> > >
+    bitstring( const bitstring &from, const _Alloc &alloc ):
+            storage(from.storage, alloc),
+            usedBlocks(from.usedBlocks),
+            usedBits(from.usedBits),
+            totalUsedBits(from.totalUsedBits) {
+    }
+
+    template<typename _Alloc = allocator_type,
+             typename = std::enable_if_t< std::uses_allocator_v<_StorageType, _Alloc> > >
+    bitstring( bitstring &&from, const _Alloc &alloc ):
+            storage(std::move(from.storage), alloc),
+            usedBlocks(from.usedBlocks),
+            usedBits(from.usedBits),
+            totalUsedBits(from.totalUsedBits) {
+        // with different allocators the blocks were moved one by one,
+        // and are still there
+        from.resizer.resize( from.storage, 0 );
+        from.usedBlocks = 0;
+        from.usedBits = bitsInBlock;
+        from.totalUsedBits = 0;
+    }
+
+    // a copy of the bits a view looks at
+    explicit bitstring( const bitstring_view<BlockType> &from ): bitstring() {
+        append( from );
+    }
+
+    // the value of a lazy logical expression (bitstring_expr.h), worked
+    // out in one pass over its operands
+    template<typename _Expr> requires _Expr::isBitExpression
+    bitstring( const _Expr &e ): bitstring() {
+        e.evaluateInto( *this );
+    }
+    template<typename _Expr> requires _Expr::isBitExpression
+    bitstring &operator=( const _Expr &e ) {
+        e.evaluateInto( *this );
+        return (*this);
+    }
+
+    allocator_type get_allocator() const {
+        if constexpr( std::is_same_v<allocator_type, noallocator> ) {
+            return noallocator();
+        } else {
+            return storage.get_allocator();
+        }
     }
 
     bool addBits( BlockType value, unsigned int nBits ) {
         if( (_AllowExpand) || ((totalUsedBits + nBits) <= capacityInBits()) ) {
             unsigned int remainingBits = (bitsInBlock - usedBits);
+            noteChange( totalUsedBits / bitsInBlock );
             
             // force storage to be what we need
             totalUsedBits += nBits;
 
             if( nBits < bitsInBlock ) {
-                value &= ( (1 << nBits) - 1); // cut what we can't use
+                value &= lowMask( nBits ); // cut what we can't use
             }
             if( remainingBits >= nBits ) {
                 // no extra blocks will be needed
@@ -91,13 +322,13 @@ public:
 
             // we will need more storage for sure
             ++usedBlocks;
-            resizer.resize( storage, usedBlocks );
+            sizeStorage( usedBlocks );
 
             if(remainingBits > 0) {
                 unsigned int spilledBits = (nBits - remainingBits);
                 storage[usedBlocks - 2] <<= remainingBits;
                 storage[usedBlocks - 2] |= (value >> spilledBits); //  top
-                storage[usedBlocks - 1] = (value & ((1 << spilledBits) - 1));  // bottom
+                storage[usedBlocks - 1] = (value & lowMask( spilledBits ));  // bottom
                 usedBits = spilledBits;
             } else {
                 // no bits remaining in current int, get a new one
@@ -108,8 +339,258 @@ public:
         }
         return false;
     }
-            
-    BlockType read( unsigned int startingBit, unsigned int nBits ) {
+
+    // one field for the variable-width bulk append
+    struct Field {
+        BlockType value;
+        unsigned int nBits;
+    };
+
+    // bulk append, every value takes the same number of bits.
+    // All or nothing: if it doesn't fit (static storage) nothing is added.
+    bool addBits( std::span<const BlockType> values, unsigned int nBits ) {
+        if( nBits > bitsInBlock ) {
+            nBits = bitsInBlock;
+        }
+        if( !reserveForAppend( values.size() * nBits ) ) {
+            return false;
+        }
+        noteChange( totalUsedBits / bitsInBlock );
+        Accumulator acc = beginAppend();
+        for( BlockType value: values ) {
+            pushField( acc, value, nBits );
+        }
+        endAppend( acc );
+        return true;
+    }
+
+    // bulk append, each field brings its own width
+    bool addBits( std::span<const Field> fields ) {
+        size_t addedBits = 0;
+        for( const Field &f: fields ) {
+            addedBits += ( (f.nBits > bitsInBlock) ? bitsInBlock : f.nBits );
+        }
+        if( !reserveForAppend( addedBits ) ) {
+            return false;
+        }
+        noteChange( totalUsedBits / bitsInBlock );
+        Accumulator acc = beginAppend();
+        for( const Field &f: fields ) {
+            pushField( acc, f.value,
+                       (f.nBits > bitsInBlock) ? bitsInBlock : f.nBits );
+        }
+        endAppend( acc );
+        return true;
+    }
+
+    // concatenation: copy all of src after the last bit of this
+    bool append( const bitstring &src ) {
+        return append( src, 0, src.totalUsedBits );
+    }
+
+    // concatenation of a piece of src, nBits starting at startBit.
+    // All or nothing: if it doesn't fit (static storage) nothing is added.
+    bool append( const bitstring &src, unsigned int startBit, unsigned int nBits ) {
+        if( &src == this ) {
+            // the tail would be overwritten while reading it
+            bitstring copy( src );
+            return append( copy, startBit, nBits );
+        }
+        return appendFrom( src, startBit, nBits );
+    }
+
+    // the same, from a view
+    bool append( const bitstring_view<BlockType> &src ) {
+        return append( src, 0, src.sizeInBits() );
+    }
+    bool append( const bitstring_view<BlockType> &src, unsigned int startBit, unsigned int nBits ) {
+        if( viewsStorage( src ) ) {
+            // growing may move the blocks the view points at
+            bitstring copy( src );
+            return append( copy, startBit, nBits );
+        }
+        return appendFrom( src, startBit, nBits );
+    }
+
+private:
+    // true if the view looks at this string's own blocks
+    bool viewsStorage( const bitstring_view<BlockType> &src ) const {
+        std::less_equal<const BlockType *> notAfter;
+        std::less<const BlockType *> before;
+        const BlockType *blocks = storage.data();
+        return notAfter( blocks, src.data() ) && before( src.data(), blocks + storage.size() );
+    }
+
+    // append for anything with the block access of bitstring and
+    // bitstring_view: sizeInBits, sizeInBlocks, data, blockAt, bitsInBlockAt, read
+    template<typename _Source> bool appendFrom( const _Source &src, unsigned int startBit, unsigned int nBits ) {
+        unsigned int srcBits = src.sizeInBits();
+        if( startBit >= srcBits ) {
+            return true; // nothing there
+        }
+        if( nBits > (srcBits - startBit) ) {
+            nBits = srcBits - startBit;
+        }
+        if( !reserveForAppend( nBits ) ) {
+            return false;
+        }
+
+        unsigned int endBit = startBit + nBits;
+        noteChange( totalUsedBits / bitsInBlock );
+        Accumulator acc = beginAppend();
+        if( (acc.bits == 0) && ((startBit % bitsInBlock) == 0) &&
+                (endBit == srcBits) ) {
+            // block aligned on both sides, layout is the same: plain copy
+            unsigned int firstBlock = startBit / bitsInBlock;
+            unsigned int lastBlock = src.sizeInBlocks() - 1;
+            unsigned int nBlocks = lastBlock + 1 - firstBlock;
+            memcpy( storage.data() + acc.index, src.data() + firstBlock,
+                    (nBlocks - 1) * sizeof(BlockType) );
+            storage[acc.index + nBlocks - 1] = src.blockAt( lastBlock );
+            usedBlocks = acc.index + nBlocks;
+            usedBits = src.bitsInBlockAt( lastBlock );
+            totalUsedBits += nBits;
+            return true;
+        }
+
+        // shifted merge through the accumulator
+        unsigned int pos = startBit;
+        while( pos < endBit ) {
+            unsigned int chunk = ( (endBit - pos) < bitsInBlock ) ? (endBit - pos) : bitsInBlock;
+            unsigned int block = pos / bitsInBlock;
+            if( ((pos % bitsInBlock) == 0) && (chunk == src.bitsInBlockAt(block)) ) {
+                pushField( acc, src.blockAt( block ), chunk ); // the block as is
+            } else {
+                pushField( acc, BlockType( src.read( pos, chunk ) ), chunk );
+            }
+            pos += chunk;
+        }
+        endAppend( acc );
+        return true;
+    }
+
+public:
+
+    bitstring &operator +=( const bitstring &rightop ) {
+        append( rightop );
+        return (*this);
+    }
+
+    friend bitstring operator+( bitstring leftop, const bitstring &rightop ) {
+        leftop.append( rightop );
+        return leftop;
+    }
+
+    // bulk load, for deserializers: the contents are replaced by nBits
+    // bits, which fill( BlockType *blocks, unsigned int nBlocks ) writes
+    // in the layout data() describes. Bits above a partial last block are
+    // cleared afterwards. False (and no change) if static storage is too small.
+    template<typename _Fill> bool loadBlocks( unsigned int nBits, _Fill &&fill ) {
+        unsigned int nBlocks = (nBits + bitsInBlock - 1) / bitsInBlock; // ceil
+        if( _AllowExpand ) {
+            sizeStorage( nBlocks );
+        } else if( nBlocks > storage.size() ) {
+            return false;
+        }
+        noteChange( 0 );
+        fill( storage.data(), nBlocks );
+        usedBlocks = nBlocks;
+        totalUsedBits = nBits;
+        usedBits = (nBlocks > 0) ? (nBits - (nBlocks - 1) * bitsInBlock) : bitsInBlock;
+        if( nBlocks > 0 ) {
+            storage[nBlocks - 1] &= lowMask( usedBits );
+        }
+        return true;
+    }
+
+    // remove nBits starting at startBit, the bits after them move up
+    void erase( unsigned int startBit, unsigned int nBits ) {
+        if( startBit >= totalUsedBits ) {
+            return;
+        }
+        if( nBits > (totalUsedBits - startBit) ) {
+            nBits = totalUsedBits - startBit;
+        }
+        if( nBits == 0 ) {
+            return;
+        }
+
+        unsigned int first = startBit / bitsInBlock;
+        noteChange( first );
+        alignTail();
+        BlockType head = storage[first];
+        shiftBlocksLeft( first, nBits );
+        restoreHead( first, head, startBit % bitsInBlock );
+
+        // everything past the new end is zero now
+        unsigned int newTotalBits = totalUsedBits - nBits;
+        usedBlocks = (newTotalBits + bitsInBlock - 1 ) / bitsInBlock; // ceil
+        usedBits = newTotalBits - ( (usedBlocks > 0) ? (usedBlocks - 1) * bitsInBlock : 0 );
+        if( usedBlocks == 0 ) {
+            usedBits = bitsInBlock; // empty state
+        }
+        totalUsedBits = newTotalBits;
+        unalignTail();
+        sizeStorage( usedBlocks );
+    }
+
+    // insert all of src before startBit, the bits from there on move down.
+    // Returns false (and changes nothing) if it doesn't fit.
+    bool insert( unsigned int startBit, const bitstring &src ) {
+        if( &src == this ) {
+            bitstring copy( src );
+            return insert( startBit, copy );
+        }
+        if( !openGap( startBit, src.totalUsedBits ) ) {
+            return false;
+        }
+        for( unsigned int pos = 0; pos < src.totalUsedBits; pos += bitsInBlock ) {
+            unsigned int chunk = ( (src.totalUsedBits - pos) < bitsInBlock ) ?
+                                    (src.totalUsedBits - pos) : bitsInBlock;
+            writeBlockBits( src.readBlockBits( pos, chunk ), startBit + pos, chunk );
+        }
+        return true;
+    }
+
+    // insert the nBits (up to 64, or a block if wider) of value before startBit
+    bool insert( unsigned int startBit, ValueType value, unsigned int nBits ) {
+        if( nBits > valueBits ) {
+            nBits = valueBits;
+        }
+        if( nBits == 0 ) {
+            return true;
+        }
+        if( !openGap( startBit, nBits ) ) {
+            return false;
+        }
+        return write( value, startBit, nBits );
+    }
+
+    // up to 64 bits (or a block, if wider) from startingBit on
+    ValueType read( unsigned int startingBit, unsigned int nBits ) const {
+        if( nBits <= bitsInBlock ) {
+            return readBlockBits( startingBit, nBits );
+        }
+        // narrow blocks: a block's worth at a time
+        if( nBits > valueBits ) {
+            nBits = valueBits;
+        }
+        ValueType value = 0;
+        while( nBits > 0 ) {
+            unsigned int n = ( nBits < bitsInBlock ) ? nBits : bitsInBlock;
+            value = (value << n) | readBlockBits( startingBit, n );
+            startingBit += n;
+            nBits -= n;
+        }
+        return value;
+    }
+
+private: // single block access
+    // up to a block's worth of bits, spanning at most two blocks
+    BlockType readBlockBits( unsigned int startingBit, unsigned int nBits ) const {
+        if( nBits == 0 ) {
+            return 0;
+        }
         unsigned int startingBlock = startingBit / bitsInBlock;
         unsigned int firstBitInBlock = startingBit % bitsInBlock;
         unsigned int bitsPopulated = ( (startingBlock + 1) < sizeInBlocks() ) ?
@@ -120,8 +601,7 @@ public:
             // no need to mask anything, take all of it
             p1 = storage[startingBlock];
         } else {
-            unsigned int mask1 = ( ( 1 << reverseStartBit ) - 1 );
-            p1 = storage[startingBlock] & mask1;
+            p1 = storage[startingBlock] & lowMask( reverseStartBit );
         }
 
         if( reverseStartBit >= nBits ) {
@@ -141,7 +621,15 @@ public:
                 ( storage[startingBlock] >> (bitsPopulated - bitsFromNextBlock) );
     }
 
+public:
+    // one bit, cheaper than read(pos, 1)
+    bool bitAt( unsigned int pos ) const {
+        unsigned int block = pos / bitsInBlock;
+        return ( storage[block] >> (bitsInBlockAt(block) - 1 - (pos % bitsInBlock)) ) & 1;
+    }
+
     bool resize( unsigned int newTotalBits ) {
+        noteChange( ( (newTotalBits < totalUsedBits) ? newTotalBits : totalUsedBits ) / bitsInBlock );
         if( newTotalBits > totalUsedBits ) {
             unsigned int addedBits = newTotalBits - totalUsedBits;
             unsigned int newnblocks = (newTotalBits + bitsInBlock - 1 ) / bitsInBlock; // ceil
@@ -149,7 +637,7 @@ public:
                 if( !(_AllowExpand) ) {
                     return false;
                 }
-                resizer.resize( storage, newnblocks );
+                sizeStorage( newnblocks );
             }
 
             totalUsedBits = newTotalBits;
@@ -194,7 +682,7 @@ public:
                 storage[usedBlocks - 1] = 0;
                 --usedBlocks;
                 usedBits = bitsInBlock; // prior block full, or empty state
-                resizer.resize( storage, usedBlocks );
+                sizeStorage( usedBlocks );
             } else {
                 // remove a block or more
                 usedBlocks = (newTotalBits + bitsInBlock - 1 ) / bitsInBlock;
@@ -210,7 +698,7 @@ public:
                 if( usedBits == 0 ) {
                     usedBits = bitsInBlock; // meaning last block is full
                 }
-                resizer.resize( storage, usedBlocks );
+                sizeStorage( usedBlocks );
             }
 
             totalUsedBits = newTotalBits;
@@ -219,11 +707,37 @@ public:
         return true;
     }
 
-    bool write( BlockType value, unsigned int startingBit, unsigned int nBits ) {
+    // the low nBits of value (up to 64, or a block if wider) go to startingBit
+    bool write( ValueType value, unsigned int startingBit, unsigned int nBits ) {
         // cap it
+        if( nBits > valueBits ) {
+            nBits = valueBits;
+        }
         if( nBits > bitsInBlock ) {
-            nBits = bitsInBlock;
+            // narrow blocks: size it once, then a block's worth at a time
+            if( (startingBit + nBits ) > totalUsedBits ) {
+                if( !resize(startingBit + nBits) ) {
+                    return false;
+                }
+            }
+            while( nBits > 0 ) {
+                unsigned int n = ( nBits < bitsInBlock ) ? nBits : bitsInBlock;
+                writeBlockBits( BlockType( value >> (nBits - n) ), startingBit, n );
+                startingBit += n;
+                nBits -= n;
+            }
+            return true;
         }
+        return writeBlockBits( BlockType( value ), startingBit, nBits );
+    }
+
+private: // single block access
+    // up to a block's worth of bits, spanning at most two blocks
+    bool writeBlockBits( BlockType value, unsigned int startingBit, unsigned int nBits ) {
+        if( nBits == 0 ) {
+            return true;
+        }
+        value &= lowMask( nBits ); // the rest would spill into the bits before
 
         if( (startingBit + nBits ) > totalUsedBits ) {
             if( !resize(startingBit + nBits) ) {
@@ -237,13 +751,11 @@ public:
         unsigned int bitsPopulated = ( (startingBlock + 1) < sizeInBlocks() ) ?
                                         bitsInBlock : usedBits;
         unsigned int reverseStartBit = bitsPopulated - firstBitInBlock;
+        noteChange( startingBlock );
 
         if( reverseStartBit >= nBits ) {
-            BlockType pmask;
-            if( nBits >= bitsInBlock ) {
-                pmask = ~0;
-            } else {
-                pmask = ( (1 << nBits) - 1 );
+            BlockType pmask = lowMask( nBits );
+            if( nBits < bitsInBlock ) {
                 pmask <<= (reverseStartBit - nBits);
             }
 
@@ -253,7 +765,7 @@ public:
         }
 
         unsigned int bitsBottom = nBits - reverseStartBit;
-        BlockType topmask = ( (1 << reverseStartBit) - 1 );
+        BlockType topmask = lowMask( reverseStartBit );
         storage[startingBlock] &= (~topmask); // clear bottom bits at the top
         storage[startingBlock] |= (value >> bitsBottom );
 
@@ -262,7 +774,7 @@ public:
         bitsPopulated = ( (startingBlock + 1) < sizeInBlocks() ) ?
                                         bitsInBlock : usedBits;
 
-        BlockType bottomMask = ( (1 << bitsBottom) - 1 );
+        BlockType bottomMask = lowMask( bitsBottom );
         unsigned int bitsBehindBottom = (bitsPopulated - bitsBottom);
         BlockType containerBottomMask = (bottomMask << bitsBehindBottom);
 
@@ -272,6 +784,8 @@ public:
         return true;
     }
 
+public:
+
 
 
 
@@ -279,31 +793,172 @@ public:
         return compareWith(comp) == 1;
     }
     bool operator>=(const bitstring &comp) const {
-        return !( (*this) < comp);
+        return compareWith(comp) != -1;
     }
     bool operator<=(const bitstring &comp) const {
-        return !( (*this) > comp);
+        return compareWith(comp) != 1;
     }
     bool operator<(const bitstring &comp) const {
         return compareWith(comp) == -1;
     }
+    std::strong_ordering operator<=>(const bitstring &comp) const {
+        return compareWith(comp) <=> 0;
+    }
     bool operator==(const bitstring &comp) const {
         if( comp.totalUsedBits != totalUsedBits ) {
             return false;
         }
-        return compareWith(comp) == 0;
+        // same length, same layout: the blocks are equal or they aren't
+        return firstDifferentBlock( comp, usedBlocks ) == usedBlocks;
     }
 
+    // logical operations: the result has the length of the left side,
+    // and bits past the end of the right side are left unchanged
     bitstring &operator &=( const bitstring &rightop ) {
-        andWith( rightop );
+        logicWith<simd::LogicOp::And>( rightop );
         return (*this);
     }
 
     bitstring &operator |=( const bitstring &rightop ) {
-        orWith( rightop );
+        logicWith<simd::LogicOp::Or>( rightop );
         return (*this);
     }
 
+    bitstring &operator ^=( const bitstring &rightop ) {
+        logicWith<simd::LogicOp::Xor>( rightop );
+        return (*this);
+    }
+
+    // this &= ~rightop, without building ~rightop
+    bitstring &andNot( const bitstring &rightop ) {
+        logicWith<simd::LogicOp::AndNot>( rightop );
+        return (*this);
+    }
+
+    // the same with a view on the right, the result lands in this
+    bitstring &operator &=( const bitstring_view<BlockType> &rightop ) {
+        logicWith<simd::LogicOp::And>( rightop );
+        return (*this);
+    }
+    bitstring &operator |=( const bitstring_view<BlockType> &rightop ) {
+        logicWith<simd::LogicOp::Or>( rightop );
+        return (*this);
+    }
+    bitstring &operator ^=( const bitstring_view<BlockType> &rightop ) {
+        logicWith<simd::LogicOp::Xor>( rightop );
+        return (*this);
+    }
+    bitstring &andNot( const bitstring_view<BlockType> &rightop ) {
+        logicWith<simd::LogicOp::AndNot>( rightop );
+        return (*this);
+    }
+
+    // &=, |=, ^= or andNot (_Op) with a bitstring or view, the blocks both
+    // sides have in full going to interior( BlockType *blocks,
+    // const BlockType *from, unsigned int nBlocks ) to combine as it likes,
+    // e.g. split over threads (bitstring_parallel.h)
+    template<simd::LogicOp _Op, typename _Source, typename _Interior>
+    bitstring &combineWith( const _Source &rightop, _Interior &&interior ) {
+        logicWith<_Op>( rightop, std::forward<_Interior>( interior ) );
+        return (*this);
+    }
+
+    // invert every bit in place
+    bitstring &flip() {
+        noteChange( 0 );
+        if( usedBlocks > 0 ) {
+            simd::logic<simd::LogicOp::Not>( storage.data(), nullptr,
+                                             usedBlocks * sizeof(BlockType) );
+            storage[usedBlocks - 1] &= lowMask( usedBits ); // keep the unused top clear
+        }
+        return (*this);
+    }
+
+    bitstring operator~() const {
+        bitstring result(*this);
+        result.flip();
+        return result;
+    }
+
+    friend bitstring operator&( bitstring leftop, const bitstring &rightop ) {
+        leftop &= rightop;
+        return leftop;
+    }
+
+    friend bitstring operator|( bitstring leftop, const bitstring &rightop ) {
+        leftop |= rightop;
+        return leftop;
+    }
+
+    friend bitstring operator^( bitstring leftop, const bitstring &rightop ) {
+        leftop ^= rightop;
+        return leftop;
+    }
+
+    // shifting treats the string as one big number, bit 0 being the
+    // most significant: "<<" moves bits toward bit 0, ">>" away from it.
+    // Zeroes come in, the length does not change.
+    bitstring &operator <<=( unsigned int nBits ) {
+        noteChange( 0 );
+        if( nBits >= totalUsedBits ) {
+            zeroBlocks( 0, usedBlocks );
+            return (*this);
+        }
+        if( nBits > 0 ) {
+            alignTail();
+            shiftBlocksLeft( 0, nBits );
+            unalignTail();
+        }
+        return (*this);
+    }
+
+    bitstring &operator >>=( unsigned int nBits ) {
+        noteChange( 0 );
+        if( nBits >= totalUsedBits ) {
+            zeroBlocks( 0, usedBlocks );
+            return (*this);
+        }
+        if( nBits > 0 ) {
+            alignTail();
+            shiftBlocksRight( 0, nBits );
+            unalignTail(); // whatever was pushed past the end falls off here
+        }
+        return (*this);
+    }
+
+    // bits leaving at the front come back at the end
+    bitstring &rotateLeft( unsigned int nBits ) {
+        if( totalUsedBits == 0 ) {
+            return (*this);
+        }
+        nBits %= totalUsedBits;
+        if( nBits == 0 ) {
+            return (*this);
+        }
+        bitstring wrapped( *this );
+        wrapped >>= ( totalUsedBits - nBits );
+        (*this) <<= nBits;
+        logicWith<simd::LogicOp::Or>( wrapped );
+        return (*this);
+    }
+
+    bitstring &rotateRight( unsigned int nBits ) {
+        if( totalUsedBits == 0 ) {
+            return (*this);
+        }
+        return rotateLeft( totalUsedBits - (nBits % totalUsedBits) );
+    }
+
+    friend bitstring operator<<( bitstring leftop, unsigned int nBits ) {
+        leftop <<= nBits;
+        return leftop;
+    }
+
+    friend bitstring operator>>( bitstring leftop, unsigned int nBits ) {
+        leftop >>= nBits;
+        return leftop;
+    }
+
 
     unsigned int sizeInBits() const {
         return totalUsedBits;
@@ -317,6 +972,183 @@ public:
     unsigned int capacityInBits() const {
         return capacityInBlocks() * bitsInBlock;
     }
+
+    // room for nBits without reallocating, whatever the growth policy.
+    // False if static storage is smaller
+    bool reserveBits( unsigned int nBits ) {
+        size_t nBlocks = (size_t(nBits) + bitsInBlock - 1) / bitsInBlock; // ceil
+        if( !(_AllowExpand) ) {
+            return nBlocks <= storage.size();
+        }
+        if( nBlocks > resizer.capacity( storage ) ) {
+            resizer.reserve( storage, nBlocks );
+        }
+        return true;
+    }
+
+    // capacity down to what is used (nothing for static storage)
+    void shrink_to_fit() {
+        resizer.shrink( storage, usedBlocks );
+    }
+
+    // empty, keeping the capacity for the next contents
+    void clear() {
+        noteChange( 0 );
+        resizer.resize( storage, 0 );
+        usedBlocks = 0;
+        usedBits = bitsInBlock;
+        totalUsedBits = 0;
+    }
+
+    // set bit search. Positions count from the first bit; when there
+    // is nothing to find, sizeInBits() is returned.
+    unsigned int findFirst() const {
+        return findFrom( 0 );
+    }
+
+    // first set bit after pos
+    unsigned int findNext( unsigned int pos ) const {
+        return findFrom( pos + 1 );
+    }
+
+    unsigned int findLast() const {
+        for( unsigned int block = usedBlocks; block-- > 0; ) {
+            if( storage[block] != 0 ) {
+                // lowest set bit is the last one in the block
+                return block * bitsInBlock + bitsInBlockAt(block) - 1 -
+                        blockbits::countr_zero( storage[block] );
+            }
+        }
+        return totalUsedBits;
+    }
+
+    unsigned int countOnes() const {
+        unsigned int count = 0;
+        for( unsigned int block = 0; block < usedBlocks; ++block ) {
+            count += blockbits::popcount( storage[block] ); // unused bits are zero
+        }
+        return count;
+    }
+
+    // positions of the set bits, in order:
+    //   for( unsigned int pos: bits.setBits() ) ...
+    class setbits {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = unsigned int;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const unsigned int *;
+            using reference = unsigned int;
+
+            iterator(): source(nullptr), block(0), remaining(0), pos(0) {
+            }
+            iterator( const bitstring *from, unsigned int firstBlock ):
+                    source(from), block(firstBlock), remaining(0), pos(0) {
+                if( block < source->usedBlocks ) {
+                    remaining = source->storage[block];
+                }
+                settle();
+            }
+
+            unsigned int operator*() const {
+                return pos;
+            }
+            iterator &operator++() {
+                // drop the bit we are on, it is the highest one left
+                unsigned int populated = source->bitsInBlockAt( block );
+                remaining &= BlockType( ~( BlockType(1) << (populated - 1 - (pos % bitsInBlock)) ) );
+                settle();
+                return (*this);
+            }
+            iterator operator++(int) {
+                iterator was(*this);
+                ++(*this);
+                return was;
+            }
+            bool operator==( const iterator &other ) const {
+                return pos == other.pos;
+            }
+
+        private:
+            // move to the next block with something in it, if needed
+            void settle() {
+                while( (remaining == 0) && (++block < source->usedBlocks) ) {
+                    remaining = source->storage[block];
+                }
+                if( remaining == 0 ) {
+                    pos = source->totalUsedBits;
+                    return;
+                }
+                unsigned int populated = source->bitsInBlockAt( block );
+                pos = block * bitsInBlock +
+                        ( blockbits::countl_zero( remaining ) - (bitsInBlock - populated) );
+            }
+
+            const bitstring *source;
+            unsigned int block;
+            BlockType remaining; // set bits of the block not visited yet
+            unsigned int pos;
+        };
+
+        setbits( const bitstring &from ): source(from) {
+        }
+        iterator begin() const {
+            return iterator( &source, 0 );
+        }
+        iterator end() const {
+            return iterator( &source, source.usedBlocks );
+        }
+
+    private:
+        const bitstring &source;
+    };
+
+    setbits setBits() const {
+        return setbits( *this );
+    }
+
+    // read-only access to the blocks, for companion structures.
+    // Blocks are filled from the most significant bit down; the last
+    // block holds bitsInBlockAt(sizeInBlocks() - 1) bits, right aligned.
+    const BlockType *data() const {
+        return storage.data();
+    }
+    // one block as stored (the last one right aligned), as with data()
+    BlockType blockAt( unsigned int block ) const {
+        return storage[block];
+    }
+    static constexpr unsigned int bitsPerBlock() {
+        return bitsInBlock;
+    }
+    // bits populated in a block, the last one may be partial
+    unsigned int bitsInBlockAt( unsigned int block ) const {
+        return ( (block + 1) < usedBlocks ) ? bitsInBlock : usedBits;
+    }
+
+    // change tracking, so companion indexes know what to rebuild.
+    // Every change bumps the generation (it wraps around, so compare
+    // for equality only).
+    unsigned int changeGeneration() const {
+        return generation;
+    }
+    // first block that may have changed since generation "since", from
+    // the change log: the newest mark from before the change after it.
+    // Each caller gets its own answer; an old one may come out earlier
+    // than it has to, and 0 when since is older than the log
+    unsigned int firstChangedBlock( unsigned int since ) const {
+        if( since == generation ) {
+            return usedBlocks; // nothing changed
+        }
+        unsigned int changes = generation - since;
+        for( unsigned int i = changeMarks; i-- > 0; ) {
+            if( generation - changeLog[i].generation >= changes - 1 ) {
+                return changeLog[i].block;
+            }
+        }
+        return 0;
+    }
 private:
     // -1:  this is less than comp
     // 1:  this is greater than comp
@@ -338,16 +1170,11 @@ private:
                                     usedBlocks : comp.usedBlocks );
         unsigned int localUsedBits = usedBits;
         unsigned int compUsedBits = comp.usedBits;
-        while( (i + 1) < minBlocks) {
-            if( storage[i] < comp.storage[i] ) {
-                // look no further
-                return -1;
-            }
-            if( storage[i] > comp.storage[i] ) {
-                // look no further
-                return 1;
-            }
-            ++i;
+        // all blocks before the last of the shorter one are full on both
+        // sides, so the first different one decides
+        i = firstDifferentBlock( comp, minBlocks - 1 );
+        if( i < (minBlocks - 1) ) {
+            return (storage[i] < comp.storage[i]) ? -1 : 1;
         }
         
         // getting here means at least one of them
@@ -395,115 +1222,464 @@ private:
     }
 
 
-    void andWith( const bitstring &comp )  {
-        unsigned int i = 0;
-        if( (usedBlocks < 1) || (comp.usedBlocks < 1) ) {
+    // the first of the first nBlocks blocks that differs from comp's,
+    // nBlocks if none do
+    unsigned int firstDifferentBlock( const bitstring &comp, unsigned int nBlocks ) const {
+        return blockbits::firstDifferent( storage.data(), comp.storage.data(), nBlocks );
+    }
+
+    // combine comp into this, block by block. Both sides are aligned at
+    // their first bit, and the result keeps the length of "this":
+    // bits of "this" that comp does not reach are left alone.
+    // comp is a bitstring or a bitstring_view
+    template<simd::LogicOp _Op, typename _Source> void logicWith( const _Source &comp )  {
+        logicWith<_Op>( comp, []( BlockType *blocks, const BlockType *from, unsigned int nBlocks ) {
+            simd::logic<_Op>( blocks, from, nBlocks * sizeof(BlockType) );
+        } );
+    }
+
+    // the same, with the blocks complete on both sides handed to interior
+    template<simd::LogicOp _Op, typename _Source, typename _Interior>
+    void logicWith( const _Source &comp, _Interior &&interior )  {
+        unsigned int compBlocks = comp.sizeInBlocks();
+        if( (usedBlocks < 1) || (compBlocks < 1) ) {
             return;
         }
-        
-        // both sides have data            
+        noteChange( 0 );
+
         // get the shortest one
-        unsigned int minBlocks = ( usedBlocks < comp.usedBlocks ? 
-                                    usedBlocks : comp.usedBlocks );
-        unsigned int localUsedBits = usedBits;
-        unsigned int compUsedBits = comp.usedBits;
-        while( (i + 1) < minBlocks) {
-            storage[i] &= comp.storage[i];
-            ++i;
+        unsigned int minBlocks = ( usedBlocks < compBlocks ?
+                                    usedBlocks : compBlocks );
+        unsigned int i = minBlocks - 1;
+        if( i > 0 ) {
+            // every block before the last shared one is complete on both sides
+            interior( storage.data(), comp.data(), i );
         }
-        
-        if( usedBlocks > minBlocks ) {
-            // local has more blocks than comp, the current block 
-            // is complete
-            if( comp.usedBits >= bitsInBlock ) {
-                storage[i] &= comp.storage[i];
-                return;
-            }
-            localUsedBits = bitsInBlock;
-        } else if( comp.usedBlocks > minBlocks ) {
-            // other side has more blocks
-            if( usedBits >= bitsInBlock ) {
-                storage[i] &= comp.storage[i];
-                return;
-            }
-            compUsedBits = bitsInBlock;
-        }
-        
-        // they are the same length (in ints, 
-        //  so the comparison is down to bits)
-        BlockType comppartial = comp.storage[i];
+
+        // at least one of them is pointing at the LAST block,
+        // which MAY be incomplete
+        unsigned int localUsedBits = ( usedBlocks > minBlocks ) ? bitsInBlock : usedBits;
+        unsigned int compUsedBits = comp.bitsInBlockAt( i );
+        BlockType comppartial = comp.blockAt( i );
+        BlockType untouched = 0; // local bits comp does not reach
 
         if( compUsedBits > localUsedBits ) {
             comppartial >>= (compUsedBits - localUsedBits); // shift the excess part
         } else if(localUsedBits > compUsedBits) {
             unsigned int trailing = (localUsedBits - compUsedBits);
             comppartial <<= trailing; // shift up to align with local
-            comppartial |= ( (1 << trailing) - 1 ); // fill with 1 what we shifted
+            untouched = lowMask( trailing );
         }
 
-        // fill the top part with 1s
-        BlockType compmask;
-        if( localUsedBits < bitsInBlock ) {
-            compmask = (~0); // NULL and mask - all 1's
-            compmask <<= localUsedBits; // create a block of trailing zeroes
-            compmask |= comppartial; // set that block to comppartial
-        } else {
-            compmask = comppartial;
+        BlockType combined = simd::detail::apply<_Op>( storage[i], comppartial );
+        storage[i] = (combined & BlockType(~untouched)) | (storage[i] & untouched);
+    }
+
+
+private: // change tracking
+    // changeLog[i].block is the lowest block changed from generation
+    // changeLog[i].generation on, so the blocks rise toward the newest
+    // mark. A change folds the marks it is under into one; with the log
+    // full the second oldest goes, and the oldest covers for it
+    void noteChange( unsigned int block ) {
+        ++generation;
+        unsigned int from = generation;
+        while( (changeMarks > 0) && (changeLog[changeMarks - 1].block >= block) ) {
+            from = changeLog[--changeMarks].generation;
+        }
+        if( changeMarks == changeLogSize ) {
+            for( unsigned int i = 1; (i + 1) < changeLogSize; ++i ) {
+                changeLog[i] = changeLog[i + 1];
+            }
+            --changeMarks;
+        }
+        changeLog[changeMarks++] = changeMark{ from, block };
+    }
+
+
+private: // search support
+    // first set bit at or after pos
+    unsigned int findFrom( unsigned int pos ) const {
+        if( pos >= totalUsedBits ) {
+            return totalUsedBits;
+        }
+        unsigned int block = pos / bitsInBlock;
+        unsigned int populated = bitsInBlockAt( block );
+        // only bits from pos on: the low (populated - offset) ones
+        BlockType value = storage[block] & lowMask( populated - (pos % bitsInBlock) );
+        while( value == 0 ) {
+            if( ++block >= usedBlocks ) {
+                return totalUsedBits;
+            }
+            value = storage[block]; // zero blocks skipped here
         }
+        populated = bitsInBlockAt( block );
+        return block * bitsInBlock + ( blockbits::countl_zero( value ) - (bitsInBlock - populated) );
+    }
 
-        storage[i] &= compmask;
+
+private: // block shifting support
+    // upper bits of hi, followed by the top of lo (0 < shift < bitsInBlock)
+    static BlockType funnel( BlockType hi, BlockType lo, unsigned int shift ) {
+        return BlockType( (hi << shift) | (lo >> (bitsInBlock - shift)) );
     }
 
+    // move the partial last block to the top, so all blocks
+    // line up like one big number
+    void alignTail() {
+        if( usedBits < bitsInBlock ) {
+            storage[usedBlocks - 1] <<= (bitsInBlock - usedBits);
+        }
+    }
 
+    // back to the usual layout, the padding bits are dropped
+    void unalignTail() {
+        if( usedBits < bitsInBlock ) {
+            storage[usedBlocks - 1] >>= (bitsInBlock - usedBits);
+        }
+    }
 
-    void orWith( const bitstring &comp )  {
-        unsigned int i = 0;
-        if( (usedBlocks < 1) || (comp.usedBlocks < 1) ) {
+    // blocks from "first" on (tail lined up) move nBits toward the
+    // front: whole blocks with memmove, the rest with funnel shifts.
+    // Zeroes come in at the end.
+    void shiftBlocksLeft( unsigned int first, unsigned int nBits ) {
+        BlockType *blocks = storage.data() + first;
+        unsigned int count = usedBlocks - first;
+        unsigned int words = nBits / bitsInBlock;
+        unsigned int shift = nBits % bitsInBlock;
+        if( words >= count ) {
+            zeroBlocks( first, usedBlocks );
             return;
         }
-        
-        // both sides have data            
-        // get the shortest one
-        unsigned int minBlocks = ( usedBlocks < comp.usedBlocks ? 
-                                    usedBlocks : comp.usedBlocks );
-        unsigned int localUsedBits = usedBits;
-        unsigned int compUsedBits = comp.usedBits;
-        while( (i + 1) < minBlocks) {
-            storage[i] |= comp.storage[i];
-            ++i;
+
+        unsigned int kept = count - words;
+        if( words > 0 ) {
+            memmove( blocks, blocks + words, kept * sizeof(BlockType) );
+            zeroBlocks( first + kept, usedBlocks );
         }
-        
-        if( usedBlocks > minBlocks ) {
-            // local has more blocks than comp, the current block 
-            // is complete
-            if( comp.usedBits >= bitsInBlock ) {
-                storage[i] |= comp.storage[i];
-                return;
+        if( shift > 0 ) {
+            for( unsigned int i = 0; (i + 1) < kept; ++i ) {
+                blocks[i] = funnel( blocks[i], blocks[i + 1], shift );
             }
-            localUsedBits = bitsInBlock;
-        } else if( comp.usedBlocks > minBlocks ) {
-            // other side has more blocks
-            if( usedBits >= bitsInBlock ) {
-                storage[i] |= comp.storage[i];
-                return;
+            blocks[kept - 1] <<= shift;
+        }
+    }
+
+    // same, away from the front. Zeroes come in at "first"
+    void shiftBlocksRight( unsigned int first, unsigned int nBits ) {
+        BlockType *blocks = storage.data() + first;
+        unsigned int count = usedBlocks - first;
+        unsigned int words = nBits / bitsInBlock;
+        unsigned int shift = nBits % bitsInBlock;
+        if( words >= count ) {
+            zeroBlocks( first, usedBlocks );
+            return;
+        }
+
+        if( words > 0 ) {
+            memmove( blocks + words, blocks, (count - words) * sizeof(BlockType) );
+            zeroBlocks( first, first + words );
+        }
+        if( shift > 0 ) {
+            for( unsigned int i = count - 1; i > words; --i ) {
+                blocks[i] = funnel( blocks[i - 1], blocks[i], bitsInBlock - shift );
             }
-            compUsedBits = bitsInBlock;
+            blocks[words] >>= shift;
         }
-        
-        // they are the same length (in ints, 
-        //  so the comparison is down to bits)
-        BlockType comppartial = comp.storage[i];
+    }
 
-        if( compUsedBits > localUsedBits ) {
-            comppartial >>= (compUsedBits - localUsedBits); // shift the excess part
-        } else if(localUsedBits > compUsedBits) {
-            unsigned int trailing = (localUsedBits - compUsedBits);
-            comppartial <<= trailing; // shift up to align with local
+    // put back the first "keep" bits of a block (top aligned) after
+    // the rest of it was shifted
+    void restoreHead( unsigned int block, BlockType saved, unsigned int keep ) {
+        if( keep > 0 ) {
+            BlockType headMask = BlockType( ~lowMask( bitsInBlock - keep ) );
+            storage[block] = (saved & headMask) | (storage[block] & BlockType(~headMask));
+        }
+    }
+
+    void zeroBlocks( unsigned int from, unsigned int to ) {
+        if( to > from ) {
+            memset( storage.data() + from, 0, (to - from) * sizeof(BlockType) );
         }
+    }
+
 
-        storage[i] |= comppartial;
+private: // bulk append support
+    // the block being built stays in a register until it is full,
+    // storage is only touched once per block
+    struct Accumulator {
+        BlockType block;
+        unsigned int bits;   // bits held in block (right aligned)
+        unsigned int index;  // where block goes when flushed
+    };
+
+    static constexpr BlockType lowMask( unsigned int nBits ) {
+        return ( nBits >= bitsInBlock ) ? BlockType(~BlockType(0)) :
+                    BlockType( (BlockType(1) << nBits) - 1 );
     }
 
+    // size storage once for everything that is about to be appended
+    bool reserveForAppend( size_t addedBits ) {
+        size_t newnblocks = (totalUsedBits + addedBits + bitsInBlock - 1 ) / bitsInBlock; // ceil
+        if( newnblocks > storage.size() ) {
+            if( !(_AllowExpand) ) {
+                return false;
+            }
+            sizeStorage( newnblocks );
+        }
+        return true;
+    }
+
+    // room for n blocks while streaming: expandable storage takes all
+    // the capacity the policy gives it (the writer trims it back when
+    // flushing), so the next blocks need no check
+    bool ensureBlocks( size_t n ) {
+        if( n > storage.size() ) {
+            if( !(_AllowExpand) ) {
+                return false;
+            }
+            sizeStorage( n );
+            resizer.resize( storage, resizer.capacity( storage ) );
+        }
+        return true;
+    }
+
+    // storage resized to n blocks, room made or given back as
+    // _GrowthPolicy says. For expandable storage its size is always
+    // usedBlocks (outside of a writer), so new blocks come zeroed
+    void sizeStorage( size_t n ) {
+        if( !(_AllowExpand) ) {
+            return;
+        }
+        size_t capacity = resizer.capacity( storage );
+        if( n > capacity ) {
+            resizer.reserve( storage, _GrowthPolicy::grow( capacity, n ) );
+        } else if( n < storage.size() ) {
+            resizer.resize( storage, n );
+            size_t keep = _GrowthPolicy::shrink( capacity, n );
+            if( keep < capacity ) {
+                resizer.shrink( storage, keep );
+            }
+            return;
+        }
+        resizer.resize( storage, n );
+    }
+
+    // make room for nBits at startBit, the bits there move down.
+    // The contents of the gap are left for the caller to write.
+    bool openGap( unsigned int startBit, unsigned int nBits ) {
+        if( nBits == 0 ) {
+            return true;
+        }
+        if( startBit >= totalUsedBits ) {
+            // nothing to move, zeroes up to startBit as with write
+            return resize( startBit + nBits );
+        }
+        if( !resize( totalUsedBits + nBits ) ) {
+            return false;
+        }
+
+        unsigned int first = startBit / bitsInBlock;
+        noteChange( first );
+        alignTail();
+        BlockType head = storage[first];
+        shiftBlocksRight( first, nBits ); // the zeroes just added fall off
+        restoreHead( first, head, startBit % bitsInBlock );
+        unalignTail();
+        return true;
+    }
+
+    Accumulator beginAppend() const {
+        if( usedBits < bitsInBlock ) {
+            // last block is partial, keep filling it
+            return Accumulator{ storage[usedBlocks - 1], usedBits, usedBlocks - 1 };
+        }
+        // full last block, or empty state
+        return Accumulator{ 0, 0, usedBlocks };
+    }
+
+    void pushField( Accumulator &acc, BlockType value, unsigned int nBits ) {
+        value &= lowMask( nBits );
+        unsigned int room = bitsInBlock - acc.bits; // never 0, full blocks get flushed
+        if( nBits < room ) {
+            acc.block = (acc.block << nBits) | value;
+            acc.bits += nBits;
+            return;
+        }
+
+        // this field completes the block
+        unsigned int spilledBits = nBits - room;
+        if( room < bitsInBlock ) {
+            acc.block = (acc.block << room) | (value >> spilledBits);
+        } else {
+            acc.block = value; // whole block in one go
+        }
+        storage[acc.index++] = acc.block;
+        acc.block = value & lowMask( spilledBits );
+        acc.bits = spilledBits;
+    }
+
+    void endAppend( const Accumulator &acc ) {
+        if( acc.bits > 0 ) {
+            storage[acc.index] = acc.block;
+            usedBlocks = acc.index + 1;
+            usedBits = acc.bits;
+        } else {
+            usedBlocks = acc.index;
+            usedBits = bitsInBlock; // last block full, or empty state
+        }
+        totalUsedBits = (usedBlocks > 0) ?
+                ( (usedBlocks - 1) * bitsInBlock + usedBits ) : 0;
+    }
+
+
+public: // sequential access
+    // sequential reader: walks the bits front to back keeping the
+    // next bits in a 64 bit buffer (a block, if wider), storage is only
+    // touched on refill.
+    // Reading past the end yields zero bits.
+    class reader {
+    public:
+        reader( const bitstring &from ): source(from) {
+            seek(0);
+        }
+
+        // next nBits (up to a block) without moving forward
+        BlockType peek( unsigned int nBits ) {
+            if( nBits == 0 ) {
+                return 0;
+            }
+            if( avail < nBits ) {
+                refill();
+                if( (avail < nBits) && (nextBlock < source.usedBlocks) ) {
+                    // the buffer can't take another whole block (wide
+                    // blocks), the rest comes straight from the next one
+                    BufferType next = BufferType( source.storage[nextBlock] ) <<
+                                        (bufferBits - source.bitsInBlockAt( nextBlock ));
+                    return BlockType( (buffer | (next >> avail)) >> (bufferBits - nBits) );
+                }
+            }
+            return BlockType( buffer >> (bufferBits - nBits) );
+        }
+
+        // move forward nBits, any distance
+        void consume( unsigned int nBits ) {
+            if( nBits < avail ) {
+                buffer <<= nBits;
+                avail -= nBits;
+                pos += nBits;
+            } else {
+                seek( pos + nBits );
+            }
+        }
+
+        // next nBits (up to a block), moving forward
+        BlockType readBits( unsigned int nBits ) {
+            BlockType value = peek( nBits );
+            consume( nBits );
+            return value;
+        }
+
+        void seek( unsigned int bitPos ) {
+            pos = bitPos;
+            nextBlock = bitPos / bitsInBlock;
+            buffer = 0;
+            avail = 0;
+            refill();
+            unsigned int skip = bitPos % bitsInBlock;
+            buffer <<= skip;
+            avail = (avail > skip) ? (avail - skip) : 0;
+        }
+
+        unsigned int position() const {
+            return pos;
+        }
+        unsigned int remaining() const {
+            return (pos < source.totalUsedBits) ? (source.totalUsedBits - pos) : 0;
+        }
+        bool atEnd() const {
+            return pos >= source.totalUsedBits;
+        }
+
+    private:
+        using BufferType = typename std::conditional<(sizeof(BlockType) > sizeof(uint64_t)),
+                                                     BlockType, uint64_t>::type;
+        static constexpr unsigned int bufferBits = (sizeof(BufferType) * 8);
+
+        // top up the buffer with whole blocks, left aligned
+        void refill() {
+            while( (avail + bitsInBlock <= bufferBits) &&
+                   (nextBlock < source.usedBlocks) ) {
+                unsigned int bitsPopulated = ( (nextBlock + 1) < source.usedBlocks ) ?
+                                                bitsInBlock : source.usedBits;
+                buffer |= ( BufferType(source.storage[nextBlock]) <<
+                                (bufferBits - avail - bitsPopulated) );
+                avail += bitsPopulated;
+                ++nextBlock;
+            }
+        }
+
+        const bitstring &source;
+        BufferType buffer;      // next bits, left aligned
+        unsigned int avail;     // valid bits in buffer
+        unsigned int nextBlock; // next block to load
+        unsigned int pos;       // bits consumed so far
+    };
+
+
+    // sequential writer: appends to the end of a bitstring, the
+    // partial block is kept in a register and stored once full.
+    // The bitstring is only up to date after flush() (or destruction).
+    class writer {
+    public:
+        writer( bitstring &to ): target(to), acc(to.beginAppend()), firstIndex(acc.index) {
+        }
+        writer( const writer & ) = delete;
+        writer &operator=( const writer & ) = delete;
+        ~writer() {
+            flush();
+        }
+
+        bool writeBits( BlockType value, unsigned int nBits ) {
+            if( nBits > bitsInBlock ) {
+                nBits = bitsInBlock;
+            }
+            // a flush may happen, and the leftover needs a home as well
+            if( !target.ensureBlocks( acc.index +
+                        (acc.bits + nBits + bitsInBlock - 1) / bitsInBlock ) ) {
+                return false;
+            }
+            target.pushField( acc, value, nBits );
+            return true;
+        }
+
+        // bring the target up to date, writing can continue after this
+        void flush() {
+            target.noteChange( firstIndex );
+            target.endAppend( acc );
+            if( _AllowExpand ) {
+                target.sizeStorage( target.usedBlocks );
+            }
+            acc = target.beginAppend();
+            firstIndex = acc.index;
+        }
+
+    private:
+        bitstring &target;
+        Accumulator acc;
+        unsigned int firstIndex; // first block touched since the last flush
+    };
+
+
+protected:
+    // for storage that is more than its blocks, e.g. a mapped file
+    // with a header (mappedbitstring.h)
+    _StorageType &blockStorage() {
+        return storage;
+    }
+    const _StorageType &blockStorage() const {
+        return storage;
+    }
 
 private: // ancillary types to abstract container differences
     template< typename _ContainerType> class VectorSizeManager {
@@ -517,6 +1693,16 @@ private: // ancillary types to abstract container differences
         static size_t capacity( const _ContainerType &c) {
             return c.capacity();
         }
+        // capacity down to n (at least the size), where the container
+        // can give memory back
+        static void shrink( _ContainerType &c, size_t n ) {
+            if constexpr( requires { c.shrink_to_fit(); } ) {
+                size_t used = c.size();
+                c.resize( n );
+                c.shrink_to_fit();
+                c.resize( used );
+            }
+        }
     };
 
     template<typename _ContainerType> class ArraySizeManager {
@@ -530,6 +1716,9 @@ private: // ancillary types to abstract container differences
         static size_t capacity( const _ContainerType &c)  {
             return c.size();
         }
+        static void shrink( _ContainerType &c, size_t n ) {
+            // no support
+        }
     };
     using Resizer = typename std::conditional<_AllowExpand,
                              VectorSizeManager<_StorageType>,
@@ -539,13 +1728,46 @@ private:
 
 private:
     static constexpr unsigned int bitsInBlock = (sizeof(BlockType) * 8);
-    static constexpr unsigned int intialBlocks = (_InitialBitCapacity - bitsInBlock - 1 )  / bitsInBlock;
+    static constexpr unsigned int valueBits = (sizeof(ValueType) * 8);
+    static constexpr unsigned int intialBlocks = (_InitialBitCapacity + bitsInBlock - 1 )  / bitsInBlock; // ceil
     _StorageType storage;
     unsigned int usedBlocks;
     unsigned int usedBits; // on the last block
     unsigned int totalUsedBits;
+    unsigned int generation = 0; // bumped on every change
+    struct changeMark {
+        unsigned int generation;
+        unsigned int block;
+    };
+    static constexpr unsigned int changeLogSize = 4;
+    changeMark changeLog[changeLogSize] = {};
+    unsigned int changeMarks = 0; // in changeLog, oldest first
 };
 
 
 
+// number of leading bits a and b have in common. Each side is a
+// bitstring or a bitstring_view, with the same block type
+template<typename _A, typename _B> unsigned int commonPrefixLength( const _A &a, const _B &b ) {
+    using BlockType = typename _A::BlockType;
+    static_assert( std::is_same<BlockType, typename _B::BlockType>::value,
+                   "both sides must use the same block type" );
+    constexpr unsigned int bitsInBlock = _A::bitsPerBlock();
+    unsigned int shorter = ( a.sizeInBits() < b.sizeInBits() ) ? a.sizeInBits() : b.sizeInBits();
+    unsigned int nBlocks = (shorter + bitsInBlock - 1) / bitsInBlock;
+    if( nBlocks == 0 ) {
+        return 0;
+    }
+    // the blocks before the last one compared are full on both sides
+    unsigned int i = blockbits::firstDifferent( a.data(), b.data(), nBlocks - 1 );
+    // that block: a partial last block lined up with the full one
+    BlockType x = BlockType( a.blockAt( i ) << (bitsInBlock - a.bitsInBlockAt( i )) ) ^
+                  BlockType( b.blockAt( i ) << (bitsInBlock - b.bitsInBlockAt( i )) );
+    if( x == 0 ) {
+        return shorter; // only for the last block: the ones before differ
+    }
+    unsigned int pos = i * bitsInBlock + blockbits::countl_zero( x );
+    return ( pos < shorter ) ? pos : shorter;
+}
+
 } // namespace lxutil
\ No newline at end of file
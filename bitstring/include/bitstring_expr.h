@@ -0,0 +1,325 @@
+#pragma once
+
+// FILE: bitstring_expr.h
+// PURPOSE: lazy logical expressions over bitstrings and views, for
+//          filters combining several bitmaps at once:
+//              r = (lazy(a) & b) | (lazy(c) & ~lazy(d));
+//          builds a small tree of nodes, and the assignment works it
+//          out block by block in one pass over the operands: no
+//          temporaries and no pass per operator. countOnes() and any()
+//          reduce an expression the same way, without storing it.
+//
+// lazy() starts an expression; from there &, |, ^, ~ and andNot()
+// take bitstrings, views and other expressions. Only that fuses: the
+// operators of bitstring itself stay eager, so (a & b) | (c & ~d) on
+// plain bitstrings still makes a temporary per operator. Lengths follow &=, |=,
+// ^= and andNot: the result is as long as its left side, and bits of
+// the left side past the end of the right side are left as they are.
+// Expressions refer to their operands, which must outlive them and not
+// change in between (views are copied, they are small).
+//
+// Blocks every operand has in full go through one plain loop, which
+// the compiler vectorizes at -O3 (the CMake Release build); the last
+// blocks, where lengths differ, go one at a time like logicWith's.
+
+#include <bitstring_core.h>
+#include <bitstring_view.h>
+#include <type_traits>
+
+namespace lxutil {
+namespace bitexpr {
+
+template<typename _Node> class expression;
+
+template<typename _T> constexpr bool isExpression = std::is_base_of_v<expression<_T>, _T>;
+
+// a bitstring or view: anything with the blocks of one
+template<typename _T> constexpr bool isOperand = isExpression<_T> ||
+    requires( const _T &s ) { s.data(); s.blockAt( 0u ); s.bitsInBlockAt( 0u ); s.sizeInBits(); };
+
+template<typename _BlockType> constexpr _BlockType lowMask( unsigned int n ) {
+    return ( n >= sizeof(_BlockType) * 8 ) ? _BlockType(~_BlockType(0)) :
+                _BlockType( (_BlockType(1) << n) - 1 );
+}
+
+// what the nodes have in common. A node has the block accessors of a
+// bitstring (sizeInBits, sizeInBlocks, bitsInBlockAt, blockAt), plus
+// fullBlocks(): how many leading blocks are complete in every operand,
+// interior(): a cursor whose at( i ) is block i for those, and
+// aliases( blocks ): whether it reads blocks
+template<typename _Node> class expression {
+public:
+    static constexpr bool isBitExpression = true;
+
+    unsigned int countOnes() const {
+        const _Node &e = node();
+        unsigned int count = 0;
+        unsigned int full = e.fullBlocks();
+        auto in = e.interior();
+        for( unsigned int i = 0; i < full; ++i ) {
+            count += blockbits::popcount( in.at( i ) );
+        }
+        for( unsigned int i = full; i < e.sizeInBlocks(); ++i ) {
+            count += blockbits::popcount( e.blockAt( i ) );
+        }
+        return count;
+    }
+
+    // true at the first one found
+    bool any() const {
+        const _Node &e = node();
+        unsigned int full = e.fullBlocks();
+        auto in = e.interior();
+        for( unsigned int i = 0; i < full; ++i ) {
+            if( in.at( i ) != 0 ) {
+                return true;
+            }
+        }
+        for( unsigned int i = full; i < e.sizeInBlocks(); ++i ) {
+            if( e.blockAt( i ) != 0 ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // replaces the contents of bits with the result; false if static
+    // storage is too small. bits may be one of the operands
+    template<typename _Bits> bool evaluateInto( _Bits &bits ) const {
+        using BlockType = typename _Bits::BlockType;
+        const _Node &e = node();
+        static_assert( std::is_same<BlockType, typename _Node::BlockType>::value,
+                       "the result must have the operands' block type" );
+        if( (bits.sizeInBlocks() > 0) && e.aliases( bits.data() ) &&
+            (e.sizeInBlocks() > bits.sizeInBlocks()) ) {
+            // growing bits could move the blocks being read
+            _Bits result;
+            if( !e.evaluateInto( result ) ) {
+                return false;
+            }
+            bits = std::move( result );
+            return true;
+        }
+        // block i of the result only reads blocks i of the operands,
+        // so bits can be written while it is being read
+        return bits.loadBlocks( e.sizeInBits(), [&]( BlockType *blocks, unsigned int nBlocks ) {
+            unsigned int full = e.fullBlocks();
+            auto in = e.interior();
+            for( unsigned int i = 0; i < full; ++i ) {
+                blocks[i] = in.at( i );
+            }
+            for( unsigned int i = full; i < nBlocks; ++i ) {
+                blocks[i] = e.blockAt( i );
+            }
+        } );
+    }
+
+private:
+    const _Node &node() const {
+        return static_cast<const _Node &>( *this );
+    }
+};
+
+// a bitstring or view; views are held by value
+template<typename _Source> class leaf: public expression< leaf<_Source> > {
+    template<typename _T> struct holder {
+        using type = const _T &;
+    };
+    template<typename _B> struct holder< bitstring_view<_B> > {
+        using type = bitstring_view<_B>;
+    };
+public:
+    using BlockType = typename _Source::BlockType;
+
+    explicit leaf( const _Source &src ): src(src) {}
+
+    unsigned int sizeInBits() const {
+        return src.sizeInBits();
+    }
+    unsigned int sizeInBlocks() const {
+        return src.sizeInBlocks();
+    }
+    unsigned int bitsInBlockAt( unsigned int block ) const {
+        return src.bitsInBlockAt( block );
+    }
+    BlockType blockAt( unsigned int block ) const {
+        return src.blockAt( block );
+    }
+    unsigned int fullBlocks() const {
+        return ( src.sizeInBlocks() > 0 ) ? (src.sizeInBlocks() - 1) : 0;
+    }
+
+    struct cursor {
+        const BlockType *blocks;
+        BlockType at( unsigned int i ) const {
+            return blocks[i];
+        }
+    };
+    cursor interior() const {
+        return { src.data() };
+    }
+
+    bool aliases( const void *blocks ) const {
+        return static_cast<const void *>( src.data() ) == blocks;
+    }
+
+private:
+    typename holder<_Source>::type src;
+};
+
+// left _Op right, aligned at the first bit as logicWith does
+template<simd::LogicOp _Op, typename _L, typename _R> class binary: public expression< binary<_Op, _L, _R> > {
+public:
+    using BlockType = typename _L::BlockType;
+    static_assert( std::is_same<BlockType, typename _R::BlockType>::value,
+                   "both sides must use the same block type" );
+
+    binary( const _L &left, const _R &right ): left(left), right(right) {}
+
+    unsigned int sizeInBits() const {
+        return left.sizeInBits();
+    }
+    unsigned int sizeInBlocks() const {
+        return left.sizeInBlocks();
+    }
+    unsigned int bitsInBlockAt( unsigned int block ) const {
+        return left.bitsInBlockAt( block );
+    }
+
+    BlockType blockAt( unsigned int block ) const {
+        BlockType mine = left.blockAt( block );
+        unsigned int rightBlocks = right.sizeInBlocks();
+        if( block >= rightBlocks ) {
+            return mine; // the right side doesn't reach
+        }
+        unsigned int shared = ( left.sizeInBlocks() < rightBlocks ) ? left.sizeInBlocks() : rightBlocks;
+        BlockType comp = right.blockAt( block );
+        if( (block + 1) < shared ) {
+            return simd::detail::apply<_Op>( mine, comp );
+        }
+        // the last shared block: line the right side up with the left's
+        unsigned int used = left.bitsInBlockAt( block );
+        unsigned int compUsed = right.bitsInBlockAt( block );
+        BlockType untouched = 0;
+        if( compUsed > used ) {
+            comp >>= (compUsed - used);
+        } else if( used > compUsed ) {
+            comp <<= (used - compUsed);
+            untouched = lowMask<BlockType>( used - compUsed );
+        }
+        return BlockType( (simd::detail::apply<_Op>( mine, comp ) & BlockType(~untouched)) | (mine & untouched) );
+    }
+
+    unsigned int fullBlocks() const {
+        unsigned int l = left.fullBlocks();
+        unsigned int r = right.fullBlocks();
+        return ( l < r ) ? l : r;
+    }
+
+    struct cursor {
+        decltype( std::declval<const _L &>().interior() ) l;
+        decltype( std::declval<const _R &>().interior() ) r;
+        BlockType at( unsigned int i ) const {
+            return simd::detail::apply<_Op>( l.at( i ), r.at( i ) );
+        }
+    };
+    cursor interior() const {
+        return { left.interior(), right.interior() };
+    }
+
+    bool aliases( const void *blocks ) const {
+        return left.aliases( blocks ) || right.aliases( blocks );
+    }
+
+private:
+    _L left;
+    _R right;
+};
+
+// every bit inverted, the length kept
+template<typename _X> class inverse: public expression< inverse<_X> > {
+public:
+    using BlockType = typename _X::BlockType;
+
+    explicit inverse( const _X &x ): x(x) {}
+
+    unsigned int sizeInBits() const {
+        return x.sizeInBits();
+    }
+    unsigned int sizeInBlocks() const {
+        return x.sizeInBlocks();
+    }
+    unsigned int bitsInBlockAt( unsigned int block ) const {
+        return x.bitsInBlockAt( block );
+    }
+    BlockType blockAt( unsigned int block ) const {
+        return BlockType( ~x.blockAt( block ) ) & lowMask<BlockType>( x.bitsInBlockAt( block ) );
+    }
+    unsigned int fullBlocks() const {
+        return x.fullBlocks();
+    }
+
+    struct cursor {
+        decltype( std::declval<const _X &>().interior() ) in;
+        BlockType at( unsigned int i ) const {
+            return BlockType( ~in.at( i ) );
+        }
+    };
+    cursor interior() const {
+        return { x.interior() };
+    }
+
+    bool aliases( const void *blocks ) const {
+        return x.aliases( blocks );
+    }
+
+private:
+    _X x;
+};
+
+template<typename _T> auto operand( const _T &x ) {
+    if constexpr( isExpression<_T> ) {
+        return x;
+    } else {
+        return leaf<_T>( x );
+    }
+}
+
+template<simd::LogicOp _Op, typename _L, typename _R> auto combine( const _L &l, const _R &r ) {
+    using Left = decltype( operand( l ) );
+    using Right = decltype( operand( r ) );
+    return binary<_Op, Left, Right>( operand( l ), operand( r ) );
+}
+
+// an expression on either side, a bitstring or view on the other
+template<typename _L, typename _R> requires (isExpression<_L> || isExpression<_R>) && isOperand<_L> && isOperand<_R>
+auto operator&( const _L &l, const _R &r ) {
+    return combine<simd::LogicOp::And>( l, r );
+}
+template<typename _L, typename _R> requires (isExpression<_L> || isExpression<_R>) && isOperand<_L> && isOperand<_R>
+auto operator|( const _L &l, const _R &r ) {
+    return combine<simd::LogicOp::Or>( l, r );
+}
+template<typename _L, typename _R> requires (isExpression<_L> || isExpression<_R>) && isOperand<_L> && isOperand<_R>
+auto operator^( const _L &l, const _R &r ) {
+    return combine<simd::LogicOp::Xor>( l, r );
+}
+template<typename _X> requires isExpression<_X>
+auto operator~( const _X &x ) {
+    return inverse<_X>( x );
+}
+
+} // namespace bitexpr
+
+// the start of an expression: a bitstring or view as a lazy operand
+template<typename _Source> bitexpr::leaf<_Source> lazy( const _Source &bits ) {
+    return bitexpr::leaf<_Source>( bits );
+}
+
+// l & ~r, as bitstring::andNot
+template<typename _L, typename _R> requires bitexpr::isOperand<_L> && bitexpr::isOperand<_R>
+auto andNot( const _L &l, const _R &r ) {
+    return bitexpr::combine<simd::LogicOp::AndNot>( l, r );
+}
+
+} // namespace lxutil
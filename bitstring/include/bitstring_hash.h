@@ -0,0 +1,122 @@
+#pragma once
+
+// FILE: bitstring_hash.h
+// PURPOSE: hashing for bitstring, so it can key std::unordered_map and
+//          std::unordered_set as well as std::map.
+//
+// The hash runs over a canonical form of the bits: 64 bit words, filled
+// from the first bit on, the last word zero padded, plus the length.
+// Equal bit sequences hash the same whatever the block type or storage
+// (a staticbitstring and a dynamicbitstring holding the same bits agree).
+// Words are mixed two at a time with a wyhash-style multiply-fold.
+
+#include <bitstring_core.h>
+#include <functional> // std::hash
+#include <stdint.h>
+
+namespace lxutil {
+
+namespace hashdetail {
+
+// 64x64 -> 128 multiply, folded back to 64 bits
+inline uint64_t mum( uint64_t a, uint64_t b ) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = a;
+    r *= b;
+    return uint64_t(r) ^ uint64_t(r >> 64);
+#else
+    uint64_t ha = a >> 32, la = uint32_t(a);
+    uint64_t hb = b >> 32, lb = uint32_t(b);
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = (t < rl);
+    uint64_t lo = t + (rm1 << 32);
+    c += (lo < t);
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
+
+constexpr uint64_t secret0 = 0xa0761d6478bd642full;
+constexpr uint64_t secret1 = 0xe7037ed1a0b428dbull;
+constexpr uint64_t secret2 = 0x8ebc6af09c88c6e3ull;
+
+} // namespace hashdetail
+
+
+template<unsigned int _InitialBitCapacity, bool _AllowExpand, bool _AutoZeroInit, typename _StorageType,
+         typename _GrowthPolicy>
+uint64_t hashBits( const bitstring<_InitialBitCapacity, _AllowExpand, _AutoZeroInit, _StorageType, _GrowthPolicy> &bits,
+                   uint64_t seed = 0 ) {
+    using BlockType = typename _StorageType::value_type;
+    constexpr unsigned int bitsInBlock = sizeof(BlockType) * 8;
+    static_assert( (64 % bitsInBlock) == 0 || bitsInBlock == 128, "unsupported block width" );
+
+    const BlockType *blocks = bits.data();
+    unsigned int nBlocks = bits.sizeInBlocks();
+    uint64_t h = seed ^ hashdetail::secret0;
+
+    uint64_t pending = 0;   // a word waiting for its pair
+    bool havePending = false;
+    auto take = [&]( uint64_t word ) {
+        if( havePending ) {
+            h = hashdetail::mum( pending ^ hashdetail::secret1, word ^ h );
+            havePending = false;
+        } else {
+            pending = word;
+            havePending = true;
+        }
+    };
+
+    // gather blocks into canonical words
+    uint64_t word = 0;
+    unsigned int wordBits = 0;
+    for( unsigned int i = 0; i < nBlocks; ++i ) {
+        BlockType block = blocks[i];
+        unsigned int populated = bits.bitsInBlockAt( i );
+        if( populated < bitsInBlock ) {
+            block <<= (bitsInBlock - populated); // the partial last block, lined up
+        }
+        if constexpr( bitsInBlock > 64 ) {
+            take( uint64_t( block >> 64 ) );
+            if( populated > 64 ) { // else all padding, past the last word
+                take( uint64_t( block ) );
+            }
+        } else if constexpr( bitsInBlock == 64 ) {
+            take( block );
+        } else {
+            word = (word << bitsInBlock) | block;
+            wordBits += bitsInBlock;
+            if( wordBits == 64 ) {
+                take( word );
+                word = 0;
+                wordBits = 0;
+            }
+        }
+    }
+    if( wordBits > 0 ) {
+        take( word << (64 - wordBits) ); // zero padded
+    }
+    if( havePending ) {
+        take( 0 );
+    }
+
+    return hashdetail::mum( h ^ hashdetail::secret2,
+                            uint64_t(bits.sizeInBits()) ^ hashdetail::secret1 );
+}
+
+} // namespace lxutil
+
+
+namespace std {
+
+template<unsigned int _InitialBitCapacity, bool _AllowExpand, bool _AutoZeroInit, typename _StorageType,
+         typename _GrowthPolicy>
+struct hash< lxutil::bitstring<_InitialBitCapacity, _AllowExpand, _AutoZeroInit, _StorageType, _GrowthPolicy> > {
+    size_t operator()( const lxutil::bitstring<_InitialBitCapacity, _AllowExpand,
+                                               _AutoZeroInit, _StorageType, _GrowthPolicy> &bits ) const {
+        return size_t( lxutil::hashBits( bits ) );
+    }
+};
+
+} // namespace std
@@ -0,0 +1,397 @@
+#pragma once
+
+// FILE: bitstring_parallel.h
+// PURPOSE: bulk operations on huge bitstrings split over threads:
+//          logical operations, compare and common prefix, countOnes,
+//          serialize and deserialize. Below threshold() bytes they
+//          run serially, as the threads would cost more than they save.
+//
+// EXECUTOR: the work goes to an executor, any object with
+//          unsigned int concurrency() const;
+//          template<typename _Fn> void run( unsigned int nTasks, _Fn &&fn );
+//          where run() calls fn( task ) once for each task in [0, nTasks),
+//          on whatever threads it has, and returns when all are done.
+//          threadpool is one; without one, defaultPool() is used.
+//
+// CHUNKS: blocks are split into chunks that start on 64 byte (cache
+//          line) boundaries of the written memory, so no two threads
+//          write to the same line.
+
+#include <bitstring_core.h>
+#include <bitstring_serial.h>
+#include <atomic>
+#include <compare>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace lxutil {
+namespace parallel {
+
+// a fixed set of threads, the caller being one of them. One run() at a
+// time; a task must not call run() on the same pool
+class threadpool {
+public:
+    // nThreads in all, counting the caller; 0 for one per core
+    explicit threadpool( unsigned int nThreads = 0 ) {
+        if( nThreads == 0 ) {
+            nThreads = std::thread::hardware_concurrency();
+        }
+        nWorkers = ( nThreads > 1 ) ? (nThreads - 1) : 0;
+        for( unsigned int i = 0; i < nWorkers; ++i ) {
+            workers.emplace_back( [this]() { work(); } );
+        }
+    }
+
+    threadpool( const threadpool & ) = delete;
+    threadpool &operator=( const threadpool & ) = delete;
+
+    ~threadpool() {
+        {
+            std::lock_guard<std::mutex> hold( mutex );
+            stopping = true;
+        }
+        wake.notify_all();
+        for( auto &w: workers ) {
+            w.join();
+        }
+    }
+
+    unsigned int concurrency() const {
+        return nWorkers + 1;
+    }
+
+    template<typename _Fn> void run( unsigned int nTasks, _Fn &&fn ) {
+        if( (nTasks <= 1) || (nWorkers == 0) ) {
+            for( unsigned int t = 0; t < nTasks; ++t ) {
+                fn( t );
+            }
+            return;
+        }
+        std::lock_guard<std::mutex> one( running );
+        std::function<void( unsigned int )> job( std::ref( fn ) );
+        unsigned int mine;
+        {
+            std::lock_guard<std::mutex> hold( mutex );
+            task = &job;
+            taskCount = nTasks;
+            finished = 0;
+            mine = ++round;
+            next = uint64_t( mine ) << 32;
+        }
+        wake.notify_all();
+        doTasks( &job, nTasks, mine );
+        std::unique_lock<std::mutex> hold( mutex );
+        done.wait( hold, [&]() { return finished == taskCount; } );
+        task = nullptr;
+    }
+
+private:
+    void work() {
+        unsigned int seen = 0;
+        while( true ) {
+            std::function<void( unsigned int )> *job;
+            unsigned int nTasks;
+            {
+                std::unique_lock<std::mutex> hold( mutex );
+                wake.wait( hold, [&]() { return stopping || (round != seen); } );
+                if( stopping ) {
+                    return;
+                }
+                seen = round;
+                job = task;
+                nTasks = taskCount;
+            }
+            doTasks( job, nTasks, seen );
+        }
+    }
+
+    // tasks of round mine until there are none left. next holds the
+    // round in its top half, so a thread still in an older round can't
+    // claim a task of a newer one
+    void doTasks( std::function<void( unsigned int )> *job, unsigned int nTasks, unsigned int mine ) {
+        unsigned int ran = 0;
+        uint64_t claim = next.load();
+        while( (uint32_t( claim >> 32 ) == mine) && (uint32_t( claim ) < nTasks) ) {
+            if( next.compare_exchange_weak( claim, claim + 1 ) ) {
+                (*job)( uint32_t( claim ) );
+                ++ran;
+                claim = next.load();
+            }
+        }
+        if( ran > 0 ) {
+            std::lock_guard<std::mutex> hold( mutex );
+            finished += ran;
+            if( finished == taskCount ) {
+                done.notify_all();
+            }
+        }
+    }
+
+    unsigned int nWorkers;
+    std::vector<std::thread> workers;
+    std::mutex running; // one run() at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void( unsigned int )> *task = nullptr;
+    unsigned int taskCount = 0;
+    std::atomic<uint64_t> next { 0 }; // round << 32 | next task
+    unsigned int finished = 0;
+    unsigned int round = 0;
+    bool stopping = false;
+};
+
+// shared by the calls that don't bring an executor
+inline threadpool &defaultPool() {
+    static threadpool pool;
+    return pool;
+}
+
+inline size_t &thresholdRef() {
+    static size_t bytes = size_t(1) << 20;
+    return bytes;
+}
+
+// below this many bytes (of the larger side), the operations run serially
+inline size_t threshold() {
+    return thresholdRef();
+}
+inline void setThreshold( size_t bytes ) {
+    thresholdRef() = bytes;
+}
+
+
+namespace detail {
+
+// nBlocks blocks from base split into about four chunks a thread, each
+// starting on a cache line boundary of base (but the first)
+struct chunks {
+    template<typename _BlockType> chunks( const _BlockType *base, unsigned int nBlocks, unsigned int concurrency ) {
+        constexpr unsigned int lineBlocks = ( sizeof(_BlockType) < 64 ) ? (64 / sizeof(_BlockType)) : 1;
+        unsigned int misaligned = (unsigned int)( (reinterpret_cast<uintptr_t>( base ) % 64) / sizeof(_BlockType) );
+        head = ( misaligned == 0 ) ? 0 : (lineBlocks - misaligned);
+        if( head > nBlocks ) {
+            head = nBlocks;
+        }
+        size = (nBlocks + 4 * concurrency - 1) / (4 * concurrency);
+        size = (size + lineBlocks - 1) / lineBlocks * lineBlocks; // whole lines
+        if( size == 0 ) {
+            size = lineBlocks;
+        }
+        total = nBlocks;
+        count = 1 + (nBlocks - head + size - 1) / size;
+    }
+    // chunk i is [begin(i), end(i)), chunk 0 the blocks up to the first line
+    unsigned int begin( unsigned int i ) const {
+        return ( i == 0 ) ? 0 : ( head + (i - 1) * size );
+    }
+    unsigned int end( unsigned int i ) const {
+        unsigned int e = head + i * size;
+        return ( e < total ) ? e : total;
+    }
+
+    unsigned int head;
+    unsigned int size;
+    unsigned int total;
+    unsigned int count;
+};
+
+// enough blocks for threads, a full one at least besides the last
+template<typename _Bits> bool worthIt( const _Bits &bits ) {
+    return (bits.sizeInBlocks() > 1) &&
+           (size_t( bits.sizeInBlocks() ) * sizeof(typename _Bits::BlockType) >= threshold());
+}
+
+template<simd::LogicOp _Op, typename _Bits, typename _Source, typename _Exec>
+_Bits &logic( _Bits &bits, const _Source &rightop, _Exec &exec ) {
+    using BlockType = typename _Bits::BlockType;
+    if( !worthIt( bits ) ) {
+        return bits.template combineWith<_Op>( rightop, []( BlockType *blocks, const BlockType *from, unsigned int n ) {
+            simd::logic<_Op>( blocks, from, n * sizeof(BlockType) );
+        } );
+    }
+    return bits.template combineWith<_Op>( rightop, [&]( BlockType *blocks, const BlockType *from, unsigned int n ) {
+        chunks parts( blocks, n, exec.concurrency() );
+        exec.run( parts.count, [&]( unsigned int c ) {
+            unsigned int b = parts.begin( c );
+            unsigned int e = parts.end( c );
+            if( e > b ) {
+                simd::logic<_Op>( blocks + b, from + b, (e - b) * sizeof(BlockType) );
+            }
+        } );
+    } );
+}
+
+} // namespace detail
+
+
+// the logical operations of bitstring (&=, |=, ^=, andNot), rightop a
+// bitstring or bitstring_view; same results, only faster
+template<typename _Bits, typename _Source, typename _Exec>
+_Bits &andWith( _Bits &bits, const _Source &rightop, _Exec &exec ) {
+    return detail::logic<simd::LogicOp::And>( bits, rightop, exec );
+}
+template<typename _Bits, typename _Source> _Bits &andWith( _Bits &bits, const _Source &rightop ) {
+    return andWith( bits, rightop, defaultPool() );
+}
+template<typename _Bits, typename _Source, typename _Exec>
+_Bits &orWith( _Bits &bits, const _Source &rightop, _Exec &exec ) {
+    return detail::logic<simd::LogicOp::Or>( bits, rightop, exec );
+}
+template<typename _Bits, typename _Source> _Bits &orWith( _Bits &bits, const _Source &rightop ) {
+    return orWith( bits, rightop, defaultPool() );
+}
+template<typename _Bits, typename _Source, typename _Exec>
+_Bits &xorWith( _Bits &bits, const _Source &rightop, _Exec &exec ) {
+    return detail::logic<simd::LogicOp::Xor>( bits, rightop, exec );
+}
+template<typename _Bits, typename _Source> _Bits &xorWith( _Bits &bits, const _Source &rightop ) {
+    return xorWith( bits, rightop, defaultPool() );
+}
+template<typename _Bits, typename _Source, typename _Exec>
+_Bits &andNot( _Bits &bits, const _Source &rightop, _Exec &exec ) {
+    return detail::logic<simd::LogicOp::AndNot>( bits, rightop, exec );
+}
+template<typename _Bits, typename _Source> _Bits &andNot( _Bits &bits, const _Source &rightop ) {
+    return andNot( bits, rightop, defaultPool() );
+}
+
+// lxutil::commonPrefixLength, the chunks searched at once; the first
+// difference is still the first: chunks past one that differs stop
+template<typename _A, typename _B, typename _Exec>
+unsigned int commonPrefixLength( const _A &a, const _B &b, _Exec &exec ) {
+    using BlockType = typename _A::BlockType;
+    constexpr unsigned int bitsInBlock = _A::bitsPerBlock();
+    unsigned int shorter = ( a.sizeInBits() < b.sizeInBits() ) ? a.sizeInBits() : b.sizeInBits();
+    unsigned int nBlocks = (shorter + bitsInBlock - 1) / bitsInBlock;
+    if( (nBlocks < 2) || (size_t(nBlocks) * sizeof(BlockType) < threshold()) ) {
+        return lxutil::commonPrefixLength( a, b );
+    }
+    unsigned int full = nBlocks - 1;
+    const BlockType *x = a.data();
+    const BlockType *y = b.data();
+    detail::chunks parts( x, full, exec.concurrency() );
+    std::atomic<unsigned int> first( full ); // lowest different block found
+    exec.run( parts.count, [&]( unsigned int c ) {
+        unsigned int begin = parts.begin( c );
+        unsigned int end = parts.end( c );
+        if( (end <= begin) || (begin >= first.load( std::memory_order_relaxed )) ) {
+            return; // nothing here, or a difference before it already
+        }
+        unsigned int at = begin + blockbits::firstDifferent( x + begin, y + begin, end - begin );
+        if( at < end ) {
+            unsigned int seen = first.load( std::memory_order_relaxed );
+            while( (at < seen) && !first.compare_exchange_weak( seen, at ) ) {
+            }
+        }
+    } );
+    // the block found, or the last one lined up as lxutil's does
+    unsigned int i = first.load();
+    BlockType diff = BlockType( a.blockAt( i ) << (bitsInBlock - a.bitsInBlockAt( i )) ) ^
+                     BlockType( b.blockAt( i ) << (bitsInBlock - b.bitsInBlockAt( i )) );
+    if( diff == 0 ) {
+        return shorter;
+    }
+    unsigned int pos = i * bitsInBlock + blockbits::countl_zero( diff );
+    return ( pos < shorter ) ? pos : shorter;
+}
+template<typename _A, typename _B> unsigned int commonPrefixLength( const _A &a, const _B &b ) {
+    return commonPrefixLength( a, b, defaultPool() );
+}
+
+// a <=> b, in operator< order
+template<typename _A, typename _B, typename _Exec>
+std::strong_ordering compare( const _A &a, const _B &b, _Exec &exec ) {
+    unsigned int shorter = ( a.sizeInBits() < b.sizeInBits() ) ? a.sizeInBits() : b.sizeInBits();
+    unsigned int common = commonPrefixLength( a, b, exec );
+    if( common < shorter ) {
+        return a.bitAt( common ) ? std::strong_ordering::greater : std::strong_ordering::less;
+    }
+    return a.sizeInBits() <=> b.sizeInBits();
+}
+template<typename _A, typename _B> std::strong_ordering compare( const _A &a, const _B &b ) {
+    return compare( a, b, defaultPool() );
+}
+
+template<typename _Bits, typename _Exec> unsigned int countOnes( const _Bits &bits, _Exec &exec ) {
+    if( !detail::worthIt( bits ) ) {
+        return bits.countOnes();
+    }
+    const auto *blocks = bits.data();
+    detail::chunks parts( blocks, bits.sizeInBlocks(), exec.concurrency() );
+    std::atomic<unsigned int> count( 0 );
+    exec.run( parts.count, [&]( unsigned int c ) {
+        unsigned int mine = 0;
+        for( unsigned int i = parts.begin( c ); i < parts.end( c ); ++i ) {
+            mine += blockbits::popcount( blocks[i] ); // unused bits are zero
+        }
+        count += mine;
+    } );
+    return count.load();
+}
+template<typename _Bits> unsigned int countOnes( const _Bits &bits ) {
+    return countOnes( bits, defaultPool() );
+}
+
+// lxutil::serialize into a buffer, the same bytes
+template<typename _Bits, typename _Exec>
+size_t serialize( const _Bits &bits, std::span<unsigned char> out, _Exec &exec ) {
+    using BlockType = typename _Bits::BlockType;
+    unsigned int nBlocks = bits.sizeInBlocks();
+    if( !detail::worthIt( bits ) || (out.size() < serializedSize( bits )) ) {
+        return lxutil::serialize( bits, out );
+    }
+    unsigned char *to = out.data();
+    serialdetail::storeLE( to, bits.sizeInBits(), serialdetail::lengthBytes );
+    to += serialdetail::lengthBytes;
+    const BlockType *blocks = bits.data();
+    // the output is what is written: chunks line up on it
+    detail::chunks parts( reinterpret_cast<const BlockType *>( to ), nBlocks - 1, exec.concurrency() );
+    exec.run( parts.count, [&]( unsigned int c ) {
+        unsigned int b = parts.begin( c );
+        serialdetail::storeBlocks( to + size_t(b) * sizeof(BlockType), blocks + b, parts.end( c ) - b );
+    } );
+    serialdetail::storeTail( to + size_t(nBlocks - 1) * sizeof(BlockType),
+                             bits.blockAt( nBlocks - 1 ), bits.bitsInBlockAt( nBlocks - 1 ) );
+    return serializedSize( bits );
+}
+template<typename _Bits> size_t serialize( const _Bits &bits, std::span<unsigned char> out ) {
+    return serialize( bits, out, defaultPool() );
+}
+
+// lxutil::deserialize from a buffer
+template<typename _Bits, typename _Exec>
+size_t deserialize( _Bits &bits, std::span<const unsigned char> in, _Exec &exec ) {
+    using BlockType = typename _Bits::BlockType;
+    constexpr unsigned int bitsInBlock = _Bits::bitsPerBlock();
+    if( in.size() < serialdetail::lengthBytes ) {
+        return 0;
+    }
+    uint64_t nBits = serialdetail::loadLE( in.data(), serialdetail::lengthBytes );
+    size_t size = serialdetail::lengthBytes + size_t( (nBits + 7) / 8 );
+    if( (in.size() < size) || (nBits <= bitsInBlock) || (size < threshold()) ) {
+        return lxutil::deserialize( bits, in );
+    }
+    const unsigned char *from = in.data() + serialdetail::lengthBytes;
+    bool loaded = bits.loadBlocks( (unsigned int)nBits, [&]( BlockType *blocks, unsigned int nBlocks ) {
+        detail::chunks parts( blocks, nBlocks - 1, exec.concurrency() );
+        exec.run( parts.count, [&]( unsigned int c ) {
+            unsigned int b = parts.begin( c );
+            serialdetail::loadBlocks( blocks + b, from + size_t(b) * sizeof(BlockType), parts.end( c ) - b );
+        } );
+        blocks[nBlocks - 1] = serialdetail::loadTail<BlockType>( from + size_t(nBlocks - 1) * sizeof(BlockType),
+                                    (unsigned int)nBits - (nBlocks - 1) * bitsInBlock );
+    } );
+    return loaded ? size : 0;
+}
+template<typename _Bits> size_t deserialize( _Bits &bits, std::span<const unsigned char> in ) {
+    return deserialize( bits, in, defaultPool() );
+}
+
+} // namespace parallel
+} // namespace lxutil
@@ -0,0 +1,322 @@
+#pragma once
+
+// FILE: bitstring_serial.h
+// PURPOSE: binary serialization of bitstrings, one at a time or many
+//          packed into a single buffer.
+//
+// FORMAT (one bitstring):
+//          - bit length, 4 bytes, little endian
+//          - the bits as a byte stream, ceil(length / 8) bytes: bit 0 is
+//            the top bit of the first byte, the last byte is zero padded
+//            at the bottom
+//          The byte stream is the same whatever the block width, so a
+//          string written with 32 bit blocks loads into 8 or 64 bit ones.
+//          Blocks are MSB first, so a full block is just its big endian
+//          bytes: a memcpy plus a byte swap on little endian hosts.
+//
+// FORMAT (pack of many):
+//          - "LXBP", then version (4 bytes) and count (8 bytes), little endian
+//          - count + 1 offsets, 8 bytes little endian each, from the start
+//            of the pack: record i is [offset i, offset i + 1)
+//          - the records, each one bitstring as above
+//          A pack is read in one go (or mmap'ed) and used in place:
+//          packreader gives a bitstring_view of any record without copying.
+
+#include <bitstring_core.h>
+#include <bitstring_view.h>
+#include <span>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <bit> // std::endian
+#include <string.h> // memcpy
+#include <stdint.h>
+
+namespace lxutil {
+
+namespace serialdetail {
+
+template<typename _T> inline _T byteswap( _T v ) {
+    if constexpr( sizeof(_T) == 1 ) {
+        return v;
+    } else if constexpr( sizeof(_T) == 2 ) {
+        return _T( __builtin_bswap16( uint16_t(v) ) );
+    } else if constexpr( sizeof(_T) == 4 ) {
+        return _T( __builtin_bswap32( uint32_t(v) ) );
+    } else if constexpr( sizeof(_T) == 8 ) {
+        return _T( __builtin_bswap64( uint64_t(v) ) );
+    } else {
+        // wider: 64 bits at a time, halves swapped
+        _T out = 0;
+        for( unsigned int i = 0; i < sizeof(_T); i += 8 ) {
+            out = (out << 64) | _T( __builtin_bswap64( uint64_t(v >> (i * 8)) ) );
+        }
+        return out;
+    }
+}
+
+// host block <-> big endian bytes
+template<typename _T> inline void storeBig( unsigned char *to, _T v ) {
+    if constexpr( std::endian::native == std::endian::little ) {
+        v = byteswap( v );
+    }
+    memcpy( to, &v, sizeof(_T) );
+}
+template<typename _T> inline _T loadBig( const unsigned char *from ) {
+    _T v;
+    memcpy( &v, from, sizeof(_T) );
+    if constexpr( std::endian::native == std::endian::little ) {
+        v = byteswap( v );
+    }
+    return v;
+}
+
+inline void storeLE( unsigned char *to, uint64_t v, unsigned int nBytes ) {
+    for( unsigned int i = 0; i < nBytes; ++i ) {
+        to[i] = (unsigned char)( v >> (i * 8) );
+    }
+}
+inline uint64_t loadLE( const unsigned char *from, unsigned int nBytes ) {
+    uint64_t v = 0;
+    for( unsigned int i = 0; i < nBytes; ++i ) {
+        v |= uint64_t( from[i] ) << (i * 8);
+    }
+    return v;
+}
+
+// n full blocks out as big endian bytes, and back
+template<typename _T> inline void storeBlocks( unsigned char *to, const _T *blocks, size_t n ) {
+    for( size_t i = 0; i < n; ++i ) {
+        storeBig( to + i * sizeof(_T), blocks[i] );
+    }
+}
+template<typename _T> inline void loadBlocks( _T *blocks, const unsigned char *from, size_t n ) {
+    for( size_t i = 0; i < n; ++i ) {
+        blocks[i] = loadBig<_T>( from + i * sizeof(_T) );
+    }
+}
+
+// the last block, populated bits of it right aligned, as the bytes it
+// needs: lined up at the top, padding at the bottom
+template<typename _T> inline void storeTail( unsigned char *to, _T last, unsigned int populated ) {
+    constexpr unsigned int bitsInBlock = sizeof(_T) * 8;
+    last = _T( last << (bitsInBlock - populated) );
+    unsigned int lastBytes = (populated + 7) / 8;
+    for( unsigned int b = 0; b < lastBytes; ++b ) {
+        to[b] = (unsigned char)( last >> (bitsInBlock - 8 * (b + 1)) );
+    }
+}
+template<typename _T> inline _T loadTail( const unsigned char *from, unsigned int populated ) {
+    unsigned int lastBytes = (populated + 7) / 8;
+    _T last = 0;
+    for( unsigned int b = 0; b < lastBytes; ++b ) {
+        last = _T( (last << 8) | from[b] );
+    }
+    return _T( last >> (lastBytes * 8 - populated) ); // right aligned
+}
+
+constexpr unsigned int lengthBytes = 4;
+constexpr unsigned char packMagic[4] = { 'L', 'X', 'B', 'P' };
+constexpr uint32_t packVersion = 1;
+constexpr unsigned int packHeaderBytes = 16;
+
+} // namespace serialdetail
+
+
+// bytes serialize() writes for bits
+template<typename _Bits> size_t serializedSize( const _Bits &bits ) {
+    return serialdetail::lengthBytes + (size_t(bits.sizeInBits()) + 7) / 8;
+}
+
+// writes bits to out, which must have serializedSize(bits) bytes.
+// Returns the bytes written, 0 if out is too small.
+template<typename _Bits> size_t serialize( const _Bits &bits, std::span<unsigned char> out ) {
+    using BlockType = typename _Bits::BlockType;
+    size_t size = serializedSize( bits );
+    if( out.size() < size ) {
+        return 0;
+    }
+    unsigned char *to = out.data();
+    serialdetail::storeLE( to, bits.sizeInBits(), serialdetail::lengthBytes );
+    to += serialdetail::lengthBytes;
+
+    unsigned int nBlocks = bits.sizeInBlocks();
+    if( nBlocks == 0 ) {
+        return size;
+    }
+    serialdetail::storeBlocks( to, bits.data(), nBlocks - 1 );
+    serialdetail::storeTail( to + (nBlocks - 1) * sizeof(BlockType),
+                             bits.blockAt( nBlocks - 1 ), bits.bitsInBlockAt( nBlocks - 1 ) );
+    return size;
+}
+
+// appends bits to out
+template<typename _Bits> void serialize( const _Bits &bits, std::vector<unsigned char> &out ) {
+    size_t at = out.size();
+    out.resize( at + serializedSize( bits ) );
+    serialize( bits, std::span<unsigned char>( out.data() + at, out.size() - at ) );
+}
+
+template<typename _Bits> bool serialize( const _Bits &bits, std::ostream &out ) {
+    std::vector<unsigned char> buffer;
+    serialize( bits, buffer );
+    out.write( reinterpret_cast<const char *>( buffer.data() ), buffer.size() );
+    return bool( out );
+}
+
+// replaces the contents of bits with what in starts with.
+// Returns the bytes used, 0 if in is short or the string doesn't fit.
+template<typename _Bits> size_t deserialize( _Bits &bits, std::span<const unsigned char> in ) {
+    using BlockType = typename _Bits::BlockType;
+    constexpr unsigned int bitsInBlock = _Bits::bitsPerBlock();
+    if( in.size() < serialdetail::lengthBytes ) {
+        return 0;
+    }
+    uint64_t nBits = serialdetail::loadLE( in.data(), serialdetail::lengthBytes );
+    size_t size = serialdetail::lengthBytes + size_t( (nBits + 7) / 8 );
+    if( in.size() < size ) {
+        return 0;
+    }
+    const unsigned char *from = in.data() + serialdetail::lengthBytes;
+    bool loaded = bits.loadBlocks( (unsigned int)nBits, [&]( BlockType *blocks, unsigned int nBlocks ) {
+        if( nBlocks == 0 ) {
+            return;
+        }
+        serialdetail::loadBlocks( blocks, from, nBlocks - 1 );
+        blocks[nBlocks - 1] = serialdetail::loadTail<BlockType>( from + (nBlocks - 1) * sizeof(BlockType),
+                                    (unsigned int)nBits - (nBlocks - 1) * bitsInBlock );
+    } );
+    return loaded ? size : 0;
+}
+
+template<typename _Bits> bool deserialize( _Bits &bits, std::istream &in ) {
+    unsigned char length[serialdetail::lengthBytes];
+    if( !in.read( reinterpret_cast<char *>( length ), sizeof(length) ) ) {
+        return false;
+    }
+    uint64_t nBits = serialdetail::loadLE( length, serialdetail::lengthBytes );
+    std::vector<unsigned char> buffer( serialdetail::lengthBytes + size_t( (nBits + 7) / 8 ) );
+    memcpy( buffer.data(), length, sizeof(length) );
+    if( !in.read( reinterpret_cast<char *>( buffer.data() + sizeof(length) ),
+                  buffer.size() - sizeof(length) ) ) {
+        return false;
+    }
+    return deserialize( bits, std::span<const unsigned char>( buffer ) ) != 0;
+}
+
+
+// builds a pack in memory
+class packwriter {
+public:
+    template<typename _Bits> void add( const _Bits &bits ) {
+        offsets.push_back( records.size() );
+        serialize( bits, records );
+    }
+
+    size_t count() const {
+        return offsets.size();
+    }
+
+    // the whole pack, appended to out
+    void writeTo( std::vector<unsigned char> &out ) const {
+        size_t at = out.size();
+        size_t indexBytes = (offsets.size() + 1) * 8;
+        size_t recordsAt = serialdetail::packHeaderBytes + indexBytes;
+        out.resize( at + recordsAt + records.size() );
+        unsigned char *to = out.data() + at;
+        memcpy( to, serialdetail::packMagic, 4 );
+        serialdetail::storeLE( to + 4, serialdetail::packVersion, 4 );
+        serialdetail::storeLE( to + 8, offsets.size(), 8 );
+        to += serialdetail::packHeaderBytes;
+        for( size_t offset: offsets ) {
+            serialdetail::storeLE( to, recordsAt + offset, 8 );
+            to += 8;
+        }
+        serialdetail::storeLE( to, recordsAt + records.size(), 8 );
+        to += 8;
+        if( !records.empty() ) {
+            memcpy( to, records.data(), records.size() );
+        }
+    }
+
+    bool writeTo( std::ostream &out ) const {
+        std::vector<unsigned char> buffer;
+        writeTo( buffer );
+        out.write( reinterpret_cast<const char *>( buffer.data() ), buffer.size() );
+        return bool( out );
+    }
+
+private:
+    std::vector<size_t> offsets; // into records
+    std::vector<unsigned char> records;
+};
+
+
+// reads a pack in place; the buffer has to outlive the reader
+class packreader {
+public:
+    // false if pack isn't a (complete) pack
+    bool open( std::span<const unsigned char> pack ) {
+        buffer = pack;
+        nRecords = 0;
+        if( (pack.size() < serialdetail::packHeaderBytes) ||
+            (memcmp( pack.data(), serialdetail::packMagic, 4 ) != 0) ||
+            (serialdetail::loadLE( pack.data() + 4, 4 ) != serialdetail::packVersion) ) {
+            return false;
+        }
+        uint64_t count = serialdetail::loadLE( pack.data() + 8, 8 );
+        if( count >= (pack.size() - serialdetail::packHeaderBytes) / 8 ) {
+            return false; // no room for the index
+        }
+        // the index must be in order and stay inside the buffer, and
+        // every record inside its slot
+        uint64_t previous = serialdetail::packHeaderBytes + (count + 1) * 8;
+        for( uint64_t i = 0; i <= count; ++i ) {
+            uint64_t offset = offsetAt( i );
+            if( (offset < previous) || (offset > pack.size()) ) {
+                return false;
+            }
+            if( i > 0 ) {
+                uint64_t slot = offset - previous;
+                if( (slot < serialdetail::lengthBytes) ||
+                    (serialdetail::lengthBytes + (serialdetail::loadLE( pack.data() + previous,
+                                serialdetail::lengthBytes ) + 7) / 8 > slot) ) {
+                    return false;
+                }
+            }
+            previous = offset;
+        }
+        nRecords = count;
+        return true;
+    }
+
+    size_t count() const {
+        return nRecords;
+    }
+
+    // record i in place, no copy
+    bitstring_view<unsigned char> view( size_t i ) const {
+        const unsigned char *record = buffer.data() + offsetAt( i );
+        unsigned int nBits = (unsigned int)serialdetail::loadLE( record, serialdetail::lengthBytes );
+        return bitstring_view<unsigned char>::fromStream(
+                    std::span<const unsigned char>( record + serialdetail::lengthBytes, (nBits + 7) / 8 ),
+                    nBits );
+    }
+
+    // record i into bits; false if it is damaged or doesn't fit
+    template<typename _Bits> bool load( size_t i, _Bits &bits ) const {
+        uint64_t from = offsetAt( i );
+        uint64_t to = offsetAt( i + 1 );
+        return deserialize( bits, buffer.subspan( from, to - from ) ) != 0;
+    }
+
+private:
+    uint64_t offsetAt( uint64_t i ) const {
+        return serialdetail::loadLE( buffer.data() + serialdetail::packHeaderBytes + i * 8, 8 );
+    }
+
+    std::span<const unsigned char> buffer;
+    size_t nRecords = 0;
+};
+
+} // namespace lxutil
@@ -0,0 +1,260 @@
+#pragma once
+
+// FILE: bitstring_simd.h
+// PURPOSE: bulk logical kernels (and, or, xor, andnot, not) used by
+//          bitstring for the interior blocks of logical operations,
+//          and a first difference search for comparisons.
+//          The widest instruction set the CPU supports is picked at
+//          run time, with a plain scalar loop as fallback.
+//          Kernels work on bytes: logical operations don't care
+//          about the block type.
+
+#include <string.h> // memcpy
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && defined(__GNUC__)
+#define LXUTIL_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace lxutil {
+namespace simd {
+
+enum class LogicOp { And, Or, Xor, AndNot, Not };
+
+enum class Level { Scalar = 0, SSE2 = 1, AVX2 = 2, AVX512 = 3 };
+
+// what the CPU can do
+inline Level detectedLevel() {
+#ifdef LXUTIL_SIMD_X86
+    static const Level detected = []() {
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx512f") ) return Level::AVX512;
+        if( __builtin_cpu_supports("avx2") ) return Level::AVX2;
+        if( __builtin_cpu_supports("sse2") ) return Level::SSE2;
+        return Level::Scalar;
+    }();
+    return detected;
+#else
+    return Level::Scalar;
+#endif
+}
+
+inline Level &activeLevelRef() {
+    static Level active = detectedLevel();
+    return active;
+}
+
+// what the kernels will use
+inline Level activeLevel() {
+    return activeLevelRef();
+}
+
+// force a lower level (tests, benchmarks), capped at what the CPU can do
+inline void setLevel( Level l ) {
+    activeLevelRef() = ( l > detectedLevel() ) ? detectedLevel() : l;
+}
+
+
+namespace detail {
+
+template<LogicOp _Op, typename _T> inline _T apply( _T d, _T s ) {
+    if constexpr( _Op == LogicOp::And ) return d & s;
+    else if constexpr( _Op == LogicOp::Or ) return d | s;
+    else if constexpr( _Op == LogicOp::Xor ) return d ^ s;
+    else if constexpr( _Op == LogicOp::AndNot ) return d & ~s;
+    else return ~d;
+}
+
+template<LogicOp _Op> void scalarKernel( unsigned char *dst, const unsigned char *src, size_t n ) {
+    size_t i = 0;
+    for( ; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t) ) {
+        uint64_t d, s = 0;
+        memcpy( &d, dst + i, sizeof(d) );
+        if constexpr( _Op != LogicOp::Not ) {
+            memcpy( &s, src + i, sizeof(s) );
+        }
+        d = apply<_Op>( d, s );
+        memcpy( dst + i, &d, sizeof(d) );
+    }
+    for( ; i < n; ++i ) {
+        unsigned char s = ( _Op != LogicOp::Not ) ? src[i] : 0;
+        dst[i] = apply<_Op>( dst[i], s );
+    }
+}
+
+// first byte where a and b differ, n if none
+inline size_t scalarDifference( const unsigned char *a, const unsigned char *b, size_t n ) {
+    size_t i = 0;
+    for( ; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t) ) {
+        uint64_t x, y;
+        memcpy( &x, a + i, sizeof(x) );
+        memcpy( &y, b + i, sizeof(y) );
+        if( x != y ) {
+            break; // the byte is found below
+        }
+    }
+    for( ; i < n; ++i ) {
+        if( a[i] != b[i] ) {
+            return i;
+        }
+    }
+    return n;
+}
+
+#ifdef LXUTIL_SIMD_X86
+
+template<LogicOp _Op> __attribute__((target("sse2")))
+void sse2Kernel( unsigned char *dst, const unsigned char *src, size_t n ) {
+    size_t i = 0;
+    const __m128i ones = _mm_set1_epi32( -1 );
+    for( ; i + 16 <= n; i += 16 ) {
+        __m128i d = _mm_loadu_si128( reinterpret_cast<const __m128i *>(dst + i) );
+        __m128i s = ones;
+        if constexpr( _Op != LogicOp::Not ) {
+            s = _mm_loadu_si128( reinterpret_cast<const __m128i *>(src + i) );
+        }
+        if constexpr( _Op == LogicOp::And ) d = _mm_and_si128( d, s );
+        if constexpr( _Op == LogicOp::Or ) d = _mm_or_si128( d, s );
+        if constexpr( _Op == LogicOp::Xor ) d = _mm_xor_si128( d, s );
+        if constexpr( _Op == LogicOp::AndNot ) d = _mm_andnot_si128( s, d );
+        if constexpr( _Op == LogicOp::Not ) d = _mm_xor_si128( d, ones );
+        _mm_storeu_si128( reinterpret_cast<__m128i *>(dst + i), d );
+    }
+    scalarKernel<_Op>( dst + i, src ? src + i : src, n - i );
+}
+
+template<LogicOp _Op> __attribute__((target("avx2")))
+void avx2Kernel( unsigned char *dst, const unsigned char *src, size_t n ) {
+    size_t i = 0;
+    const __m256i ones = _mm256_set1_epi32( -1 );
+    for( ; i + 32 <= n; i += 32 ) {
+        __m256i d = _mm256_loadu_si256( reinterpret_cast<const __m256i *>(dst + i) );
+        __m256i s = ones;
+        if constexpr( _Op != LogicOp::Not ) {
+            s = _mm256_loadu_si256( reinterpret_cast<const __m256i *>(src + i) );
+        }
+        if constexpr( _Op == LogicOp::And ) d = _mm256_and_si256( d, s );
+        if constexpr( _Op == LogicOp::Or ) d = _mm256_or_si256( d, s );
+        if constexpr( _Op == LogicOp::Xor ) d = _mm256_xor_si256( d, s );
+        if constexpr( _Op == LogicOp::AndNot ) d = _mm256_andnot_si256( s, d );
+        if constexpr( _Op == LogicOp::Not ) d = _mm256_xor_si256( d, ones );
+        _mm256_storeu_si256( reinterpret_cast<__m256i *>(dst + i), d );
+    }
+    sse2Kernel<_Op>( dst + i, src ? src + i : src, n - i );
+}
+
+template<LogicOp _Op> __attribute__((target("avx512f")))
+void avx512Kernel( unsigned char *dst, const unsigned char *src, size_t n ) {
+    size_t i = 0;
+    const __m512i ones = _mm512_set1_epi32( -1 );
+    for( ; i + 64 <= n; i += 64 ) {
+        __m512i d = _mm512_loadu_si512( dst + i );
+        __m512i s = ones;
+        if constexpr( _Op != LogicOp::Not ) {
+            s = _mm512_loadu_si512( src + i );
+        }
+        if constexpr( _Op == LogicOp::And ) d = _mm512_and_si512( d, s );
+        if constexpr( _Op == LogicOp::Or ) d = _mm512_or_si512( d, s );
+        if constexpr( _Op == LogicOp::Xor ) d = _mm512_xor_si512( d, s );
+        if constexpr( _Op == LogicOp::AndNot ) d = _mm512_and_si512( d, _mm512_xor_si512( s, ones ) );
+        if constexpr( _Op == LogicOp::Not ) d = _mm512_xor_si512( d, ones );
+        _mm512_storeu_si512( dst + i, d );
+    }
+    avx2Kernel<_Op>( dst + i, src ? src + i : src, n - i );
+}
+
+
+__attribute__((target("sse2")))
+inline size_t sse2Difference( const unsigned char *a, const unsigned char *b, size_t n ) {
+    size_t i = 0;
+    for( ; i + 16 <= n; i += 16 ) {
+        __m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i *>(a + i) );
+        __m128i y = _mm_loadu_si128( reinterpret_cast<const __m128i *>(b + i) );
+        unsigned int same = (unsigned int)_mm_movemask_epi8( _mm_cmpeq_epi8( x, y ) );
+        if( same != 0xFFFF ) {
+            return i + __builtin_ctz( ~same );
+        }
+    }
+    return i + scalarDifference( a + i, b + i, n - i );
+}
+
+__attribute__((target("avx2")))
+inline size_t avx2Difference( const unsigned char *a, const unsigned char *b, size_t n ) {
+    size_t i = 0;
+    for( ; i + 32 <= n; i += 32 ) {
+        __m256i x = _mm256_loadu_si256( reinterpret_cast<const __m256i *>(a + i) );
+        __m256i y = _mm256_loadu_si256( reinterpret_cast<const __m256i *>(b + i) );
+        unsigned int same = (unsigned int)_mm256_movemask_epi8( _mm256_cmpeq_epi8( x, y ) );
+        if( same != 0xFFFFFFFFu ) {
+            return i + __builtin_ctz( ~same );
+        }
+    }
+    return i + sse2Difference( a + i, b + i, n - i );
+}
+
+// avx512f compares 64 bit lanes; the byte within the lane is found after
+__attribute__((target("avx512f")))
+inline size_t avx512Difference( const unsigned char *a, const unsigned char *b, size_t n ) {
+    size_t i = 0;
+    for( ; i + 64 <= n; i += 64 ) {
+        __m512i x = _mm512_loadu_si512( a + i );
+        __m512i y = _mm512_loadu_si512( b + i );
+        __mmask8 differ = _mm512_cmpneq_epi64_mask( x, y );
+        if( differ != 0 ) {
+            size_t lane = i + 8 * __builtin_ctz( differ );
+            return lane + scalarDifference( a + lane, b + lane, 8 );
+        }
+    }
+    return i + avx2Difference( a + i, b + i, n - i );
+}
+
+#endif // LXUTIL_SIMD_X86
+
+} // namespace detail
+
+
+// dst[i] = dst[i] OP src[i] for nBytes bytes (src ignored for Not)
+template<LogicOp _Op> void logic( void *dst, const void *src, size_t nBytes ) {
+    unsigned char *d = static_cast<unsigned char *>(dst);
+    const unsigned char *s = static_cast<const unsigned char *>(src);
+#ifdef LXUTIL_SIMD_X86
+    switch( activeLevel() ) {
+    case Level::AVX512:
+        detail::avx512Kernel<_Op>( d, s, nBytes );
+        return;
+    case Level::AVX2:
+        detail::avx2Kernel<_Op>( d, s, nBytes );
+        return;
+    case Level::SSE2:
+        detail::sse2Kernel<_Op>( d, s, nBytes );
+        return;
+    default:
+        break;
+    }
+#endif
+    detail::scalarKernel<_Op>( d, s, nBytes );
+}
+
+// index of the first byte where a and b differ, nBytes if they don't
+inline size_t firstDifference( const void *a, const void *b, size_t nBytes ) {
+    const unsigned char *x = static_cast<const unsigned char *>(a);
+    const unsigned char *y = static_cast<const unsigned char *>(b);
+#ifdef LXUTIL_SIMD_X86
+    switch( activeLevel() ) {
+    case Level::AVX512:
+        return detail::avx512Difference( x, y, nBytes );
+    case Level::AVX2:
+        return detail::avx2Difference( x, y, nBytes );
+    case Level::SSE2:
+        return detail::sse2Difference( x, y, nBytes );
+    default:
+        break;
+    }
+#endif
+    return detail::scalarDifference( x, y, nBytes );
+}
+
+} // namespace simd
+} // namespace lxutil
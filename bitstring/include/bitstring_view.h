@@ -0,0 +1,167 @@
+#pragma once
+
+// FILE: bitstring_view.h
+// PURPOSE: read-only bitstring over memory it does not own (a network
+//          or file buffer, or a bitstring), so bit-packed payloads can
+//          be read, compared and combined without copying them first.
+//
+// LAYOUT: the canonical layout is the one bitstring uses itself:
+//          - bit 0 is the most significant bit of block 0, and bits
+//            follow from the most significant down in each block
+//          - every block but the last is full
+//          - the last block holds the remaining bits right aligned,
+//            the bits above them zero
+//          Blocks are native integers, so for blocks wider than a byte
+//          the byte order in memory is the host's.
+//          A packed stream (the last block left aligned, padding at the
+//          bottom, as with a byte buffer of n bits) is taken as well, see
+//          fromStream(); only the last block is read differently.
+//
+// The memory has to outlive the view and is read on every access.
+
+#include <bitstring_core.h>
+#include <span>
+#include <stdint.h>
+
+namespace lxutil {
+
+template<typename _BlockType> class bitstring_view {
+public:
+    using BlockType = _BlockType;
+    using ValueType = typename std::conditional<(sizeof(BlockType) < sizeof(uint64_t)),
+                                                uint64_t, BlockType>::type;
+
+    bitstring_view() = default;
+
+    // nBits over blocks in the canonical layout, cut to what the blocks hold
+    bitstring_view( std::span<const BlockType> blocks, unsigned int nBits ):
+            blocks(blocks.data()), nBits(clampBits( blocks, nBits )) {
+    }
+
+    // nBits over blocks packed as a stream: the last block left aligned
+    static bitstring_view fromStream( std::span<const BlockType> blocks, unsigned int nBits ) {
+        bitstring_view view( blocks, nBits );
+        if( (view.nBits % bitsInBlock) != 0 ) {
+            view.tailShift = bitsInBlock - (view.nBits % bitsInBlock);
+        }
+        return view;
+    }
+
+    // a view of a bitstring, valid until the bitstring changes
+    template<unsigned int _InitialBitCapacity, bool _AllowExpand, bool _AutoZeroInit, typename _StorageType,
+             typename _GrowthPolicy>
+    bitstring_view( const bitstring<_InitialBitCapacity, _AllowExpand, _AutoZeroInit, _StorageType, _GrowthPolicy> &from ):
+            blocks(from.data()), nBits(from.sizeInBits()) {
+        static_assert( std::is_same<typename _StorageType::value_type, BlockType>::value,
+                       "view and bitstring must use the same block type" );
+    }
+
+    unsigned int sizeInBits() const {
+        return nBits;
+    }
+    unsigned int sizeInBlocks() const {
+        return (nBits + bitsInBlock - 1) / bitsInBlock;
+    }
+    static constexpr unsigned int bitsPerBlock() {
+        return bitsInBlock;
+    }
+    unsigned int bitsInBlockAt( unsigned int block ) const {
+        return ( (block + 1) < sizeInBlocks() ) ? bitsInBlock :
+                    ( nBits - block * bitsInBlock );
+    }
+    // the blocks as given; the last one may be left aligned (fromStream)
+    const BlockType *data() const {
+        return blocks;
+    }
+    // one block in the canonical layout
+    BlockType blockAt( unsigned int block ) const {
+        if( (block + 1) < sizeInBlocks() ) {
+            return blocks[block];
+        }
+        return BlockType( blocks[block] >> tailShift );
+    }
+
+    // up to 64 bits (or a block, if wider) from startingBit on
+    ValueType read( unsigned int startingBit, unsigned int nRead ) const {
+        if( nRead > valueBits ) {
+            nRead = valueBits;
+        }
+        ValueType value = 0;
+        while( nRead > 0 ) {
+            unsigned int block = startingBit / bitsInBlock;
+            unsigned int populated = bitsInBlockAt( block );
+            unsigned int left = populated - (startingBit % bitsInBlock); // bits from here on
+            unsigned int n = ( nRead < left ) ? nRead : left;
+            BlockType part = BlockType( blockAt( block ) >> (left - n) ) & lowMask( n );
+            value = ( n < valueBits ) ? ValueType( (value << n) | part ) : ValueType( part );
+            startingBit += n;
+            nRead -= n;
+        }
+        return value;
+    }
+
+    bool bitAt( unsigned int pos ) const {
+        unsigned int block = pos / bitsInBlock;
+        return ( blockAt( block ) >> (bitsInBlockAt( block ) - 1 - (pos % bitsInBlock)) ) & 1;
+    }
+
+    unsigned int countOnes() const {
+        unsigned int count = 0;
+        unsigned int n = sizeInBlocks();
+        for( unsigned int i = 0; i < n; ++i ) {
+            count += blockbits::popcount( blockAt( i ) );
+        }
+        return count;
+    }
+
+    // the same lexical order as bitstring: bit by bit, and a prefix of
+    // another string sorts before it. -1, 0 or 1
+    int compare( const bitstring_view &comp ) const {
+        unsigned int shorter = ( nBits < comp.nBits ) ? nBits : comp.nBits;
+        unsigned int common = commonPrefixLength( *this, comp );
+        if( common < shorter ) {
+            return bitAt( common ) ? 1 : -1;
+        }
+        return ( nBits == comp.nBits ) ? 0 : ( (nBits < comp.nBits) ? -1 : 1 );
+    }
+
+    // with a bitstring on either side, it converts to a view
+    friend bool operator==( const bitstring_view &a, const bitstring_view &b ) {
+        return (a.nBits == b.nBits) && (a.compare( b ) == 0);
+    }
+    friend bool operator<( const bitstring_view &a, const bitstring_view &b ) {
+        return a.compare( b ) < 0;
+    }
+    friend bool operator>( const bitstring_view &a, const bitstring_view &b ) {
+        return a.compare( b ) > 0;
+    }
+    friend bool operator<=( const bitstring_view &a, const bitstring_view &b ) {
+        return a.compare( b ) <= 0;
+    }
+    friend bool operator>=( const bitstring_view &a, const bitstring_view &b ) {
+        return a.compare( b ) >= 0;
+    }
+    friend std::strong_ordering operator<=>( const bitstring_view &a, const bitstring_view &b ) {
+        return a.compare( b ) <=> 0;
+    }
+
+private:
+    static constexpr unsigned int bitsInBlock = (sizeof(BlockType) * 8);
+    static constexpr unsigned int valueBits = (sizeof(ValueType) * 8);
+
+    static constexpr BlockType lowMask( unsigned int n ) {
+        return ( n >= bitsInBlock ) ? BlockType(~BlockType(0)) :
+                    BlockType( (BlockType(1) << n) - 1 );
+    }
+
+    static unsigned int clampBits( std::span<const BlockType> blocks, unsigned int nBits ) {
+        uint64_t held = uint64_t( blocks.size() ) * bitsInBlock;
+        return ( nBits > held ) ? (unsigned int)held : nBits;
+    }
+
+    const BlockType *blocks = nullptr;
+    unsigned int nBits = 0;
+    unsigned int tailShift = 0; // padding under the last block's bits
+};
+
+} // namespace lxutil
@@ -0,0 +1,780 @@
+#pragma once
+
+// FILE: compressedbitmap.h
+// PURPOSE: compressed bitmap for bit sets that are very sparse or made
+//          of long runs, e.g. membership bitmaps over billions of ids,
+//          where a plain bitstring would be mostly zero blocks.
+//
+// LAYOUT: Roaring's. Positions are split into chunks of 65536 by their
+//          top 16 bits, and only chunks with ones in them are stored,
+//          each in whichever container is smallest for it:
+//          - array: the sorted low 16 bits of its ones (4096 at most)
+//          - bitmap: 1024 64 bit words, bit 0 at the top of word 0
+//          - run: sorted first, last pairs of the runs of ones
+//          &=, |=, ^=, andNot and countOnes work a chunk at a time on the
+//          containers: chunks missing on one side are skipped or copied,
+//          and two arrays (or two run lists) are merged without ever
+//          becoming bitmaps.
+//
+// The length and the logical operations follow bitstring: the result
+// keeps the length of the left side, and its bits the right side does
+// not reach are left alone.
+
+#include <bitstring_core.h> // blockbits
+#include <bitstring_simd.h> // simd::logic
+#include <algorithm> // std::lower_bound, std::upper_bound
+#include <vector>
+#include <stdint.h>
+
+namespace lxutil {
+
+namespace compresseddetail {
+
+constexpr unsigned int chunkBits = 65536;
+constexpr unsigned int chunkWords = chunkBits / 64;
+constexpr unsigned int arrayMax = 4096; // past this a bitmap is smaller
+
+enum class Kind : uint8_t { Array, Bitmap, Run };
+
+struct container {
+    Kind kind = Kind::Array;
+    unsigned int count = 0; // ones
+    std::vector<uint16_t> values; // array: the ones; run: first, last of each run
+    std::vector<uint64_t> words; // bitmap
+
+    unsigned int runs() const {
+        return (unsigned int)( values.size() / 2 );
+    }
+    size_t heapBytes() const {
+        return values.capacity() * sizeof(uint16_t) + words.capacity() * sizeof(uint64_t);
+    }
+};
+
+inline uint64_t wordBit( unsigned int low ) {
+    return uint64_t(1) << (63 - low % 64);
+}
+
+// index of the last run starting at or before low, runs() if none
+inline unsigned int runBefore( const container &c, unsigned int low ) {
+    unsigned int lo = 0;
+    unsigned int hi = c.runs();
+    while( lo < hi ) {
+        unsigned int mid = (lo + hi) / 2;
+        if( c.values[2 * mid] <= low ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return ( lo > 0 ) ? (lo - 1) : c.runs();
+}
+
+inline bool contains( const container &c, unsigned int low ) {
+    switch( c.kind ) {
+    case Kind::Array:
+        return std::binary_search( c.values.begin(), c.values.end(), uint16_t(low) );
+    case Kind::Bitmap:
+        return ( c.words[low / 64] & wordBit( low ) ) != 0;
+    default: {
+        unsigned int r = runBefore( c, low );
+        return ( r < c.runs() ) && ( low <= c.values[2 * r + 1] );
+    }
+    }
+}
+
+// sets first to last (inclusive) in words
+inline void setRange( uint64_t *words, unsigned int first, unsigned int last ) {
+    unsigned int w = first / 64;
+    unsigned int lastWord = last / 64;
+    uint64_t head = ~uint64_t(0) >> (first % 64); // first to the end of its word
+    uint64_t tail = ~uint64_t(0) << (63 - last % 64); // the start of its word to last
+    if( w == lastWord ) {
+        words[w] |= head & tail;
+        return;
+    }
+    words[w] |= head;
+    for( ++w; w < lastWord; ++w ) {
+        words[w] = ~uint64_t(0);
+    }
+    words[lastWord] |= tail;
+}
+
+// the container's ones as a bitmap, words overwritten
+inline void toWords( const container &c, uint64_t *words ) {
+    if( c.kind == Kind::Bitmap ) {
+        std::copy( c.words.begin(), c.words.end(), words );
+        return;
+    }
+    std::fill( words, words + chunkWords, uint64_t(0) );
+    if( c.kind == Kind::Array ) {
+        for( auto v: c.values ) {
+            words[v / 64] |= wordBit( v );
+        }
+    } else {
+        for( unsigned int r = 0; r < c.runs(); ++r ) {
+            setRange( words, c.values[2 * r], c.values[2 * r + 1] );
+        }
+    }
+}
+
+// first position at or after from holding one (zero if !one), chunkBits if none
+inline unsigned int nextBit( const uint64_t *words, unsigned int from, bool one ) {
+    for( unsigned int w = from / 64; w < chunkWords; ++w ) {
+        uint64_t bits = one ? words[w] : ~words[w];
+        if( w == from / 64 ) {
+            bits &= ~uint64_t(0) >> (from % 64);
+        }
+        if( bits != 0 ) {
+            return w * 64 + blockbits::countl_zero( bits );
+        }
+    }
+    return chunkBits;
+}
+
+inline unsigned int countRuns( const uint64_t *words ) {
+    unsigned int n = 0;
+    uint64_t carry = 0; // the last bit of the word before
+    for( unsigned int w = 0; w < chunkWords; ++w ) {
+        uint64_t starts = words[w] & ~( (words[w] >> 1) | (carry << 63) );
+        if( starts != 0 ) { // mostly none when sparse, and popcount may be slow
+            n += blockbits::popcount( starts );
+        }
+        carry = words[w] & 1;
+    }
+    return n;
+}
+
+inline unsigned int countRuns( const std::vector<uint16_t> &sorted ) {
+    unsigned int n = 0;
+    for( size_t i = 0; i < sorted.size(); ++i ) {
+        n += ( (i == 0) || (sorted[i] != sorted[i - 1] + 1) );
+    }
+    return n;
+}
+
+// which container is smallest: runs only when they beat both others
+inline Kind bestKind( unsigned int count, unsigned int runs ) {
+    size_t runBytes = size_t(runs) * 2 * sizeof(uint16_t);
+    size_t arrayBytes = size_t(count) * sizeof(uint16_t);
+    size_t bitmapBytes = chunkBits / 8;
+    if( (runBytes < bitmapBytes) && ((count > arrayMax) || (runBytes < arrayBytes)) ) {
+        return Kind::Run;
+    }
+    return ( count <= arrayMax ) ? Kind::Array : Kind::Bitmap;
+}
+
+// the smallest container holding the ones in words
+inline container pack( const uint64_t *words ) {
+    container c;
+    for( unsigned int w = 0; w < chunkWords; ++w ) {
+        if( words[w] != 0 ) {
+            c.count += blockbits::popcount( words[w] );
+        }
+    }
+    if( c.count == 0 ) {
+        return c;
+    }
+    c.kind = bestKind( c.count, countRuns( words ) );
+    switch( c.kind ) {
+    case Kind::Array:
+        c.values.reserve( c.count );
+        for( unsigned int w = 0; w < chunkWords; ++w ) {
+            for( uint64_t bits = words[w]; bits != 0; ) {
+                unsigned int top = blockbits::countl_zero( bits );
+                c.values.push_back( uint16_t( w * 64 + top ) );
+                bits &= ~( uint64_t(1) << (63 - top) );
+            }
+        }
+        break;
+    case Kind::Bitmap:
+        c.words.assign( words, words + chunkWords );
+        break;
+    case Kind::Run:
+        for( unsigned int p = nextBit( words, 0, true ); p < chunkBits; ) {
+            unsigned int end = nextBit( words, p, false );
+            c.values.push_back( uint16_t( p ) );
+            c.values.push_back( uint16_t( end - 1 ) );
+            p = ( end < chunkBits ) ? nextBit( words, end, true ) : chunkBits;
+        }
+        break;
+    }
+    return c;
+}
+
+// repacks c if another kind of container is now smaller
+inline void settle( container &c ) {
+    unsigned int runs = ( c.kind == Kind::Run ) ? c.runs() :
+                        ( c.kind == Kind::Array ) ? countRuns( c.values ) : countRuns( c.words.data() );
+    if( bestKind( c.count, runs ) != c.kind ) {
+        uint64_t words[chunkWords];
+        toWords( c, words );
+        c = pack( words );
+    }
+}
+
+// first to last as a run container
+inline container range( unsigned int first, unsigned int last ) {
+    container c;
+    c.kind = Kind::Run;
+    c.count = last - first + 1;
+    c.values = { uint16_t( first ), uint16_t( last ) };
+    return c;
+}
+
+template<simd::LogicOp _Op> constexpr bool applyBit( bool a, bool b ) {
+    static_assert( _Op != simd::LogicOp::Not, "binary operations only" );
+    switch( _Op ) {
+    case simd::LogicOp::And: return a && b;
+    case simd::LogicOp::Or: return a || b;
+    case simd::LogicOp::Xor: return a != b;
+    default: return a && !b;
+    }
+}
+
+// x _Op y, in the smallest container
+template<simd::LogicOp _Op> container combine( const container &x, const container &y ) {
+    constexpr bool keepX = applyBit<_Op>( true, false ); // a one only x has stays
+    constexpr bool keepY = applyBit<_Op>( false, true );
+    constexpr bool keepBoth = applyBit<_Op>( true, true );
+    container out;
+    if( (x.kind == Kind::Array) && (y.kind == Kind::Array) ) {
+        // merge the sorted values
+        const auto &a = x.values;
+        const auto &b = y.values;
+        size_t i = 0;
+        size_t j = 0;
+        while( (i < a.size()) && (j < b.size()) ) {
+            if( a[i] < b[j] ) {
+                if( keepX ) out.values.push_back( a[i] );
+                ++i;
+            } else if( b[j] < a[i] ) {
+                if( keepY ) out.values.push_back( b[j] );
+                ++j;
+            } else {
+                if( keepBoth ) out.values.push_back( a[i] );
+                ++i;
+                ++j;
+            }
+        }
+        if( keepX ) out.values.insert( out.values.end(), a.begin() + i, a.end() );
+        if( keepY ) out.values.insert( out.values.end(), b.begin() + j, b.end() );
+        out.count = (unsigned int)out.values.size();
+    } else if( (x.kind == Kind::Run) && (y.kind == Kind::Run) ) {
+        // sweep the run edges; an even index is a first, an odd one a last
+        auto edge = []( const container &c, unsigned int k ) {
+            return ( k % 2 == 0 ) ? unsigned(c.values[k]) : unsigned(c.values[k]) + 1;
+        };
+        unsigned int nx = (unsigned int)x.values.size();
+        unsigned int ny = (unsigned int)y.values.size();
+        unsigned int i = 0;
+        unsigned int j = 0;
+        bool on = false;
+        unsigned int first = 0;
+        out.kind = Kind::Run;
+        while( (i < nx) || (j < ny) ) {
+            unsigned int p = ( i < nx ) ? edge( x, i ) : (chunkBits + 1);
+            unsigned int q = ( j < ny ) ? edge( y, j ) : (chunkBits + 1);
+            unsigned int at = ( p < q ) ? p : q;
+            i += ( p == at );
+            j += ( q == at );
+            bool now = applyBit<_Op>( (i % 2) == 1, (j % 2) == 1 );
+            if( now && !on ) {
+                first = at;
+            } else if( on && !now ) {
+                out.values.push_back( uint16_t( first ) );
+                out.values.push_back( uint16_t( at - 1 ) );
+                out.count += at - first;
+            }
+            on = now;
+        }
+    } else if( (x.kind == Kind::Array) && !keepY ) {
+        // x's ones, less those y does (not) have
+        for( auto v: x.values ) {
+            if( contains( y, v ) == keepBoth ) {
+                out.values.push_back( v );
+            }
+        }
+        out.count = (unsigned int)out.values.size();
+    } else if( (y.kind == Kind::Array) && !keepX && !keepY ) {
+        for( auto v: y.values ) {
+            if( contains( x, v ) ) {
+                out.values.push_back( v );
+            }
+        }
+        out.count = (unsigned int)out.values.size();
+    } else if( (x.kind == Kind::Bitmap) && (y.kind == Kind::Bitmap) ) {
+        // stays a bitmap unless few ones are left
+        out.kind = Kind::Bitmap;
+        out.words = x.words;
+        simd::logic<_Op>( out.words.data(), y.words.data(), chunkWords * sizeof(uint64_t) );
+        for( auto w: out.words ) {
+            out.count += blockbits::popcount( w );
+        }
+        if( (out.count > 0) && (out.count <= arrayMax) ) {
+            settle( out );
+        }
+        return out;
+    } else {
+        uint64_t a[chunkWords];
+        uint64_t b[chunkWords];
+        toWords( x, a );
+        const uint64_t *from = y.words.data();
+        if( y.kind != Kind::Bitmap ) {
+            toWords( y, b );
+            from = b;
+        }
+        simd::logic<_Op>( a, from, sizeof(a) );
+        return pack( a );
+    }
+    if( out.count > 0 ) {
+        settle( out );
+    }
+    return out;
+}
+
+// sets low; false if it was set already
+inline bool add( container &c, unsigned int low ) {
+    switch( c.kind ) {
+    case Kind::Array: {
+        auto at = std::lower_bound( c.values.begin(), c.values.end(), uint16_t(low) );
+        if( (at != c.values.end()) && (*at == low) ) {
+            return false;
+        }
+        if( c.count < arrayMax ) {
+            c.values.insert( at, uint16_t(low) );
+            break;
+        }
+        uint64_t words[chunkWords];
+        toWords( c, words );
+        words[low / 64] |= wordBit( low );
+        c = pack( words ); // full: a bitmap, or runs
+        return true;
+    }
+    case Kind::Bitmap:
+        if( c.words[low / 64] & wordBit( low ) ) {
+            return false;
+        }
+        c.words[low / 64] |= wordBit( low );
+        break;
+    case Kind::Run: {
+        unsigned int r = runBefore( c, low );
+        bool before = r < c.runs();
+        if( before && (low <= c.values[2 * r + 1]) ) {
+            return false;
+        }
+        unsigned int next = before ? (r + 1) : 0;
+        bool joinsBefore = before && (unsigned(c.values[2 * r + 1]) + 1 == low);
+        bool joinsNext = (next < c.runs()) && (unsigned(c.values[2 * next]) == low + 1);
+        if( joinsBefore && joinsNext ) {
+            c.values[2 * r + 1] = c.values[2 * next + 1];
+            c.values.erase( c.values.begin() + 2 * next, c.values.begin() + 2 * next + 2 );
+        } else if( joinsBefore ) {
+            c.values[2 * r + 1] = uint16_t(low);
+        } else if( joinsNext ) {
+            c.values[2 * next] = uint16_t(low);
+        } else {
+            c.values.insert( c.values.begin() + 2 * next, { uint16_t(low), uint16_t(low) } );
+            ++c.count;
+            settle( c );
+            return true;
+        }
+        break;
+    }
+    }
+    ++c.count;
+    return true;
+}
+
+// clears low; false if it was clear already
+inline bool remove( container &c, unsigned int low ) {
+    switch( c.kind ) {
+    case Kind::Array: {
+        auto at = std::lower_bound( c.values.begin(), c.values.end(), uint16_t(low) );
+        if( (at == c.values.end()) || (*at != low) ) {
+            return false;
+        }
+        c.values.erase( at );
+        break;
+    }
+    case Kind::Bitmap:
+        if( !(c.words[low / 64] & wordBit( low )) ) {
+            return false;
+        }
+        c.words[low / 64] &= ~wordBit( low );
+        if( --c.count == arrayMax ) {
+            settle( c ); // an array may do now
+        }
+        return true;
+    case Kind::Run: {
+        unsigned int r = runBefore( c, low );
+        if( (r == c.runs()) || (low > c.values[2 * r + 1]) ) {
+            return false;
+        }
+        unsigned int first = c.values[2 * r];
+        unsigned int last = c.values[2 * r + 1];
+        if( first == last ) {
+            c.values.erase( c.values.begin() + 2 * r, c.values.begin() + 2 * r + 2 );
+        } else if( low == first ) {
+            ++c.values[2 * r];
+        } else if( low == last ) {
+            --c.values[2 * r + 1];
+        } else {
+            // split in two
+            c.values[2 * r + 1] = uint16_t(low - 1);
+            c.values.insert( c.values.begin() + 2 * r + 2, { uint16_t(low + 1), uint16_t(last) } );
+            --c.count;
+            settle( c );
+            return true;
+        }
+        break;
+    }
+    }
+    --c.count;
+    return true;
+}
+
+inline bool sameBits( const container &x, const container &y ) {
+    if( x.count != y.count ) {
+        return false;
+    }
+    if( x.kind == y.kind ) {
+        return ( x.kind == Kind::Bitmap ) ? (x.words == y.words) : (x.values == y.values);
+    }
+    uint64_t a[chunkWords];
+    uint64_t b[chunkWords];
+    toWords( x, a );
+    toWords( y, b );
+    return std::equal( a, a + chunkWords, b );
+}
+
+} // namespace compresseddetail
+
+
+class compressedbitmap {
+    using container = compresseddetail::container;
+    using Kind = compresseddetail::Kind;
+    static constexpr unsigned int chunkBits = compresseddetail::chunkBits;
+    static constexpr unsigned int chunkWords = compresseddetail::chunkWords;
+
+public:
+    compressedbitmap() {}
+
+    // nBits zeros
+    explicit compressedbitmap( unsigned int nBits ): nBits(nBits) {}
+
+    // the bits of a bitstring or bitstring_view
+    template<typename _Source> requires requires( const _Source &s ) { s.blockAt( 0 ); }
+    explicit compressedbitmap( const _Source &bits ) {
+        assign( bits );
+    }
+
+    // replaces the contents with the bits of a bitstring or bitstring_view.
+    // Zero blocks are skipped; the rest go in a chunk at a time
+    template<typename _Source> void assign( const _Source &bits ) {
+        using BlockType = typename _Source::BlockType;
+        constexpr unsigned int bitsInBlock = _Source::bitsPerBlock();
+        chunks.clear();
+        nBits = bits.sizeInBits();
+        uint64_t words[chunkWords];
+        bool open = false; // words hold chunk key
+        unsigned int key = 0;
+        unsigned int nBlocks = bits.sizeInBlocks();
+        const BlockType *blocks = bits.data();
+        for( unsigned int i = 0; i < nBlocks; ++i ) {
+            BlockType v = ( i + 1 < nBlocks ) ? blocks[i] : bits.blockAt( i );
+            if( v == 0 ) {
+                continue;
+            }
+            unsigned int pos = i * bitsInBlock;
+            if( open && ((pos / chunkBits) != key) ) {
+                chunks.push_back( { uint16_t(key), compresseddetail::pack( words ) } );
+                open = false;
+            }
+            if( !open ) {
+                std::fill( words, words + chunkWords, uint64_t(0) );
+                key = pos / chunkBits;
+                open = true;
+            }
+            v = BlockType( v << (bitsInBlock - bits.bitsInBlockAt( i )) ); // left aligned, the last one too
+            unsigned int off = pos % chunkBits;
+            if constexpr( bitsInBlock <= 64 ) {
+                words[off / 64] |= uint64_t(v) << (64 - bitsInBlock - off % 64);
+            } else {
+                words[off / 64] |= uint64_t( v >> 64 );
+                words[off / 64 + 1] |= uint64_t( v );
+            }
+        }
+        if( open ) {
+            chunks.push_back( { uint16_t(key), compresseddetail::pack( words ) } );
+        }
+    }
+
+    // the bits into a bitstring, replacing what it held; false if static
+    // storage is too small
+    template<typename _Bits> bool toBits( _Bits &bits ) const {
+        using BlockType = typename _Bits::BlockType;
+        constexpr unsigned int bitsInBlock = _Bits::bitsPerBlock();
+        return bits.loadBlocks( nBits, [&]( BlockType *blocks, unsigned int nBlocks ) {
+            std::fill( blocks, blocks + nBlocks, BlockType(0) );
+            uint64_t scratch[chunkWords];
+            // every block left aligned for now
+            for( auto &ch: chunks ) {
+                unsigned int base = unsigned(ch.key) * chunkBits;
+                if( ch.c.kind == Kind::Array ) {
+                    for( auto v: ch.c.values ) {
+                        unsigned int pos = base + v;
+                        blocks[pos / bitsInBlock] |= BlockType( BlockType(1) << (bitsInBlock - 1 - pos % bitsInBlock) );
+                    }
+                    continue;
+                }
+                const uint64_t *words = ch.c.words.data();
+                if( ch.c.kind != Kind::Bitmap ) {
+                    compresseddetail::toWords( ch.c, scratch );
+                    words = scratch;
+                }
+                for( unsigned int w = 0; w < chunkWords; ++w ) {
+                    if( words[w] == 0 ) {
+                        continue;
+                    }
+                    unsigned int pos = base + w * 64;
+                    if constexpr( bitsInBlock <= 64 ) {
+                        for( unsigned int t = 0; (t < 64 / bitsInBlock) && (pos / bitsInBlock + t < nBlocks); ++t ) {
+                            blocks[pos / bitsInBlock + t] = BlockType( words[w] >> (64 - bitsInBlock * (t + 1)) );
+                        }
+                    } else {
+                        blocks[pos / bitsInBlock] |= BlockType( words[w] ) << ( (pos % bitsInBlock) ? 0 : 64 );
+                    }
+                }
+            }
+            if( nBlocks > 0 ) {
+                unsigned int populated = nBits - (nBlocks - 1) * bitsInBlock;
+                blocks[nBlocks - 1] >>= (bitsInBlock - populated); // right aligned
+            }
+        } );
+    }
+
+    unsigned int sizeInBits() const {
+        return nBits;
+    }
+
+    // new bits are zero, bits past the new end are dropped
+    void resize( unsigned int newBits ) {
+        if( newBits < nBits ) {
+            unsigned int key = newBits / chunkBits;
+            unsigned int low = newBits % chunkBits;
+            auto end = std::lower_bound( chunks.begin(), chunks.end(), key + (low == 0 ? 0 : 1),
+                                         []( const chunk &ch, unsigned int k ) { return ch.key < k; } );
+            chunks.erase( end, chunks.end() );
+            if( (low > 0) && !chunks.empty() && (chunks.back().key == key) ) {
+                chunks.back().c = compresseddetail::combine<simd::LogicOp::And>(
+                                    chunks.back().c, compresseddetail::range( 0, low - 1 ) );
+                if( chunks.back().c.count == 0 ) {
+                    chunks.pop_back();
+                }
+            }
+        }
+        nBits = newBits;
+    }
+
+    // no bits at all
+    void clear() {
+        chunks.clear();
+        nBits = 0;
+    }
+
+    unsigned int countOnes() const {
+        unsigned int count = 0;
+        for( auto &ch: chunks ) {
+            count += ch.c.count;
+        }
+        return count;
+    }
+
+    bool bitAt( unsigned int pos ) const {
+        const chunk *ch = find( pos / chunkBits );
+        return ch && compresseddetail::contains( ch->c, pos % chunkBits );
+    }
+
+    // sets the bit, the length growing to reach it
+    void setBit( unsigned int pos ) {
+        unsigned int key = pos / chunkBits;
+        auto at = std::lower_bound( chunks.begin(), chunks.end(), key,
+                                    []( const chunk &ch, unsigned int k ) { return ch.key < k; } );
+        if( (at == chunks.end()) || (at->key != key) ) {
+            at = chunks.insert( at, { uint16_t(key), container() } );
+        }
+        compresseddetail::add( at->c, pos % chunkBits );
+        if( pos >= nBits ) {
+            nBits = pos + 1;
+        }
+    }
+
+    void clearBit( unsigned int pos ) {
+        unsigned int key = pos / chunkBits;
+        auto at = std::lower_bound( chunks.begin(), chunks.end(), key,
+                                    []( const chunk &ch, unsigned int k ) { return ch.key < k; } );
+        if( (at != chunks.end()) && (at->key == key) ) {
+            compresseddetail::remove( at->c, pos % chunkBits );
+            if( at->c.count == 0 ) {
+                chunks.erase( at );
+            }
+        }
+    }
+
+    // fn( pos ) for each one, in order
+    template<typename _Fn> void forEachOne( _Fn &&fn ) const {
+        for( auto &ch: chunks ) {
+            unsigned int base = unsigned(ch.key) * chunkBits;
+            switch( ch.c.kind ) {
+            case Kind::Array:
+                for( auto v: ch.c.values ) {
+                    fn( base + v );
+                }
+                break;
+            case Kind::Bitmap:
+                for( unsigned int w = 0; w < chunkWords; ++w ) {
+                    for( uint64_t bits = ch.c.words[w]; bits != 0; ) {
+                        unsigned int top = blockbits::countl_zero( bits );
+                        fn( base + w * 64 + top );
+                        bits &= ~( uint64_t(1) << (63 - top) );
+                    }
+                }
+                break;
+            case Kind::Run:
+                for( unsigned int r = 0; r < ch.c.runs(); ++r ) {
+                    for( unsigned int v = ch.c.values[2 * r]; v <= ch.c.values[2 * r + 1]; ++v ) {
+                        fn( base + v );
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // memory held, the object itself included
+    size_t bytesUsed() const {
+        size_t bytes = sizeof(*this) + chunks.capacity() * sizeof(chunk);
+        for( auto &ch: chunks ) {
+            bytes += ch.c.heapBytes();
+        }
+        return bytes;
+    }
+
+    // containers of each kind, for tuning: array, bitmap and run
+    unsigned int containerCount( compresseddetail::Kind kind ) const {
+        unsigned int n = 0;
+        for( auto &ch: chunks ) {
+            n += ( ch.c.kind == kind );
+        }
+        return n;
+    }
+
+    compressedbitmap &operator &=( const compressedbitmap &rightop ) {
+        logicWith<simd::LogicOp::And>( rightop );
+        return (*this);
+    }
+    compressedbitmap &operator |=( const compressedbitmap &rightop ) {
+        logicWith<simd::LogicOp::Or>( rightop );
+        return (*this);
+    }
+    compressedbitmap &operator ^=( const compressedbitmap &rightop ) {
+        logicWith<simd::LogicOp::Xor>( rightop );
+        return (*this);
+    }
+    // clears the bits set in rightop
+    compressedbitmap &andNot( const compressedbitmap &rightop ) {
+        logicWith<simd::LogicOp::AndNot>( rightop );
+        return (*this);
+    }
+
+    friend compressedbitmap operator&( compressedbitmap leftop, const compressedbitmap &rightop ) {
+        return leftop &= rightop;
+    }
+    friend compressedbitmap operator|( compressedbitmap leftop, const compressedbitmap &rightop ) {
+        return leftop |= rightop;
+    }
+    friend compressedbitmap operator^( compressedbitmap leftop, const compressedbitmap &rightop ) {
+        return leftop ^= rightop;
+    }
+
+    bool operator==( const compressedbitmap &comp ) const {
+        if( (nBits != comp.nBits) || (chunks.size() != comp.chunks.size()) ) {
+            return false;
+        }
+        for( size_t i = 0; i < chunks.size(); ++i ) {
+            if( (chunks[i].key != comp.chunks[i].key) ||
+                !compresseddetail::sameBits( chunks[i].c, comp.chunks[i].c ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool operator!=( const compressedbitmap &comp ) const {
+        return !(*this == comp);
+    }
+
+private:
+    struct chunk {
+        uint16_t key; // the top 16 bits of its positions
+        container c;
+    };
+
+    const chunk *find( unsigned int key ) const {
+        auto at = std::lower_bound( chunks.begin(), chunks.end(), key,
+                                    []( const chunk &ch, unsigned int k ) { return ch.key < k; } );
+        return ( (at != chunks.end()) && (at->key == key) ) ? &*at : nullptr;
+    }
+
+    // combine comp into this a chunk at a time, with bitstring's rules:
+    // the length stays, and bits comp does not reach are left alone
+    template<simd::LogicOp _Op> void logicWith( const compressedbitmap &comp ) {
+        constexpr bool keepX = compresseddetail::applyBit<_Op>( true, false );
+        constexpr bool keepY = compresseddetail::applyBit<_Op>( false, true );
+        // only And clears bits where comp has none: past comp's end it
+        // takes comp as ones instead
+        unsigned int reachLow = comp.nBits % chunkBits;
+        std::vector<chunk> out;
+        out.reserve( chunks.size() + (keepY ? comp.chunks.size() : 0) );
+        size_t i = 0;
+        size_t j = 0;
+        while( (i < chunks.size()) || (j < comp.chunks.size()) ) {
+            bool mine = (i < chunks.size()) && ( (j == comp.chunks.size()) || (chunks[i].key <= comp.chunks[j].key) );
+            bool theirs = (j < comp.chunks.size()) && ( (i == chunks.size()) || (comp.chunks[j].key <= chunks[i].key) );
+            unsigned int key = mine ? chunks[i].key : comp.chunks[j].key;
+            if( !keepX && mine && (uint64_t(key) * chunkBits + chunkBits > comp.nBits) ) {
+                if( uint64_t(key) * chunkBits >= comp.nBits ) {
+                    out.push_back( std::move( chunks[i] ) ); // comp doesn't get here
+                } else {
+                    container past = compresseddetail::range( reachLow, chunkBits - 1 );
+                    container ones = theirs ? compresseddetail::combine<simd::LogicOp::Or>( comp.chunks[j].c, past ) : past;
+                    keep( out, key, compresseddetail::combine<_Op>( chunks[i].c, ones ) );
+                }
+            } else if( mine && theirs ) {
+                keep( out, key, compresseddetail::combine<_Op>( chunks[i].c, comp.chunks[j].c ) );
+            } else if( mine && keepX ) {
+                out.push_back( std::move( chunks[i] ) );
+            } else if( theirs && keepY ) {
+                out.push_back( comp.chunks[j] );
+            }
+            i += mine;
+            j += theirs;
+        }
+        chunks.swap( out );
+        if( comp.nBits > nBits ) {
+            unsigned int length = nBits;
+            nBits = comp.nBits;
+            resize( length ); // drop what came past the end
+        }
+    }
+
+    static void keep( std::vector<chunk> &out, unsigned int key, container &&c ) {
+        if( c.count > 0 ) {
+            out.push_back( { uint16_t(key), std::move( c ) } );
+        }
+    }
+
+    std::vector<chunk> chunks; // by key
+    unsigned int nBits = 0;
+};
+
+} // namespace lxutil
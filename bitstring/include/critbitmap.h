@@ -0,0 +1,365 @@
+#pragma once
+
+// FILE: critbitmap.h
+// PURPOSE: ordered map keyed by bitstring, as a crit-bit (PATRICIA) tree.
+//          A lookup tests one bit per level on the way down and does a
+//          single full key compare at the leaf, instead of the O(log n)
+//          full compares (each rescanning the shared prefix) of a
+//          std::map<dynamicbitstring<>>.
+//
+// ORDER: the same as bitstring's operator<, a key that is a prefix of
+//          another sorts first. To get that, each key bit i is seen by
+//          the tree as two bits: 2i is "the key has bit i", 2i+1 is
+//          bit i itself (0 past the end). A prefix then differs from its
+//          extensions at an even bit, where it has the 0.
+//
+// ITERATION: leaves are also kept on a doubly linked list in key order,
+//          so iterating is a list walk and every key sharing a prefix
+//          sits in one contiguous run (see prefixRange).
+
+#include <utility> // std::pair
+#include <bitstring_core.h> // commonPrefixLength
+#include <vector>
+#include <stdint.h>
+
+namespace lxutil {
+
+template<typename _Key, typename _T> class critbitmap {
+    struct Leaf;
+    struct Node;
+public:
+    using key_type = _Key;
+    using mapped_type = _T;
+    using value_type = std::pair<const _Key, _T>;
+
+    class iterator {
+    public:
+        iterator() = default;
+        value_type &operator*() const {
+            return leaf->value;
+        }
+        value_type *operator->() const {
+            return &leaf->value;
+        }
+        iterator &operator++() {
+            leaf = leaf->next;
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator was = *this;
+            leaf = leaf->next;
+            return was;
+        }
+        bool operator==( const iterator &other ) const {
+            return leaf == other.leaf;
+        }
+        bool operator!=( const iterator &other ) const {
+            return leaf != other.leaf;
+        }
+    private:
+        friend class critbitmap;
+        explicit iterator( Leaf *l ): leaf(l) {}
+        Leaf *leaf = nullptr;
+    };
+
+    critbitmap() = default;
+    critbitmap( const critbitmap & ) = delete;
+    critbitmap &operator=( const critbitmap & ) = delete;
+    critbitmap( critbitmap &&other ):
+        root(other.root), head(other.head), tail(other.tail), count(other.count) {
+        other.root = 0;
+        other.head = other.tail = nullptr;
+        other.count = 0;
+    }
+    critbitmap &operator=( critbitmap &&other ) {
+        if( this != &other ) {
+            clear();
+            std::swap( root, other.root );
+            std::swap( head, other.head );
+            std::swap( tail, other.tail );
+            std::swap( count, other.count );
+        }
+        return *this;
+    }
+    ~critbitmap() {
+        clear();
+    }
+
+    size_t size() const {
+        return count;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+
+    iterator begin() const {
+        return iterator( head );
+    }
+    iterator end() const {
+        return iterator( nullptr );
+    }
+
+    iterator find( const _Key &key ) const {
+        if( root == 0 ) {
+            return end();
+        }
+        Leaf *l = walk( key );
+        return ( l->value.first == key ) ? iterator( l ) : end();
+    }
+
+    bool contains( const _Key &key ) const {
+        return find( key ) != end();
+    }
+
+    // adds key -> value if key is not there yet; the bool says which
+    std::pair<iterator, bool> insert( const _Key &key, const _T &value ) {
+        if( root == 0 ) {
+            Leaf *l = new Leaf( key, value );
+            root = tagLeaf( l );
+            head = tail = l;
+            ++count;
+            return { iterator( l ), true };
+        }
+
+        Leaf *nearest = walk( key );
+        unsigned int crit;
+        if( !criticalBit( key, nearest->value.first, crit ) ) {
+            return { iterator( nearest ), false };
+        }
+        unsigned int dir = virtualBit( key, crit );
+
+        // walk again, down to where the new branch goes: crit bits only
+        // grow going down, so that is the first node testing a later bit
+        uintptr_t *where = &root;
+        while( !isLeaf( *where ) ) {
+            Node *n = asNode( *where );
+            if( n->crit > crit ) {
+                break;
+            }
+            where = &n->child[ virtualBit( key, n->crit ) ];
+        }
+
+        Leaf *l = new Leaf( key, value );
+        Node *n = new Node;
+        n->crit = crit;
+        n->child[dir] = tagLeaf( l );
+        n->child[1 - dir] = *where;
+
+        // in order, the new leaf comes right before (after) everything
+        // in the subtree it branches off from
+        if( dir == 0 ) {
+            linkBefore( l, firstLeaf( *where ) );
+        } else {
+            linkAfter( l, lastLeaf( *where ) );
+        }
+        *where = tagNode( n );
+        ++count;
+        return { iterator( l ), true };
+    }
+
+    // the value for key, default constructed and added if missing
+    _T &operator[]( const _Key &key ) {
+        return insert( key, _T() ).first->second;
+    }
+
+    // true if key was there
+    bool erase( const _Key &key ) {
+        if( root == 0 ) {
+            return false;
+        }
+        uintptr_t *where = &root;
+        uintptr_t *parent = nullptr;
+        unsigned int dir = 0;
+        while( !isLeaf( *where ) ) {
+            parent = where;
+            Node *n = asNode( *where );
+            dir = virtualBit( key, n->crit );
+            where = &n->child[dir];
+        }
+        Leaf *l = asLeaf( *where );
+        if( !(l->value.first == key) ) {
+            return false;
+        }
+        unlink( l );
+        delete l;
+        if( parent == nullptr ) {
+            root = 0;
+        } else {
+            // the sibling takes the parent's place
+            Node *n = asNode( *parent );
+            *parent = n->child[1 - dir];
+            delete n;
+        }
+        --count;
+        return true;
+    }
+
+    // every key that starts with prefix, in order, as [first, second)
+    std::pair<iterator, iterator> prefixRange( const _Key &prefix ) const {
+        if( root == 0 ) {
+            return { end(), end() };
+        }
+        // all keys below a node agree on every bit before its crit bit,
+        // so the first node testing past the prefix holds all or none
+        unsigned int prefixEnd = 2 * prefix.sizeInBits();
+        uintptr_t at = root;
+        while( !isLeaf( at ) ) {
+            Node *n = asNode( at );
+            if( n->crit >= prefixEnd ) {
+                break;
+            }
+            at = n->child[ virtualBit( prefix, n->crit ) ];
+        }
+        Leaf *first = firstLeaf( at );
+        if( !hasPrefix( first->value.first, prefix ) ) {
+            return { end(), end() };
+        }
+        return { iterator( first ), iterator( lastLeaf( at )->next ) };
+    }
+
+    void clear() {
+        if( root != 0 ) {
+            destroy( root );
+        }
+        root = 0;
+        head = tail = nullptr;
+        count = 0;
+    }
+
+private:
+    struct Leaf {
+        Leaf( const _Key &k, const _T &v ): value(k, v) {}
+        value_type value;
+        Leaf *prev = nullptr;
+        Leaf *next = nullptr;
+    };
+    struct Node {
+        unsigned int crit; // virtual bit tested here
+        uintptr_t child[2];
+    };
+
+    // children are tagged pointers, the low bit set for a leaf
+    static bool isLeaf( uintptr_t p ) {
+        return (p & 1) != 0;
+    }
+    static Leaf *asLeaf( uintptr_t p ) {
+        return reinterpret_cast<Leaf *>( p & ~uintptr_t(1) );
+    }
+    static Node *asNode( uintptr_t p ) {
+        return reinterpret_cast<Node *>( p );
+    }
+    static uintptr_t tagLeaf( Leaf *l ) {
+        return reinterpret_cast<uintptr_t>( l ) | 1;
+    }
+    static uintptr_t tagNode( Node *n ) {
+        return reinterpret_cast<uintptr_t>( n );
+    }
+
+    // bit v of the key as the tree sees it (see ORDER above)
+    static unsigned int virtualBit( const _Key &key, unsigned int v ) {
+        unsigned int pos = v >> 1;
+        if( pos >= key.sizeInBits() ) {
+            return 0;
+        }
+        return ( (v & 1) == 0 ) ? 1 : key.bitAt( pos );
+    }
+
+    // first virtual bit where a and b differ, false if they are equal
+    static bool criticalBit( const _Key &a, const _Key &b, unsigned int &crit ) {
+        unsigned int common = commonPrefixLength( a, b );
+        if( common < a.sizeInBits() && common < b.sizeInBits() ) {
+            crit = 2 * common + 1; // both have the bit, it differs
+            return true;
+        }
+        if( a.sizeInBits() != b.sizeInBits() ) {
+            crit = 2 * common; // one ends there
+            return true;
+        }
+        return false;
+    }
+
+    static bool hasPrefix( const _Key &key, const _Key &prefix ) {
+        return key.sizeInBits() >= prefix.sizeInBits() &&
+               commonPrefixLength( key, prefix ) == prefix.sizeInBits();
+    }
+
+    // the leaf key would end up at; the only full compare is done on it
+    Leaf *walk( const _Key &key ) const {
+        uintptr_t at = root;
+        while( !isLeaf( at ) ) {
+            Node *n = asNode( at );
+            at = n->child[ virtualBit( key, n->crit ) ];
+        }
+        return asLeaf( at );
+    }
+
+    static Leaf *firstLeaf( uintptr_t at ) {
+        while( !isLeaf( at ) ) {
+            at = asNode( at )->child[0];
+        }
+        return asLeaf( at );
+    }
+    static Leaf *lastLeaf( uintptr_t at ) {
+        while( !isLeaf( at ) ) {
+            at = asNode( at )->child[1];
+        }
+        return asLeaf( at );
+    }
+
+    void linkBefore( Leaf *l, Leaf *next ) {
+        l->next = next;
+        l->prev = next->prev;
+        if( next->prev ) {
+            next->prev->next = l;
+        } else {
+            head = l;
+        }
+        next->prev = l;
+    }
+    void linkAfter( Leaf *l, Leaf *prev ) {
+        l->prev = prev;
+        l->next = prev->next;
+        if( prev->next ) {
+            prev->next->prev = l;
+        } else {
+            tail = l;
+        }
+        prev->next = l;
+    }
+    void unlink( Leaf *l ) {
+        if( l->prev ) {
+            l->prev->next = l->next;
+        } else {
+            head = l->next;
+        }
+        if( l->next ) {
+            l->next->prev = l->prev;
+        } else {
+            tail = l->prev;
+        }
+    }
+
+    // keys can be long and the tree as deep, so no recursion here
+    static void destroy( uintptr_t at ) {
+        std::vector<uintptr_t> pending( 1, at );
+        while( !pending.empty() ) {
+            at = pending.back();
+            pending.pop_back();
+            if( isLeaf( at ) ) {
+                delete asLeaf( at );
+                continue;
+            }
+            Node *n = asNode( at );
+            pending.push_back( n->child[0] );
+            pending.push_back( n->child[1] );
+            delete n;
+        }
+    }
+
+    uintptr_t root = 0;
+    Leaf *head = nullptr;
+    Leaf *tail = nullptr;
+    size_t count = 0;
+};
+
+} // namespace lxutil
@@ -5,14 +5,29 @@
 //          during runtime.
 
 #include <bitstring_core.h>
+#include <inlineblocks.h>
 #include <vector>
+#include <memory_resource>
 
 namespace lxutil {
 
 
 
-template<typename _StorageType = std::vector<unsigned int> >
+// _GrowthPolicy (growth::geometric, exact, nevershrink, or counting<>
+// around one of them) decides how storage grows and shrinks
+template<typename _StorageType = std::vector<unsigned int>, typename _GrowthPolicy = growth::nevershrink>
     using dynamicbitstring = 
-    bitstring<0, true /*expandable*/, true /*auto-initialized*/,  _StorageType>;
+    bitstring<0, true /*expandable*/, true /*auto-initialized*/,  _StorageType, _GrowthPolicy>;
+
+// storage from a std::pmr::memory_resource, e.g. a monotonic arena
+// that is dropped in one go once a request is done
+template<typename _BlockType = unsigned int>
+    using pmr_dynamicbitstring = dynamicbitstring< std::pmr::vector<_BlockType> >;
+
+// like dynamicbitstring, but up to _InlineBits live inside the object: no heap
+// allocation until the string grows past that
+template<unsigned int _InlineBits = 128, typename _BlockType = unsigned int>
+    using smalldynamicbitstring =
+    dynamicbitstring< inlineblocks<_BlockType, (_InlineBits + sizeof(_BlockType) * 8 - 1) / (sizeof(_BlockType) * 8)> >;
 
 } // namespace lxutil
\ No newline at end of file
@@ -0,0 +1,399 @@
+#pragma once
+
+// FILE: huffman.h
+// PURPOSE: canonical Huffman codes for streams of symbols (bytes, or
+//          any alphabet up to 65536 symbols), written to a bitstring
+//          and decoded through lookup tables instead of a tree walk.
+//
+// build() takes how often each symbol occurs and works out the code
+// lengths, none longer than maxLength; the codes themselves follow from
+// the lengths alone (canonical: shorter codes first, then by symbol),
+// so lengths() is all that has to be kept with the data, and assign()
+// sets up a decoder from it.
+//
+// DECODING: a primary table indexed by the next tableBits bits gives
+//          the symbol and code length of every code that short, and
+//          where two codes fit in those bits, both symbols; a longer
+//          code's prefix points to a second level table indexed by the
+//          bits up to the longest code. Lookups go into a 64 bit window
+//          loaded straight from the source's blocks, several codes per
+//          load; the decoder of bitstring_codes.h takes the last blocks.
+
+#include <bitstring_codes.h> // codes::encoder, codes::decoder
+#include <algorithm> // std::stable_sort, std::fill
+#include <span>
+#include <vector>
+#include <stdint.h>
+
+namespace lxutil {
+
+namespace huffmandetail {
+
+// primary table index bits: 2K entries of 8 bytes stay in L1
+constexpr unsigned int tableBits = 11;
+
+// a table slot: a symbol and its code length, or (sub set) the index
+// of a second level table. Length 0 without sub: no code starts so.
+// count 2: the slot also holds the code after it, symbol2, and both
+// take bothLength bits (bothLength is length when count is 1)
+struct entry {
+    uint16_t symbol = 0;
+    uint16_t symbol2 = 0;
+    uint8_t length = 0;
+    uint8_t bothLength = 0;
+    uint8_t count = 0;
+    uint8_t sub = 0;
+};
+
+// 64 bits from bit pos on, the blocks holding them all full ones
+template<typename _BlockType> inline uint64_t window( const _BlockType *blocks, size_t pos ) {
+    constexpr unsigned int bitsInBlock = sizeof(_BlockType) * 8;
+    const _BlockType *b = blocks + pos / bitsInBlock;
+    unsigned int shift = pos % bitsInBlock;
+    uint64_t w = b[0];
+    if constexpr( bitsInBlock < 64 ) {
+        for( unsigned int i = 1; i < 64 / bitsInBlock; ++i ) {
+            w = (w << bitsInBlock) | b[i];
+        }
+    }
+    if( shift > 0 ) {
+        w = (w << shift) | ( uint64_t( b[64 / bitsInBlock] ) >> (bitsInBlock - shift) );
+    }
+    return w;
+}
+
+// Huffman code lengths of the leaves, given their weights in ascending
+// order: two queues, the leaves and the merged nodes, which are made in
+// ascending weight order as well
+inline std::vector<unsigned int> treeDepths( const std::vector<uint64_t> &weights ) {
+    size_t n = weights.size();
+    std::vector<uint64_t> weight( 2 * n - 1 );
+    std::vector<size_t> parent( 2 * n - 1 );
+    std::copy( weights.begin(), weights.end(), weight.begin() );
+    size_t leaf = 0;
+    size_t node = n;
+    auto smallest = [&]( size_t next ) {
+        if( (leaf < n) && ((node >= next) || (weight[leaf] <= weight[node])) ) {
+            return leaf++;
+        }
+        return node++;
+    };
+    for( size_t next = n; next < 2 * n - 1; ++next ) {
+        size_t a = smallest( next );
+        size_t b = smallest( next );
+        weight[next] = weight[a] + weight[b];
+        parent[a] = next;
+        parent[b] = next;
+    }
+    // the root is last, every node comes after its children
+    std::vector<unsigned int> depth( 2 * n - 1 );
+    for( size_t i = 2 * n - 1; i-- > 0; ) {
+        depth[i] = ( i == 2 * n - 2 ) ? 0 : depth[parent[i]] + 1;
+    }
+    depth.resize( n );
+    return depth;
+}
+
+// counts[l]: codes of length l. Codes longer than maxLength are pulled
+// up the way JPEG does (Annex K.3): two of the longest become one a
+// bit shorter, and a shorter code splits in two to make room
+inline void limitLengths( std::vector<unsigned int> &counts, unsigned int maxLength ) {
+    for( unsigned int l = (unsigned int)counts.size() - 1; l > maxLength; --l ) {
+        while( counts[l] > 0 ) {
+            unsigned int j = l - 2;
+            while( counts[j] == 0 ) {
+                --j;
+            }
+            counts[l] -= 2;
+            counts[l - 1] += 1;
+            counts[j + 1] += 2;
+            counts[j] -= 1;
+        }
+    }
+    counts.resize( maxLength + 1 );
+}
+
+} // namespace huffmandetail
+
+class huffman {
+public:
+    static constexpr unsigned int maxSymbols = 65536;
+    static constexpr unsigned int longestCode = 24; // the most maxLength can be
+
+    huffman() = default;
+
+    // lengths for symbols occurring freqs[i] times (symbols not there
+    // get none), and the codes and tables that go with them. False if
+    // there are too many symbols, or they can't all have a code of
+    // maxLength bits or less
+    bool build( std::span<const uint64_t> freqs, unsigned int maxLength = 15 ) {
+        if( (freqs.size() > maxSymbols) || (maxLength == 0) || (maxLength > longestCode) ) {
+            return false;
+        }
+        std::vector<unsigned int> used;
+        for( unsigned int s = 0; s < freqs.size(); ++s ) {
+            if( freqs[s] > 0 ) {
+                used.push_back( s );
+            }
+        }
+        if( used.size() > (size_t(1) << maxLength) ) {
+            return false;
+        }
+        std::vector<uint8_t> newLengths( freqs.size(), 0 );
+        if( used.size() == 1 ) {
+            newLengths[used[0]] = 1;
+        } else if( used.size() > 1 ) {
+            // rarest first, and the rarest get the longest codes
+            std::stable_sort( used.begin(), used.end(), [&]( unsigned int a, unsigned int b ) {
+                return freqs[a] < freqs[b];
+            } );
+            std::vector<uint64_t> weights;
+            for( unsigned int s: used ) {
+                weights.push_back( freqs[s] );
+            }
+            std::vector<unsigned int> depths = huffmandetail::treeDepths( weights );
+            std::vector<unsigned int> counts( *std::max_element( depths.begin(), depths.end() ) + 1, 0 );
+            for( unsigned int d: depths ) {
+                ++counts[d];
+            }
+            if( counts.size() > maxLength + 1 ) {
+                huffmandetail::limitLengths( counts, maxLength );
+            }
+            size_t i = 0;
+            for( unsigned int l = (unsigned int)counts.size() - 1; l > 0; --l ) {
+                for( unsigned int c = 0; c < counts[l]; ++c ) {
+                    newLengths[used[i++]] = uint8_t( l );
+                }
+            }
+        }
+        return assign( newLengths );
+    }
+
+    // the codes and tables for these code lengths (0: no code), as
+    // build() made them. False if they are no prefix code
+    bool assign( std::span<const uint8_t> newLengths ) {
+        if( newLengths.size() > maxSymbols ) {
+            return false;
+        }
+        std::vector<uint64_t> counts( longestCode + 1, 0 );
+        unsigned int longest = 0;
+        for( uint8_t l: newLengths ) {
+            if( l > longestCode ) {
+                return false;
+            }
+            ++counts[l];
+            longest = ( l > longest ) ? l : longest;
+        }
+        // Kraft: the codes must fit in the code space
+        uint64_t space = 0;
+        for( unsigned int l = 1; l <= longest; ++l ) {
+            space += counts[l] << (longest - l);
+        }
+        if( space > (uint64_t(1) << longest) ) {
+            return false;
+        }
+
+        // canonical codes: by length, then by symbol
+        std::vector<uint32_t> next( longest + 2, 0 );
+        uint32_t first = 0;
+        counts[0] = 0;
+        for( unsigned int l = 1; l <= longest; ++l ) {
+            first = (first + uint32_t( counts[l - 1] )) << 1;
+            next[l] = first;
+        }
+        lengthOf.assign( newLengths.begin(), newLengths.end() );
+        codeBits.assign( newLengths.size(), 0 );
+        for( size_t s = 0; s < newLengths.size(); ++s ) {
+            if( newLengths[s] > 0 ) {
+                codeBits[s] = next[newLengths[s]]++;
+            }
+        }
+        maxCodeLength = longest;
+        buildTables();
+        return true;
+    }
+
+    // what to keep to decode later: code length by symbol
+    const std::vector<uint8_t> &lengths() const {
+        return lengthOf;
+    }
+    unsigned int symbolCount() const {
+        return (unsigned int)lengthOf.size();
+    }
+    unsigned int codeLength( unsigned int symbol ) const {
+        return ( symbol < lengthOf.size() ) ? lengthOf[symbol] : 0;
+    }
+    // right aligned, codeLength( symbol ) bits
+    uint32_t code( unsigned int symbol ) const {
+        return ( symbol < codeBits.size() ) ? codeBits[symbol] : 0;
+    }
+
+    // symbols appended to bits, their codes gathered 64 bits at a time.
+    // False at a symbol without a code (the ones before it are written)
+    // or once bits can't take more
+    template<typename _Bits, typename _Symbol> bool encode( _Bits &bits, std::span<const _Symbol> symbols ) const {
+        codes::encoder<_Bits> out( bits );
+        uint64_t acc = 0;
+        unsigned int accBits = 0;
+        for( _Symbol s: symbols ) {
+            unsigned int length = codeLength( s );
+            if( length == 0 ) {
+                out.put( acc, accBits );
+                return false;
+            }
+            if( accBits + length > 64 ) {
+                if( !out.put( acc, accBits ) ) {
+                    return false;
+                }
+                acc = 0;
+                accBits = 0;
+            }
+            acc = (acc << length) | codeBits[s];
+            accBits += length;
+        }
+        return out.put( acc, accBits );
+    }
+
+    // symbols decoded from startBit on into out, until out is full, the
+    // bits run out or they are no code; how many were decoded
+    template<typename _Source, typename _Symbol>
+    size_t decode( const _Source &bits, std::span<_Symbol> out, unsigned int startBit = 0 ) const {
+        if( maxCodeLength == 0 ) {
+            return 0;
+        }
+        const huffmandetail::entry *first = primary.data();
+        const huffmandetail::entry *second = secondary.data();
+        const unsigned int primaryShift = maxCodeLength - primaryBits;
+        const unsigned int primaryShift2 = 64 - maxCodeLength; // for a full window
+        const uint64_t secondaryMask = (uint64_t(1) << secondaryBits) - 1;
+        size_t n = 0;
+        size_t pos = startBit;
+        // the full blocks before the last: a window per load, and codes
+        // decoded from it while the longest one still fits. n moves on by
+        // the symbols a slot has; the slot after a single one gets its
+        // own value back, so nothing past the count returned changes and
+        // there is no branch on the count
+        constexpr unsigned int bitsInBlock = _Source::bitsPerBlock();
+        if constexpr( bitsInBlock <= 64 ) {
+            constexpr unsigned int windowBlocks = 64 / bitsInBlock + 1;
+            unsigned int nBlocks = bits.sizeInBlocks();
+            size_t fastEnd = ( nBlocks > windowBlocks ) ? size_t( nBlocks - windowBlocks ) * bitsInBlock : 0;
+            const auto *blocks = bits.data();
+            while( (pos < fastEnd) && (n + 1 < out.size()) ) {
+                uint64_t window = huffmandetail::window( blocks, pos );
+                unsigned int used = 0;
+                while( (used + maxCodeLength <= 64) && (n + 1 < out.size()) ) {
+                    huffmandetail::entry e = first[window >> (64 - primaryBits)];
+                    if( e.sub ) {
+                        e = second[(size_t(e.symbol) << secondaryBits) | ((window >> primaryShift2) & secondaryMask)];
+                    }
+                    if( e.length == 0 ) {
+                        return n;
+                    }
+                    out[n] = _Symbol( e.symbol );
+                    _Symbol next = out[n + 1];
+                    out[n + 1] = ( e.count == 2 ) ? _Symbol( e.symbol2 ) : next;
+                    n += e.count;
+                    window <<= e.bothLength;
+                    used += e.bothLength;
+                }
+                pos += used;
+            }
+        }
+        // the rest through the decoder, a code at a time: while a full
+        // buffer holds several, from it, then the last few
+        codes::decoder<_Source> in( bits, (unsigned int)pos );
+        while( n < out.size() ) {
+            uint64_t window = in.peek( 64 );
+            unsigned int room = in.buffered();
+            unsigned int used = 0;
+            while( (room - used >= maxCodeLength) && (n < out.size()) ) {
+                huffmandetail::entry e = first[window >> (64 - primaryBits)];
+                if( e.sub ) {
+                    e = second[(size_t(e.symbol) << secondaryBits) | ((window >> primaryShift2) & secondaryMask)];
+                }
+                if( e.length == 0 ) {
+                    in.consume( used );
+                    return n;
+                }
+                out[n++] = _Symbol( e.symbol );
+                window <<= e.length;
+                used += e.length;
+            }
+            in.consume( used );
+            if( used == 0 ) {
+                break; // less than a longest code left
+            }
+        }
+        while( (n < out.size()) && !in.atEnd() ) {
+            uint64_t next = in.peek( maxCodeLength );
+            huffmandetail::entry e = first[next >> primaryShift];
+            if( e.sub ) {
+                e = second[(size_t(e.symbol) << secondaryBits) | (next & secondaryMask)];
+            }
+            if( (e.length == 0) || !in.consume( e.length ) ) {
+                break;
+            }
+            out[n++] = _Symbol( e.symbol );
+        }
+        return n;
+    }
+
+private:
+    // every code up to primaryBits long fills the primary slots that
+    // start with it; longer ones go through their prefix's second level
+    void buildTables() {
+        primaryBits = ( maxCodeLength < huffmandetail::tableBits ) ? maxCodeLength : huffmandetail::tableBits;
+        secondaryBits = maxCodeLength - primaryBits;
+        primary.assign( size_t(1) << primaryBits, huffmandetail::entry() );
+        secondary.clear();
+        unsigned int nSecondary = 0;
+        for( size_t s = 0; s < lengthOf.size(); ++s ) {
+            unsigned int length = lengthOf[s];
+            if( length == 0 ) {
+                continue;
+            }
+            huffmandetail::entry e{ uint16_t( s ), 0, uint8_t( length ), uint8_t( length ), 1, 0 };
+            if( length <= primaryBits ) {
+                size_t from = size_t( codeBits[s] ) << (primaryBits - length);
+                std::fill( primary.begin() + from, primary.begin() + from + (size_t(1) << (primaryBits - length)), e );
+                continue;
+            }
+            unsigned int extra = length - primaryBits; // bits past the prefix
+            huffmandetail::entry &prefix = primary[codeBits[s] >> extra];
+            if( !prefix.sub ) {
+                prefix = huffmandetail::entry{ uint16_t( nSecondary++ ), 0, 0, 0, 0, 1 };
+                secondary.resize( size_t(nSecondary) << secondaryBits );
+            }
+            size_t from = ( size_t(prefix.symbol) << secondaryBits ) |
+                          ( size_t( codeBits[s] & ((uint32_t(1) << extra) - 1) ) << (secondaryBits - extra) );
+            std::fill( secondary.begin() + from, secondary.begin() + from + (size_t(1) << (secondaryBits - extra)), e );
+        }
+        // a slot whose code leaves room for a whole second one in the
+        // index bits gets that one too
+        std::vector<huffmandetail::entry> single( primary );
+        const size_t indexMask = (size_t(1) << primaryBits) - 1;
+        for( size_t i = 0; i < single.size(); ++i ) {
+            const huffmandetail::entry &e = single[i];
+            if( e.sub || (e.length == 0) || (e.length >= primaryBits) ) {
+                continue;
+            }
+            const huffmandetail::entry &next = single[(i << e.length) & indexMask];
+            if( !next.sub && (next.length > 0) && (e.length + next.length <= primaryBits) ) {
+                primary[i].symbol2 = next.symbol;
+                primary[i].bothLength = uint8_t( e.length + next.length );
+                primary[i].count = 2;
+            }
+        }
+    }
+
+    std::vector<uint8_t> lengthOf;  // by symbol, 0 for none
+    std::vector<uint32_t> codeBits; // by symbol, right aligned
+    unsigned int maxCodeLength = 0; // of the longest code
+    unsigned int primaryBits = 0;
+    unsigned int secondaryBits = 0;
+    std::vector<huffmandetail::entry> primary;
+    std::vector<huffmandetail::entry> secondary;
+};
+
+} // namespace lxutil
@@ -0,0 +1,185 @@
+#pragma once
+
+// FILE: inlineblocks.h
+// PURPOSE: block storage for dynamicbitstring that keeps the first
+//          _InlineBlocks blocks inside the object and only goes to the
+//          heap beyond that (small buffer optimization). Short strings,
+//          the common case for map keys, then cost no allocation at all.
+//
+// It has the part of the std::vector interface bitstring uses (data,
+// size, capacity, reserve, resize, shrink_to_fit, operator[]), so it
+// plugs in as _StorageType with the usual VectorSizeManager. As with
+// vector, resize zero fills new blocks and only shrink_to_fit gives
+// memory back.
+
+#include <memory> // std::allocator
+#include <type_traits>
+#include <string.h> // memcpy, memset
+#include <stddef.h>
+
+namespace lxutil {
+
+template<typename _BlockType, unsigned int _InlineBlocks> class inlineblocks {
+    static_assert( std::is_trivially_copyable<_BlockType>::value, "blocks are copied with memcpy" );
+    static_assert( _InlineBlocks > 0, "use std::vector for no inline blocks" );
+public:
+    using value_type = _BlockType;
+    using size_type = size_t;
+
+    inlineblocks() = default;
+
+    inlineblocks( const inlineblocks &from ) {
+        if( from.count > _InlineBlocks ) {
+            heap = allocate( from.count );
+            cap = from.count;
+        }
+        copyIn( from );
+    }
+
+    inlineblocks &operator=( const inlineblocks &from ) {
+        if( this != &from ) {
+            if( from.count > cap ) {
+                release();
+                heap = allocate( from.count );
+                cap = from.count;
+            }
+            copyIn( from );
+        }
+        return *this;
+    }
+
+    // heap blocks change hands, inline ones are copied
+    inlineblocks( inlineblocks &&from ) noexcept {
+        take( from );
+    }
+
+    inlineblocks &operator=( inlineblocks &&from ) noexcept {
+        if( this != &from ) {
+            release();
+            take( from );
+        }
+        return *this;
+    }
+
+    ~inlineblocks() {
+        release();
+    }
+
+    _BlockType *data() {
+        return onHeap() ? heap : local;
+    }
+    const _BlockType *data() const {
+        return onHeap() ? heap : local;
+    }
+    _BlockType &operator[]( size_t i ) {
+        return data()[i];
+    }
+    const _BlockType &operator[]( size_t i ) const {
+        return data()[i];
+    }
+
+    size_t size() const {
+        return count;
+    }
+    size_t capacity() const {
+        return cap;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+    // true once the blocks no longer fit inline
+    bool onHeap() const {
+        return cap > _InlineBlocks;
+    }
+
+    void reserve( size_t n ) {
+        if( n > cap ) {
+            grow( n );
+        }
+    }
+
+    void resize( size_t n ) {
+        if( n > cap ) {
+            grow( ( n > 2 * cap ) ? n : 2 * cap );
+        }
+        if( n > count ) {
+            memset( data() + count, 0, (n - count) * sizeof(_BlockType) );
+        }
+        count = (unsigned int)n;
+    }
+
+    // capacity down to size, back inside the object if it fits
+    void shrink_to_fit() {
+        if( !onHeap() || (count == cap) ) {
+            return;
+        }
+        _BlockType *blocks = heap;
+        size_t held = cap;
+        if( count > _InlineBlocks ) {
+            heap = allocate( count );
+            memcpy( heap, blocks, count * sizeof(_BlockType) );
+            cap = count;
+        } else {
+            if( count > 0 ) {
+                memcpy( local, blocks, count * sizeof(_BlockType) );
+            }
+            cap = _InlineBlocks;
+        }
+        std::allocator<_BlockType>().deallocate( blocks, held );
+    }
+
+private:
+    static _BlockType *allocate( size_t n ) {
+        return std::allocator<_BlockType>().allocate( n );
+    }
+
+    void release() {
+        if( onHeap() ) {
+            std::allocator<_BlockType>().deallocate( heap, cap );
+            cap = _InlineBlocks;
+        }
+    }
+
+    void grow( size_t n ) {
+        _BlockType *bigger = allocate( n );
+        if( count > 0 ) {
+            memcpy( bigger, data(), count * sizeof(_BlockType) );
+        }
+        release();
+        heap = bigger;
+        cap = (unsigned int)n;
+    }
+
+    // blocks of from, capacity already checked
+    void copyIn( const inlineblocks &from ) {
+        if( from.count > 0 ) {
+            memcpy( data(), from.data(), from.count * sizeof(_BlockType) );
+        }
+        count = from.count;
+    }
+
+    // everything of from, which is left empty; nothing held here
+    void take( inlineblocks &from ) {
+        if( from.onHeap() ) {
+            heap = from.heap;
+            cap = from.cap;
+            from.cap = _InlineBlocks;
+        } else {
+            cap = _InlineBlocks;
+            if( from.count > 0 ) {
+                memcpy( local, from.local, from.count * sizeof(_BlockType) );
+            }
+        }
+        count = from.count;
+        from.count = 0;
+    }
+
+    union {
+        _BlockType local[_InlineBlocks];
+        _BlockType *heap;
+    };
+    unsigned int count = 0; // same limit as bitstring's own block counts
+    unsigned int cap = _InlineBlocks;
+};
+
+} // namespace lxutil
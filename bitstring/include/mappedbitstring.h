@@ -0,0 +1,381 @@
+#pragma once
+
+// FILE: mappedbitstring.h
+// PURPOSE: bitstrings that live in a memory mapped file, for bitmaps
+//          too big to load: opening one costs a header check, and only
+//          the pages a lookup touches are read in. The mapping is
+//          shared, so every process on the host using the file uses
+//          the same copy in the page cache.
+//
+// FILE LAYOUT: a 64 byte header (magic "LXBM", version, block size and
+//          the length in bits), then the blocks as bitstring keeps them
+//          (see data()). Blocks are native integers, so a file only
+//          reads back on hosts of the same byte order.
+//
+// mappedblocks is the storage: the part of the std::vector interface
+// bitstring uses, so it plugs in as _StorageType like inlineblocks.
+// Growing it extends the file (ftruncate) and remaps.
+// mappedbitstring is the bitstring on top, mappedview the read-only
+// side for readers. POSIX only.
+
+#include <dynamicbitstring.h>
+#include <bitstring_view.h>
+#include <new> // std::bad_alloc
+#include <span>
+#include <type_traits>
+#include <string.h> // memcpy, memcmp, memset
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace lxutil {
+
+namespace mappeddetail {
+
+constexpr char magic[4] = { 'L', 'X', 'B', 'M' };
+constexpr uint32_t version = 1;
+constexpr size_t headerBytes = 64; // keeps the blocks 64 byte aligned
+
+struct header {
+    char magic[4];
+    uint32_t version;
+    uint32_t blockBytes;
+    uint32_t reserved;
+    uint64_t nBits;
+    unsigned char unused[headerBytes - 24];
+};
+static_assert( sizeof(header) == headerBytes, "header layout" );
+
+inline size_t pageRound( size_t bytes ) {
+    size_t page = size_t( sysconf( _SC_PAGESIZE ) );
+    return (bytes + page - 1) / page * page;
+}
+
+} // namespace mappeddetail
+
+
+template<typename _BlockType> class mappedblocks {
+    static_assert( std::is_trivially_copyable<_BlockType>::value, "blocks live in a file" );
+public:
+    using value_type = _BlockType;
+    using size_type = size_t;
+
+    // not backed by a file until create() or open(): blocks then go to
+    // an anonymous mapping
+    mappedblocks() = default;
+
+    mappedblocks( const mappedblocks & ) = delete;
+    mappedblocks &operator=( const mappedblocks & ) = delete;
+
+    mappedblocks( mappedblocks &&from ) noexcept {
+        take( from );
+    }
+    mappedblocks &operator=( mappedblocks &&from ) noexcept {
+        if( this != &from ) {
+            close();
+            take( from );
+        }
+        return *this;
+    }
+
+    ~mappedblocks() {
+        close();
+    }
+
+    // a new file at path, replacing what was there, with no blocks
+    bool create( const char *path ) {
+        close();
+        fd = ::open( path, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+        if( fd < 0 ) {
+            return false;
+        }
+        size_t bytes = mappeddetail::pageRound( mappeddetail::headerBytes );
+        if( (ftruncate( fd, off_t(bytes) ) != 0) || !map( bytes, true ) ) {
+            close();
+            return false;
+        }
+        mappeddetail::header h {};
+        memcpy( h.magic, mappeddetail::magic, sizeof(h.magic) );
+        h.version = mappeddetail::version;
+        h.blockBytes = sizeof(_BlockType);
+        memcpy( base, &h, sizeof(h) );
+        return true;
+    }
+
+    // an existing file; size() is then the blocks storedBits() needs.
+    // Read only maps it so: no writes, no growing
+    bool open( const char *path, bool writable = true ) {
+        close();
+        fd = ::open( path, writable ? O_RDWR : O_RDONLY );
+        struct stat st;
+        if( (fd < 0) || (fstat( fd, &st ) != 0) ||
+            (size_t(st.st_size) < mappeddetail::headerBytes) ||
+            !map( size_t(st.st_size), writable ) ) {
+            close();
+            return false;
+        }
+        mappeddetail::header h;
+        memcpy( &h, base, sizeof(h) );
+        uint64_t nBlocks = (h.nBits + bitsInBlock - 1) / bitsInBlock;
+        if( (memcmp( h.magic, mappeddetail::magic, sizeof(h.magic) ) != 0) ||
+            (h.version != mappeddetail::version) ||
+            (h.blockBytes != sizeof(_BlockType)) ||
+            (h.nBits > 0xFFFFFFFFu) || (nBlocks > cap) ) {
+            close();
+            return false;
+        }
+        count = size_t(nBlocks);
+        return true;
+    }
+
+    // unmaps; the file keeps what was written
+    void close() {
+        if( base != nullptr ) {
+            munmap( base, mapped );
+        }
+        if( fd >= 0 ) {
+            ::close( fd );
+        }
+        base = nullptr;
+        mapped = 0;
+        fd = -1;
+        count = 0;
+        cap = 0;
+    }
+
+    bool fileBacked() const {
+        return fd >= 0;
+    }
+
+    // the length in bits the header records
+    uint64_t storedBits() const {
+        uint64_t nBits = 0;
+        if( fileBacked() ) {
+            memcpy( &nBits, base + offsetof( mappeddetail::header, nBits ), sizeof(nBits) );
+        }
+        return nBits;
+    }
+    void storeBits( uint64_t nBits ) {
+        if( fileBacked() ) {
+            memcpy( base + offsetof( mappeddetail::header, nBits ), &nBits, sizeof(nBits) );
+        }
+    }
+
+    // writes dirty pages back to the file; waits for it unless async
+    bool flush( bool async = false ) {
+        if( !fileBacked() ) {
+            return true;
+        }
+        return msync( base, mapped, async ? MS_ASYNC : MS_SYNC ) == 0;
+    }
+
+    _BlockType *data() {
+        return base ? reinterpret_cast<_BlockType *>( base + mappeddetail::headerBytes ) : nullptr;
+    }
+    const _BlockType *data() const {
+        return base ? reinterpret_cast<const _BlockType *>( base + mappeddetail::headerBytes ) : nullptr;
+    }
+    _BlockType &operator[]( size_t i ) {
+        return data()[i];
+    }
+    const _BlockType &operator[]( size_t i ) const {
+        return data()[i];
+    }
+
+    size_t size() const {
+        return count;
+    }
+    size_t capacity() const {
+        return cap;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+
+    void reserve( size_t n ) {
+        if( n > cap ) {
+            grow( n );
+        }
+    }
+
+    // as with vector, new blocks are zero and memory is never given back
+    void resize( size_t n ) {
+        if( n > cap ) {
+            grow( ( n > 2 * cap ) ? n : 2 * cap );
+        }
+        if( n > count ) {
+            memset( data() + count, 0, (n - count) * sizeof(_BlockType) );
+        }
+        count = n;
+    }
+
+private:
+    static constexpr size_t bitsInBlock = sizeof(_BlockType) * 8;
+
+    // the whole file (or an anonymous region) at base
+    bool map( size_t bytes, bool writable ) {
+        int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        void *p = ( fd >= 0 ) ? mmap( nullptr, bytes, prot, MAP_SHARED, fd, 0 ) :
+                                mmap( nullptr, bytes, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( p == MAP_FAILED ) {
+            return false;
+        }
+        base = static_cast<unsigned char *>( p );
+        mapped = bytes;
+        cap = (bytes - mappeddetail::headerBytes) / sizeof(_BlockType);
+        return true;
+    }
+
+    // room for n blocks: the file first, then the mapping. Like the
+    // allocators of other storage, throws bad_alloc when that fails
+    void grow( size_t n ) {
+        size_t bytes = mappeddetail::pageRound( mappeddetail::headerBytes + n * sizeof(_BlockType) );
+        if( base == nullptr ) {
+            if( !map( bytes, true ) ) {
+                throw std::bad_alloc();
+            }
+            return;
+        }
+        if( (fd >= 0) && (ftruncate( fd, off_t(bytes) ) != 0) ) {
+            throw std::bad_alloc();
+        }
+#ifdef MREMAP_MAYMOVE
+        void *p = mremap( base, mapped, bytes, MREMAP_MAYMOVE );
+        if( p == MAP_FAILED ) {
+            throw std::bad_alloc();
+        }
+#else
+        // a new mapping; only an anonymous one has to be copied over
+        void *p = ( fd >= 0 ) ? mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) :
+                                mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( p == MAP_FAILED ) {
+            throw std::bad_alloc();
+        }
+        if( fd < 0 ) {
+            memcpy( p, base, mapped );
+        }
+        munmap( base, mapped );
+#endif
+        base = static_cast<unsigned char *>( p );
+        mapped = bytes;
+        cap = (bytes - mappeddetail::headerBytes) / sizeof(_BlockType);
+    }
+
+    // everything of from, which is left closed; nothing held here
+    void take( mappedblocks &from ) {
+        base = from.base;
+        mapped = from.mapped;
+        fd = from.fd;
+        count = from.count;
+        cap = from.cap;
+        from.base = nullptr;
+        from.mapped = 0;
+        from.fd = -1;
+        from.count = 0;
+        from.cap = 0;
+    }
+
+    unsigned char *base = nullptr; // the header, blocks follow
+    size_t mapped = 0;
+    int fd = -1;
+    size_t count = 0;
+    size_t cap = 0;
+};
+
+
+// a dynamicbitstring kept in a file. Changes go straight to the shared
+// mapping; flush() records the length and writes them back, and the
+// destructor records the length too
+template<typename _BlockType = uint64_t>
+class mappedbitstring: public dynamicbitstring< mappedblocks<_BlockType> > {
+    using base = dynamicbitstring< mappedblocks<_BlockType> >;
+public:
+    // in memory until create() or open()
+    mappedbitstring() = default;
+
+    mappedbitstring( const mappedbitstring & ) = delete;
+    mappedbitstring &operator=( const mappedbitstring & ) = delete;
+    mappedbitstring( mappedbitstring && ) = default;
+    mappedbitstring &operator=( mappedbitstring &&from ) {
+        if( this != &from ) {
+            storeLength();
+            base::operator=( std::move(from) );
+        }
+        return *this;
+    }
+
+    ~mappedbitstring() {
+        storeLength();
+    }
+
+    // a new empty bitstring in a file at path, replacing what was there
+    bool create( const char *path ) {
+        mappedblocks<_BlockType> blocks;
+        return blocks.create( path ) && adopt( std::move(blocks) );
+    }
+
+    // the bitstring a file at path holds, for reading and writing
+    bool open( const char *path ) {
+        mappedblocks<_BlockType> blocks;
+        return blocks.open( path, true ) && adopt( std::move(blocks) );
+    }
+
+    bool fileBacked() const {
+        return this->blockStorage().fileBacked();
+    }
+
+    // records the length and writes changed pages back to the file;
+    // async only starts the writes
+    bool flush( bool async = false ) {
+        storeLength();
+        return this->blockStorage().flush( async );
+    }
+
+private:
+    bool adopt( mappedblocks<_BlockType> &&blocks ) {
+        storeLength();
+        unsigned int nBits = (unsigned int)blocks.storedBits();
+        this->blockStorage() = std::move(blocks);
+        // the blocks are there already, only the lengths are set up
+        return this->loadBlocks( nBits, []( _BlockType *, unsigned int ) {} );
+    }
+
+    void storeLength() {
+        this->blockStorage().storeBits( this->sizeInBits() );
+    }
+};
+
+
+// read-only side: a shared read-only mapping of a mappedbitstring file.
+// Nothing is read until view() is used, and then only the pages touched.
+// A writer growing the file later is not seen until open() again
+template<typename _BlockType = uint64_t> class mappedview {
+public:
+    bool open( const char *path ) {
+        return blocks.open( path, false );
+    }
+    void close() {
+        blocks.close();
+    }
+    bool isOpen() const {
+        return blocks.fileBacked();
+    }
+
+    unsigned int sizeInBits() const {
+        return (unsigned int)blocks.storedBits();
+    }
+
+    // valid while this stays open
+    bitstring_view<_BlockType> view() const {
+        return bitstring_view<_BlockType>( std::span<const _BlockType>( blocks.data(), blocks.size() ),
+                                           sizeInBits() );
+    }
+
+private:
+    mappedblocks<_BlockType> blocks;
+};
+
+} // namespace lxutil
@@ -1,11 +1,29 @@
 #include <dynamicbitstring.h>
 #include <staticbitstring.h>
+#include <rankindex.h>
+#include <bitstring_hash.h>
+#include <critbitmap.h>
+#include <bitstring_view.h>
+#include <bitstring_serial.h>
+#include <mappedbitstring.h>
+#include <atomic_bitstring.h>
+#include <bitstring_parallel.h>
+#include <compressedbitmap.h>
+#include <bitstring_expr.h>
+#include <bitstring_codes.h>
+#include <huffman.h>
+#include <map>
 
 #include <iostream>
 #include <fstream>
 #include <array>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <unordered_set>
+#include <memory_resource>
+#include <thread>
+#include <type_traits>
 
 static bool allPass = true;
 
@@ -14,9 +32,27 @@ using Test = std::array<unsigned int, 2>;
 
 static std::ofstream nullOut; // intentionally unopened
 
+#ifdef __SIZEOF_INT128__
+// for 128 bit blocks: no stream output for them in the library
+std::ostream &operator<<( std::ostream &out, unsigned __int128 value ) {
+  return out << std::hex << "0x" << uint64_t(value >> 64) << ":" << uint64_t(value) << std::dec;
+}
+#endif
+
+// an unsigned result against a plain int literal compares by value
+template < typename _ChkType1, typename _ChkType2 >
+bool same_value( _ChkType1 was, _ChkType2 shouldbe ) {
+  if constexpr( std::is_integral_v<_ChkType2> && std::is_signed_v<_ChkType2> && !std::is_signed_v<_ChkType1> &&
+                !std::is_class_v<_ChkType1> && (sizeof(_ChkType1) >= sizeof(_ChkType2)) ) {
+    return (shouldbe >= 0) && (was == _ChkType1( shouldbe ));
+  } else {
+    return was == shouldbe;
+  }
+}
+
 template < typename _ChkType1, typename _ChkType2 >
 std::ostream &check_eq( const std::string &testname,  _ChkType1 was, _ChkType2 shouldbe ) {
-  if( was == shouldbe ) {
+  if( same_value( was, shouldbe ) ) {
     std::cout << "PASS: " << testname <<  std::endl;
     return nullOut;
   } else {
@@ -94,7 +130,7 @@ template<typename _C> void flexTest(const std::string &testname, _C &a ) {
   a.write( (1<<31) + (1<<15), 32, 32 );
   check_eq( "t10", a.sizeInBits(), 64 ) << std::endl;
   auto save2 = a.read(32,32);
-  check_eq( "t11", save2, (1<<31) + (1<<15) ) << std::endl;
+  check_eq( "t11", save2, (1u<<31) + (1u<<15) ) << std::endl;
   check_eq( "t12", a.read(0,32), save1 ) << std::endl;
 
   a.write( 10, 64, 4);
@@ -106,7 +142,7 @@ template<typename _C> void flexTest(const std::string &testname, _C &a ) {
   a.write( 11, 158, 4); // a boundary further away
   check_eq( "pre8", a.read(0,32), save1 ) << std::endl;
   check_eq( "pre9", a.read(32,32), save2 ) << std::endl;
-  check_eq( "pre10", a.read(64,32), 10 << 28 ) << std::endl;
+  check_eq( "pre10", a.read(64,32), 10u << 28 ) << std::endl;
   check_eq( "pre11", a.read(96,32), 0 ) << std::endl;
   check_eq( "pre12", a.read(64,4), 10 ) << std::endl;
   check_eq( "t15", a.read(158,4), 11 ) << std::endl;
@@ -230,6 +266,48 @@ template<typename _C> void compareTest(const std::string &testname, _C &b ) {
 }
 
 
+template<typename _C> void orderTest(const std::string &testname ) {
+  std::cout << "---- orderTest: " << testname << std::endl;
+  _C base;
+  unsigned int seed = 77;
+  for( unsigned int i = 0; i < 3000; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    base.addBits( seed >> 31, 1 );
+  }
+  auto detected = lxutil::simd::detectedLevel();
+  for( int l = 0; l <= static_cast<int>(detected); ++l ) {
+    lxutil::simd::setLevel( static_cast<lxutil::simd::Level>(l) );
+    std::string lname = "simd" + std::to_string(l);
+    bool prefix = true;
+    bool order = true;
+    for( unsigned int pos: { 0u, 1u, 31u, 63u, 64u, 100u, 511u, 512u, 1000u, 2047u, 2999u } ) {
+      _C other( base );
+      other.write( base.bitAt( pos ) ? 0 : 1, pos, 1 );
+      prefix = prefix && ( lxutil::commonPrefixLength( base, other ) == pos );
+      auto expect = base.bitAt( pos ) ? std::strong_ordering::greater : std::strong_ordering::less;
+      order = order && ( (base <=> other) == expect ) && ( (0 <=> (other <=> base)) == expect ) &&
+              ( base != other ) && ( (base < other) == (expect < 0) );
+      // a view on either side agrees
+      lxutil::bitstring_view<typename _C::BlockType> bv( base );
+      lxutil::bitstring_view<typename _C::BlockType> ov( other );
+      order = order && ( (bv <=> ov) == expect ) && ( lxutil::commonPrefixLength( bv, other ) == pos );
+    }
+    check_true( lname + ".prefix", prefix ) << std::endl;
+    check_true( lname + ".order", order ) << std::endl;
+
+    // a prefix of a string sorts first
+    _C shorter( base );
+    shorter.resize( 2500 );
+    check_eq( lname + ".common", lxutil::commonPrefixLength( base, shorter ), 2500 ) << std::endl;
+    check_true( lname + ".shorter", (shorter <=> base) == std::strong_ordering::less ) << std::endl;
+    check_true( lname + ".same", (base <=> _C( base )) == std::strong_ordering::equal ) << std::endl;
+    _C empty;
+    check_eq( lname + ".empty", lxutil::commonPrefixLength( empty, base ), 0 ) << std::endl;
+    check_true( lname + ".empty.order", (empty <=> base) < 0 ) << std::endl;
+  }
+  lxutil::simd::setLevel( detected );
+}
+
 template<typename _C> void logicTest(const std::string &testname, _C &a ) {
   std::cout << "---- logicTest: " << testname << std::endl;
 
@@ -421,6 +499,1644 @@ template<typename _C> void logicTest(const std::string &testname, _C &a ) {
     }
 }
 
+template<typename _C, typename _Array> void bulkTest(const std::string &testname, const _Array &test1 ) {
+  std::cout << "---- bulkTest: " << testname << std::endl;
+  using Field = typename _C::Field;
+  _C single;
+  _C bulk;
+  std::vector<Field> fields;
+  for( auto &oneTest: test1 ) {
+    single.addBits( oneTest[0], oneTest[1] );
+    fields.push_back( Field{ oneTest[0], oneTest[1] } );
+  }
+  check_true( "fields", bulk.addBits( fields ) ) << std::endl;
+  check_eq( "fields.size", bulk.sizeInBits(), single.sizeInBits() ) << std::endl;
+  check_true( "fields.eq", bulk == single ) << std::endl;
+
+  // again, starting from a partial block
+  check_true( "fields2", bulk.addBits( fields ) ) << std::endl;
+  for( auto &oneTest: test1 ) {
+    single.addBits( oneTest[0], oneTest[1] );
+  }
+  check_true( "fields2.eq", bulk == single ) << std::endl;
+
+  std::vector<unsigned int> values { 1, 2, 3, 4, 5, 6, 7, 0xFF };
+  check_true( "fixed", bulk.addBits( values, 5 ) ) << std::endl;
+  for( auto v: values ) {
+    single.addBits( v, 5 );
+  }
+  check_true( "fixed.eq", bulk == single ) << std::endl;
+  check_eq( "fixed.last", bulk.read( bulk.sizeInBits() - 5, 5 ), 0x1F ) << std::endl;
+
+  std::vector<unsigned int> whole { 0xa000b000, 0xc000d000 };
+  check_true( "whole", bulk.addBits( whole, 32 ) ) << std::endl;
+  check_eq( "whole.a", bulk.read( bulk.sizeInBits() - 64, 32 ), 0xa000b000 ) << std::endl;
+  check_eq( "whole.b", bulk.read( bulk.sizeInBits() - 32, 32 ), 0xc000d000 ) << std::endl;
+}
+
+template<typename _C> void moreLogicTest(const std::string &testname ) {
+  std::cout << "---- moreLogicTest: " << testname << std::endl;
+  _C a;
+  a.addBits( 5, 32 );
+  a.addBits( 0x50000, 32 );
+  a.addBits( 9, 4 );
+  _C b;
+  b.addBits( 3, 32 );
+  b.addBits( 0x30000, 32 );
+  b.addBits( 3, 3 );
+
+  _C c = a ^ b;
+  check_eq( "xor.a", c.read(0,32), 6 ) << std::endl;
+  check_eq( "xor.b", c.read(32,32), 0x60000 ) << std::endl;
+  check_eq( "xor.c", c.read(64,4), 0xF ) << std::endl; // last bit out of reach
+  check_eq( "xor.size", c.sizeInBits(), 68 ) << std::endl;
+
+  c = a;
+  c.andNot( b );
+  check_eq( "andnot.a", c.read(0,32), 4 ) << std::endl;
+  check_eq( "andnot.b", c.read(32,32), 0x40000 ) << std::endl;
+  check_eq( "andnot.c", c.read(64,4), 9 ) << std::endl;
+
+  c = ~a;
+  check_eq( "not.a", c.read(0,32), ~5u ) << std::endl;
+  check_eq( "not.b", c.read(32,32), ~0x50000u ) << std::endl;
+  check_eq( "not.c", c.read(64,4), 6 ) << std::endl;
+  check_true( "not.not", ~c == a ) << std::endl;
+
+  c = a & b;
+  check_eq( "and.a", c.read(0,32), 1 ) << std::endl;
+  check_eq( "and.c", c.read(64,4), 1 ) << std::endl;
+  c = a | b;
+  check_eq( "or.a", c.read(0,32), 7 ) << std::endl;
+  check_eq( "or.c", c.read(64,4), 0xF ) << std::endl;
+  check_eq( "nomut.a", a.read(0,32), 5 ) << std::endl;
+
+  // long strings, every instruction set the CPU has
+  _C x;
+  _C y;
+  unsigned int seed = 12345;
+  for( int i = 0; i < 300; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    x.addBits( seed, 32 );
+    seed = seed * 1103515245 + 12345;
+    y.addBits( seed, (i < 299) ? 32 : 7 );
+  }
+  auto detected = lxutil::simd::detectedLevel();
+  for( int l = 0; l <= static_cast<int>(detected); ++l ) {
+    lxutil::simd::setLevel( static_cast<lxutil::simd::Level>(l) );
+    std::string lname = "simd" + std::to_string(l);
+    _C r = x ^ y;
+    bool same = true;
+    for( unsigned int i = 0; i < r.sizeInBits(); ++i ) {
+      unsigned int bit = ( i < y.sizeInBits() ) ?
+          ( x.read(i,1) ^ y.read(i,1) ) : x.read(i,1);
+      same = same && ( r.read(i,1) == bit );
+    }
+    check_true( lname + ".xor", same ) << std::endl;
+
+    r.andNot( x & y );
+    _C expected = ( x | y );
+    expected.andNot( x & y );
+    check_true( lname + ".eq", r == expected ) << std::endl;
+    check_true( lname + ".not", (~x ^ x).read(100,32) == 0xFFFFFFFF ) << std::endl;
+  }
+  lxutil::simd::setLevel( detected );
+}
+
+// bit by bit reference: where the bit at i comes from after a shift
+template<typename _C> bool sameShifted( _C &shifted, _C &orig, int offset, bool rotate ) {
+  int n = static_cast<int>( orig.sizeInBits() );
+  if( static_cast<int>( shifted.sizeInBits() ) != n ) {
+    return false;
+  }
+  for( int i = 0; i < n; ++i ) {
+    int from = i + offset;
+    unsigned int expected = 0;
+    if( rotate ) {
+      expected = orig.read( ((from % n) + n) % n, 1 );
+    } else if( (from >= 0) && (from < n) ) {
+      expected = orig.read( from, 1 );
+    }
+    if( shifted.read(i, 1) != expected ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename _C> void shiftTest(const std::string &testname ) {
+  std::cout << "---- shiftTest: " << testname << std::endl;
+  _C a;
+  a.addBits( 0x80000001, 32 );
+  a.addBits( 0x3, 4 );
+  _C b(a);
+  b <<= 1;
+  check_eq( "shl1.a", b.read(0,32), 0x00000002 ) << std::endl;
+  check_eq( "shl1.b", b.read(32,4), 0x6 ) << std::endl;
+  b = a >> 2;
+  check_eq( "shr2.a", b.read(0,32), 0x20000000 ) << std::endl;
+  check_eq( "shr2.b", b.read(32,4), 0x4 ) << std::endl;
+  b = a;
+  b.rotateLeft( 1 );
+  check_eq( "rol1.a", b.read(0,32), 0x00000002 ) << std::endl;
+  check_eq( "rol1.b", b.read(32,4), 0x7 ) << std::endl;
+  b.rotateRight( 1 );
+  check_true( "ror1", b == a ) << std::endl;
+  b <<= 36;
+  check_eq( "shlall", b.read(0,32), 0 ) << std::endl;
+  check_eq( "shlall.size", b.sizeInBits(), 36 ) << std::endl;
+
+  _C x;
+  unsigned int seed = 777;
+  for( int i = 0; i < 40; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    x.addBits( seed, (i < 39) ? 32 : 11 );
+  }
+  for( int n: { 1, 5, 31, 32, 33, 64, 100, 500, 1258 } ) {
+    std::string nname = std::to_string(n);
+    _C y(x);
+    y <<= n;
+    check_true( "shl." + nname, sameShifted( y, x, n, false ) ) << std::endl;
+    y = x;
+    y >>= n;
+    check_true( "shr." + nname, sameShifted( y, x, -n, false ) ) << std::endl;
+    y = x;
+    y.rotateLeft( n );
+    check_true( "rol." + nname, sameShifted( y, x, n, true ) ) << std::endl;
+    y = x;
+    y.rotateRight( n );
+    check_true( "ror." + nname, sameShifted( y, x, -n, true ) ) << std::endl;
+  }
+}
+
+template<typename _C> void appendTest(const std::string &testname ) {
+  std::cout << "---- appendTest: " << testname << std::endl;
+  _C x;
+  unsigned int seed = 4242;
+  for( int i = 0; i < 10; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    x.addBits( seed, (i < 9) ? 32 : 21 );
+  }
+
+  for( unsigned int lead: { 0u, 3u, 32u, 45u } ) {
+    std::string lname = std::to_string(lead);
+    _C a;
+    _C expected;
+    a.resize( lead );
+    expected.resize( lead );
+    for( unsigned int i = 0; i < x.sizeInBits(); ++i ) {
+      expected.addBits( x.read(i,1), 1 );
+    }
+    check_true( "append." + lname, a.append( x ) ) << std::endl;
+    check_true( "append.eq." + lname, a == expected ) << std::endl;
+
+    _C b;
+    b.resize( lead );
+    b += x;
+    b = b + x;
+    expected.append( x );
+    check_true( "plus.eq." + lname, b == expected ) << std::endl;
+
+    for( unsigned int start: { 0u, 5u, 32u, 100u } ) {
+      std::string rname = lname + "." + std::to_string(start);
+      _C c;
+      _C rexpected;
+      c.resize( lead );
+      rexpected.resize( lead );
+      c.append( x, start, 150 );
+      for( unsigned int i = start; i < start + 150; ++i ) {
+        rexpected.addBits( x.read(i,1), 1 );
+      }
+      check_true( "range.eq." + rname, c == rexpected ) << std::endl;
+
+      c.resize( lead );
+      c.append( x, start, 10000 ); // capped at the end of x
+      check_eq( "range.cap." + rname, c.sizeInBits(), lead + x.sizeInBits() - start ) << std::endl;
+      check_eq( "range.last." + rname, c.read( c.sizeInBits() - 21, 21 ),
+                x.read( x.sizeInBits() - 21, 21 ) ) << std::endl;
+    }
+  }
+
+  _C self(x);
+  self.append( self );
+  check_true( "self", self == x + x ) << std::endl;
+}
+
+template<typename _C> void editTest(const std::string &testname ) {
+  std::cout << "---- editTest: " << testname << std::endl;
+  _C x;
+  unsigned int seed = 99;
+  for( int i = 0; i < 12; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    x.addBits( seed, (i < 11) ? 32 : 19 );
+  }
+  _C piece;
+  piece.addBits( 0x12345678, 32 );
+  piece.addBits( 0x5, 3 );
+
+  for( unsigned int pos: { 0u, 1u, 31u, 32u, 40u, 200u, 370u } ) {
+    for( unsigned int n: { 1u, 7u, 32u, 33u, 100u } ) {
+      std::string name = std::to_string(pos) + "." + std::to_string(n);
+      _C e(x);
+      e.erase( pos, n );
+      _C expected;
+      for( unsigned int i = 0; i < x.sizeInBits(); ++i ) {
+        if( (i < pos) || (i >= pos + n) ) {
+          expected.addBits( x.read(i,1), 1 );
+        }
+      }
+      check_true( "erase." + name, e == expected ) << std::endl;
+    }
+
+    std::string name = std::to_string(pos);
+    _C in(x);
+    check_true( "insert.ok." + name, in.insert( pos, piece ) ) << std::endl;
+    _C expected;
+    expected.append( x, 0, pos );
+    expected.append( piece );
+    expected.append( x, pos, x.sizeInBits() );
+    check_true( "insert." + name, in == expected ) << std::endl;
+
+    in.erase( pos, piece.sizeInBits() );
+    check_true( "insert.undo." + name, in == x ) << std::endl;
+
+    in.insert( pos, 0x2B, 6 );
+    check_eq( "insertv." + name, in.read( pos, 6 ), 0x2B ) << std::endl;
+    check_eq( "insertv.size." + name, in.sizeInBits(), x.sizeInBits() + 6 ) << std::endl;
+  }
+
+  _C all(x);
+  all.erase( 0, all.sizeInBits() );
+  check_eq( "erase.all", all.sizeInBits(), 0 ) << std::endl;
+  check_true( "erase.all.eq", all == _C() ) << std::endl;
+  all.insert( 0, piece );
+  check_true( "insert.empty", all == piece ) << std::endl;
+}
+
+template<typename _C> bool rankMatches( const lxutil::rankindex<_C> &idx, _C &a ) {
+  uint64_t ones = 0;
+  uint64_t zeros = 0;
+  for( unsigned int i = 0; i < a.sizeInBits(); ++i ) {
+    if( idx.rank1(i) != ones || idx.rank0(i) != zeros ) {
+      return false;
+    }
+    if( a.read(i,1) ) {
+      if( idx.select1( ones ) != i ) return false;
+      ++ones;
+    } else {
+      if( idx.select0( zeros ) != i ) return false;
+      ++zeros;
+    }
+  }
+  return (idx.ones() == ones) && (idx.rank1( a.sizeInBits() ) == ones) &&
+         (idx.select1( ones ) == a.sizeInBits()) && (idx.select0( zeros ) == a.sizeInBits());
+}
+
+template<typename _C> void rankTest(const std::string &testname ) {
+  std::cout << "---- rankTest: " << testname << std::endl;
+  _C a;
+  unsigned int seed = 31337;
+  for( int i = 0; i < 3000; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    unsigned int v = seed;
+    if( (i / 500) % 2 ) {
+      v &= (seed >> 7) & (seed >> 13); // sparse stretch
+    }
+    a.addBits( v, 32 );
+  }
+  a.addBits( 0x15, 5 );
+
+  lxutil::rankindex<_C> idx( a );
+  check_false( "fresh", idx.isStale() ) << std::endl;
+  check_true( "rankselect", rankMatches( idx, a ) ) << std::endl;
+  check_true( "overhead", idx.memoryBytes() * 8 < a.sizeInBits() / 4 ) << std::endl;
+
+  a.addBits( 0xFFFF, 16 );
+  a.write( 0, 50000, 32 );
+  check_true( "stale", idx.isStale() ) << std::endl;
+  idx.refresh();
+  check_true( "refresh", rankMatches( idx, a ) ) << std::endl;
+
+  a.resize( 40000 );
+  idx.refresh();
+  check_true( "shrink", rankMatches( idx, a ) ) << std::endl;
+
+  lxutil::rankindex<_C> other( a );
+  a.flip();
+  other.refresh();
+  idx.refresh();
+  check_true( "flip", rankMatches( idx, a ) ) << std::endl;
+  check_true( "flip.other", rankMatches( other, a ) ) << std::endl;
+
+  // every index gets its own first changed block, whoever asks first
+  unsigned int lastBlock = a.sizeInBlocks() - 1;
+  unsigned int before = a.changeGeneration();
+  a.write( 5, 200, 3 );
+  unsigned int between = a.changeGeneration();
+  a.write( 1, a.sizeInBits() - 3, 3 );
+  a.write( 6, a.sizeInBits() - 3, 3 );
+  check_eq( "log.before", a.firstChangedBlock( before ), 200 / _C::bitsPerBlock() ) << std::endl;
+  check_eq( "log.between", a.firstChangedBlock( between ), lastBlock ) << std::endl;
+  check_eq( "log.now", a.firstChangedBlock( a.changeGeneration() ), a.sizeInBlocks() ) << std::endl;
+  check_eq( "log.before.again", a.firstChangedBlock( before ), 200 / _C::bitsPerBlock() ) << std::endl;
+  for( unsigned int i = 0; i < 8; ++i ) {
+    a.write( 1, (i + 1) * 1000, 1 ); // rising blocks fill the log
+  }
+  check_true( "log.full", a.firstChangedBlock( before ) <= 200 / _C::bitsPerBlock() ) << std::endl;
+  check_true( "log.full.between", a.firstChangedBlock( between ) <= lastBlock ) << std::endl;
+  idx.refresh();
+  other.refresh();
+  check_true( "log.refresh", rankMatches( idx, a ) && rankMatches( other, a ) ) << std::endl;
+}
+
+template<typename _C> void findTest(const std::string &testname ) {
+  std::cout << "---- findTest: " << testname << std::endl;
+  _C a;
+  check_eq( "empty.first", a.findFirst(), 0 ) << std::endl;
+  check_eq( "empty.last", a.findLast(), 0 ) << std::endl;
+  check_true( "empty.range", a.setBits().begin() == a.setBits().end() ) << std::endl;
+
+  a.addBits( 0, 32 );
+  a.addBits( 0, 32 );
+  a.addBits( 0x80000001, 32 );
+  a.addBits( 0, 32 );
+  a.addBits( 0x5, 3 ); // 101 at the very end
+  check_eq( "first", a.findFirst(), 64 ) << std::endl;
+  check_eq( "next1", a.findNext(64), 95 ) << std::endl;
+  check_eq( "next2", a.findNext(95), 128 ) << std::endl;
+  check_eq( "next3", a.findNext(128), 130 ) << std::endl;
+  check_eq( "next4", a.findNext(130), a.sizeInBits() ) << std::endl;
+  check_eq( "last", a.findLast(), 130 ) << std::endl;
+  check_eq( "count", a.countOnes(), 4 ) << std::endl;
+
+  std::vector<unsigned int> seen;
+  for( unsigned int pos: a.setBits() ) {
+    seen.push_back( pos );
+  }
+  check_true( "range", seen == std::vector<unsigned int>{ 64, 95, 128, 130 } ) << std::endl;
+
+  _C x;
+  unsigned int seed = 2024;
+  for( int i = 0; i < 200; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    x.addBits( (i % 7) ? 0 : (seed & (seed >> 9)), (i < 199) ? 32 : 13 );
+  }
+  std::vector<unsigned int> expected;
+  for( unsigned int i = 0; i < x.sizeInBits(); ++i ) {
+    if( x.read(i,1) ) {
+      expected.push_back( i );
+    }
+  }
+  seen.clear();
+  for( unsigned int pos = x.findFirst(); pos < x.sizeInBits(); pos = x.findNext(pos) ) {
+    seen.push_back( pos );
+  }
+  check_true( "sparse.next", seen == expected ) << std::endl;
+  seen.assign( x.setBits().begin(), x.setBits().end() );
+  check_true( "sparse.range", seen == expected ) << std::endl;
+  check_eq( "sparse.count", x.countOnes(), expected.size() ) << std::endl;
+  check_eq( "sparse.last", x.findLast(), expected.back() ) << std::endl;
+}
+
+void hashTest() {
+  std::cout << "---- hashTest" << std::endl;
+  lxutil::dynamicbitstring<> d;
+  lxutil::staticbitstring<300> s;
+  lxutil::dynamicbitstring< std::vector<unsigned char> > bytes;
+  std::hash< lxutil::dynamicbitstring<> > dhash;
+  std::hash< lxutil::staticbitstring<300> > shash;
+  std::hash< lxutil::dynamicbitstring< std::vector<unsigned char> > > bhash;
+  check_eq( "empty", dhash(d), shash(s) ) << std::endl;
+
+  unsigned int seed = 5;
+  for( int i = 0; i < 7; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    d.addBits( seed, 29 );
+    s.addBits( seed, 29 );
+    for( int b = 28; b >= 0; b -= 4 ) {
+      unsigned int n = (b >= 3) ? 4 : (b + 1);
+      bytes.addBits( (unsigned char)( seed >> (b + 1 - n) ), n );
+    }
+    std::string name = "storage." + std::to_string(i);
+    check_eq( name, dhash(d), shash(s) ) << std::endl;
+    check_eq( name + ".bytes", dhash(d), bhash(bytes) ) << std::endl;
+  }
+
+  lxutil::dynamicbitstring<> longer(d);
+  longer.addBits( 0, 1 );
+  check_true( "length", dhash(d) != dhash(longer) ) << std::endl;
+
+  std::unordered_set< lxutil::dynamicbitstring<> > set;
+  lxutil::dynamicbitstring<> key;
+  for( unsigned int i = 0; i < 1000; ++i ) {
+    key.addBits( i & 1, 1 );
+    set.insert( key );
+  }
+  check_eq( "set.size", set.size(), 1000 ) << std::endl;
+  key.resize( 500 );
+  check_true( "set.find", set.count( key ) == 1 ) << std::endl;
+  key.addBits( 0, 32 );
+  check_true( "set.miss", set.count( key ) == 0 ) << std::endl;
+}
+
+template<typename _C> void critbitTest(const std::string &testname ) {
+  std::cout << "---- critbitTest: " << testname << std::endl;
+  lxutil::critbitmap<_C, unsigned int> tree;
+  std::map<_C, unsigned int> reference;
+
+  // short keys from a small alphabet: lots of prefixes and duplicates
+  unsigned int seed = 11;
+  for( unsigned int i = 0; i < 3000; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    _C key;
+    unsigned int len = (seed >> 8) % 40;
+    for( unsigned int b = 0; b < len; b += 8 ) {
+      unsigned int n = (len - b < 8) ? (len - b) : 8;
+      seed = seed * 1103515245 + 12345;
+      key.addBits( (seed >> 16) & ((1u << n) - 1) & 0x93, n );
+    }
+    bool added = tree.insert( key, i ).second;
+    check_eq( testname + ".added." + std::to_string(i), added,
+              reference.emplace( key, i ).second ) << std::endl;
+  }
+  check_eq( "size", tree.size(), reference.size() ) << std::endl;
+
+  bool inOrder = true;
+  auto r = reference.begin();
+  for( auto &kv: tree ) {
+    inOrder = inOrder && (r != reference.end()) && (kv.first == r->first) && (kv.second == r->second);
+    ++r;
+  }
+  check_true( "order", inOrder && (r == reference.end()) ) << std::endl;
+
+  // every third key out, and a few that are not there
+  unsigned int n = 0;
+  bool erased = true;
+  for( auto &kv: reference ) {
+    if( (n++ % 3) == 0 ) {
+      erased = erased && tree.erase( kv.first );
+    }
+  }
+  check_true( "erase", erased ) << std::endl;
+  _C missing;
+  for( int b = 0; b < 8; ++b ) {
+    missing.addBits( 0xFF, 8 );
+  }
+  check_false( "erase.missing", tree.erase( missing ) ) << std::endl;
+  n = 0;
+  for( auto it = reference.begin(); it != reference.end(); ) {
+    it = ((n++ % 3) == 0) ? reference.erase( it ) : std::next( it );
+  }
+  check_eq( "erase.size", tree.size(), reference.size() ) << std::endl;
+
+  bool found = true;
+  for( auto &kv: reference ) {
+    auto it = tree.find( kv.first );
+    found = found && (it != tree.end()) && (it->second == kv.second);
+  }
+  check_true( "find", found ) << std::endl;
+  check_false( "find.missing", tree.contains( missing ) ) << std::endl;
+
+  // prefix ranges against a scan of the reference
+  bool prefixOk = true;
+  for( unsigned int len = 0; len <= 12; ++len ) {
+    for( unsigned int v = 0; v < (1u << len) && v < 64; ++v ) {
+      _C prefix;
+      for( unsigned int b = len; b > 0; --b ) {
+        prefix.addBits( (v >> (b - 1)) & 1, 1 );
+      }
+      std::vector<unsigned int> expect;
+      for( auto &kv: reference ) {
+        bool match = kv.first.sizeInBits() >= len;
+        for( unsigned int b = 0; match && b < len; ++b ) {
+          match = ( kv.first.bitAt( b ) == ((v >> (len - 1 - b)) & 1) );
+        }
+        if( match ) {
+          expect.push_back( kv.second );
+        }
+      }
+      std::vector<unsigned int> got;
+      auto range = tree.prefixRange( prefix );
+      for( auto it = range.first; it != range.second; ++it ) {
+        got.push_back( it->second );
+      }
+      prefixOk = prefixOk && (got == expect);
+    }
+  }
+  check_true( "prefix", prefixOk ) << std::endl;
+
+  tree.clear();
+  check_true( "clear", tree.empty() && (tree.begin() == tree.end()) ) << std::endl;
+}
+
+void smallTest() {
+  std::cout << "---- smallTest" << std::endl;
+  using Small = lxutil::smalldynamicbitstring<128>;
+  Small a;
+  for( unsigned int i = 0; i < 4; ++i ) {
+    a.addBits( 0x80000001u + i, 32 );
+  }
+  check_eq( "inline.size", a.sizeInBits(), 128 ) << std::endl;
+  check_eq( "inline.capacity", a.capacityInBits(), 128 ) << std::endl;
+
+  Small copy( a );
+  Small moved( std::move( copy ) );
+  check_true( "inline.copy", moved == a ) << std::endl;
+  check_eq( "inline.moved_from", copy.sizeInBits(), 0 ) << std::endl;
+
+  // spill to the heap, then copies and moves keep everything
+  a.addBits( 5, 3 );
+  check_true( "spill.capacity", a.capacityInBits() > 128 ) << std::endl;
+  check_eq( "spill.first", a.read(0,32), 0x80000001u ) << std::endl;
+  check_eq( "spill.last", a.read(128,3), 5 ) << std::endl;
+  const unsigned int *blocks = a.data();
+  Small stolen( std::move( a ) );
+  check_true( "spill.move_steals", stolen.data() == blocks ) << std::endl;
+  check_eq( "spill.moved_from", a.sizeInBits(), 0 ) << std::endl;
+  a.addBits( 3, 2 );
+  check_eq( "spill.reuse", a.read(0,2), 3 ) << std::endl;
+
+  Small assigned;
+  assigned = stolen;
+  check_true( "assign.copy", assigned == stolen ) << std::endl;
+  moved = std::move( assigned );
+  check_true( "assign.move", moved == stolen ) << std::endl;
+  check_eq( "assign.moved_from", assigned.sizeInBits(), 0 ) << std::endl;
+
+  // same bits as a vector backed string
+  lxutil::dynamicbitstring<> d;
+  Small s;
+  for( unsigned int i = 0; i < 20; ++i ) {
+    d.addBits( i * 2654435761u, 1 + i );
+    s.addBits( i * 2654435761u, 1 + i );
+  }
+  bool same = (d.sizeInBits() == s.sizeInBits());
+  for( unsigned int i = 0; same && i < d.sizeInBits(); ++i ) {
+    same = (d.bitAt(i) == s.bitAt(i));
+  }
+  check_true( "like_vector", same ) << std::endl;
+}
+
+// counts what goes through it, on top of new/delete
+class countingresource : public std::pmr::memory_resource {
+public:
+  unsigned int allocations = 0;
+  unsigned int live = 0;
+private:
+  void *do_allocate( size_t bytes, size_t align ) override {
+    ++allocations;
+    ++live;
+    return std::pmr::new_delete_resource()->allocate( bytes, align );
+  }
+  void do_deallocate( void *p, size_t bytes, size_t align ) override {
+    --live;
+    std::pmr::new_delete_resource()->deallocate( p, bytes, align );
+  }
+  bool do_is_equal( const std::pmr::memory_resource &other ) const noexcept override {
+    return this == &other;
+  }
+};
+
+void pmrTest() {
+  std::cout << "---- pmrTest" << std::endl;
+  using Pmr = lxutil::pmr_dynamicbitstring<>;
+  countingresource one, two;
+  {
+    Pmr a( &one );
+    for( unsigned int i = 0; i < 10; ++i ) {
+      a.addBits( i, 32 );
+    }
+    check_true( "alloc.used", one.allocations > 0 ) << std::endl;
+    check_true( "alloc.resource", a.get_allocator().resource() == &one ) << std::endl;
+
+    Pmr copy( a, &two );
+    check_true( "copy.resource", copy.get_allocator().resource() == &two ) << std::endl;
+    check_true( "copy.value", copy == a ) << std::endl;
+    check_eq( "copy.live", two.live, 1 ) << std::endl;
+
+    // same resource: the blocks change hands, no allocation
+    unsigned int before = one.allocations;
+    Pmr moved( std::move( a ), &one );
+    check_eq( "move.same", one.allocations, before ) << std::endl;
+    check_true( "move.value", moved == copy ) << std::endl;
+    check_eq( "move.moved_from", a.sizeInBits(), 0 ) << std::endl;
+
+    // different resource: copied over, the source left empty
+    Pmr across( std::move( moved ), &two );
+    check_true( "move.across.value", across == copy ) << std::endl;
+    check_eq( "move.across.moved_from", moved.sizeInBits(), 0 ) << std::endl;
+    moved.addBits( 1, 1 );
+    check_eq( "move.across.reuse", moved.read(0,1), 1 ) << std::endl;
+
+    // a pmr container hands its resource to the bitstrings in it
+    std::pmr::vector<Pmr> many( &two );
+    many.emplace_back();
+    many.push_back( copy );
+    check_true( "container.resource", many[0].get_allocator().resource() == &two &&
+                                      many[1].get_allocator().resource() == &two ) << std::endl;
+    check_true( "container.value", many[1] == copy ) << std::endl;
+  }
+  check_eq( "released.one", one.live, 0 ) << std::endl;
+  check_eq( "released.two", two.live, 0 ) << std::endl;
+}
+
+// 64 and 128 bit blocks against the usual 32 bit ones
+template<typename _C> void wideTest(const std::string &testname ) {
+  std::cout << "---- wideTest: " << testname << std::endl;
+  using Narrow = lxutil::dynamicbitstring<>;
+  _C w;
+  Narrow n;
+  unsigned int seed = 77;
+  for( unsigned int i = 0; i < 200; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    unsigned int nBits = 1 + (seed >> 27);
+    w.addBits( seed, nBits );
+    n.addBits( seed, nBits );
+  }
+  check_eq( testname + ".size", w.sizeInBits(), n.sizeInBits() ) << std::endl;
+
+  // reads up to 64 bits at any offset
+  bool reads = true;
+  for( unsigned int pos = 0; pos + 64 <= n.sizeInBits(); pos += 13 ) {
+    for( unsigned int len = 1; len <= 64; len += 7 ) {
+      reads = reads && ( uint64_t( w.read( pos, len ) ) == n.read( pos, len ) );
+    }
+  }
+  check_true( testname + ".read", reads ) << std::endl;
+
+  // 64 bit writes, including across block boundaries
+  bool writes = true;
+  uint64_t value = 0x8123456789ABCDEFull;
+  for( unsigned int pos = 0; pos + 64 <= n.sizeInBits(); pos += 29 ) {
+    unsigned int len = 33 + (pos % 32);
+    w.write( value, pos, len );
+    n.write( value, pos, len );
+    uint64_t mask = ( len == 64 ) ? ~0ull : ((1ull << len) - 1);
+    writes = writes && ( uint64_t( w.read( pos, len ) ) == (value & mask) ) &&
+             ( n.read( pos, len ) == (value & mask) );
+    value = value * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  bool same = true;
+  for( unsigned int i = 0; same && i < n.sizeInBits(); ++i ) {
+    same = ( w.bitAt( i ) == n.bitAt( i ) );
+  }
+  check_true( testname + ".write", writes && same ) << std::endl;
+
+  // a full 64 bit write past the end grows the string
+  _C grow;
+  grow.write( ~0ull, 10, 64 );
+  check_eq( testname + ".write_grow.size", grow.sizeInBits(), 74 ) << std::endl;
+  check_eq( testname + ".write_grow.val", uint64_t( grow.read( 10, 64 ) ), ~0ull ) << std::endl;
+
+  // counting and hashing agree with the narrow blocks
+  check_eq( testname + ".count", w.countOnes(), n.countOnes() ) << std::endl;
+  check_eq( testname + ".last", w.findLast(), n.findLast() ) << std::endl;
+  check_eq( testname + ".hash", std::hash<_C>()( w ), std::hash<Narrow>()( n ) ) << std::endl;
+  for( unsigned int cut = n.sizeInBits(); cut > 0; cut -= 37 ) {
+    w.resize( cut );
+    n.resize( cut );
+    if( std::hash<_C>()( w ) != std::hash<Narrow>()( n ) ) {
+      check_true( testname + ".hash.cut." + std::to_string(cut), false ) << std::endl;
+    }
+    if( cut < 37 ) {
+      break;
+    }
+  }
+}
+
+template<typename _C> void viewTest(const std::string &testname ) {
+  std::cout << "---- viewTest: " << testname << std::endl;
+  using View = lxutil::bitstring_view<typename _C::BlockType>;
+  _C a;
+  unsigned int seed = 3;
+  for( unsigned int i = 0; i < 60; ++i ) {
+    seed = seed * 1103515245 + 12345;
+    a.addBits( seed >> 24, 1 + (seed % 8) );
+  }
+  View v( a );
+  check_eq( "size", v.sizeInBits(), a.sizeInBits() ) << std::endl;
+  bool reads = true;
+  for( unsigned int pos = 0; pos < a.sizeInBits(); pos += 5 ) {
+    for( unsigned int len = 1; len <= 64 && pos + len <= a.sizeInBits(); len += 9 ) {
+      reads = reads && ( uint64_t( v.read( pos, len ) ) == uint64_t( a.read( pos, len ) ) );
+    }
+  }
+  check_true( "read", reads ) << std::endl;
+  check_eq( "count", v.countOnes(), a.countOnes() ) << std::endl;
+
+  // same order as bitstring, either side a view
+  _C b( a );
+  check_true( "eq", (v == b) && (b == v) && (v == View( b )) ) << std::endl;
+  b.addBits( 0, 1 );
+  check_true( "prefix", (v < b) && (b > v) && !(v == b) ) << std::endl;
+  b = a;
+  b.write( b.read( 10, 1 ) ^ 1, 10, 1 );
+  check_eq( "order", View( b ) < v, b < a ) << std::endl;
+  check_eq( "order.rev", v < View( b ), a < b ) << std::endl;
+
+  // a copy, and appending from a view
+  _C copy( v );
+  check_true( "copy", copy == a ) << std::endl;
+  _C twice( a );
+  twice.append( v );
+  _C expect( a );
+  expect.append( a );
+  check_true( "append", twice == expect ) << std::endl;
+  _C self( a );
+  self.shrink_to_fit(); // so appending has to move the blocks
+  self.append( View( self ) );
+  check_true( "append.self", self == expect ) << std::endl;
+  _C selfPiece( a );
+  selfPiece.shrink_to_fit();
+  selfPiece.append( View( selfPiece ), 7, 50 );
+  _C selfPieceExpect( a );
+  selfPieceExpect.append( a, 7, 50 );
+  check_true( "append.self.piece", selfPiece == selfPieceExpect ) << std::endl;
+  _C piece;
+  piece.addBits( 1, 3 );
+  piece.append( v, 7, 50 );
+  _C pieceExpect;
+  pieceExpect.addBits( 1, 3 );
+  pieceExpect.append( a, 7, 50 );
+  check_true( "append.piece", piece == pieceExpect ) << std::endl;
+
+  // logical ops into a bitstring
+  _C d( b );
+  _C e( b );
+  d ^= v;
+  e ^= a;
+  check_true( "xor", d == e ) << std::endl;
+  d |= v;
+  e |= a;
+  d.andNot( View( b ) );
+  e.andNot( b );
+  check_true( "or.andNot", d == e ) << std::endl;
+}
+
+void streamViewTest() {
+  std::cout << "---- streamViewTest" << std::endl;
+  // 20 bits as they come off the wire: the last byte left aligned
+  const unsigned char wire[] = { 0xAB, 0xCD, 0xE7 };
+  auto v = lxutil::bitstring_view<unsigned char>::fromStream( wire, 20 );
+  check_eq( "size", v.sizeInBits(), 20 ) << std::endl;
+  check_eq( "read", v.read( 0, 20 ), 0xABCDE ) << std::endl;
+  check_eq( "read.tail", v.read( 14, 6 ), 0x1E ) << std::endl;
+  lxutil::dynamicbitstring< std::vector<unsigned char> > d;
+  d.addBits( 0xAB, 8 );
+  d.addBits( 0xCD, 8 );
+  d.addBits( 0xE, 4 );
+  check_true( "same", v == d ) << std::endl;
+  lxutil::dynamicbitstring< std::vector<unsigned char> > copy( v );
+  check_true( "copy", copy == d ) << std::endl;
+
+  // the canonical layout is just the blocks of a bitstring
+  lxutil::bitstring_view<unsigned char> canonical( std::span<const unsigned char>( d.data(), d.sizeInBlocks() ), 20 );
+  check_true( "canonical", canonical == v ) << std::endl;
+
+  // more bits than the blocks hold: cut to the blocks
+  auto over = lxutil::bitstring_view<unsigned char>::fromStream( wire, 100 );
+  check_eq( "over.stream", over.sizeInBits(), 24 ) << std::endl;
+  check_eq( "over.stream.read", over.read( 0, 24 ), 0xABCDE7 ) << std::endl;
+  lxutil::bitstring_view<unsigned char> overCanonical( std::span<const unsigned char>( wire, 2 ), 20 );
+  check_eq( "over.canonical", overCanonical.sizeInBits(), 16 ) << std::endl;
+}
+
+template<typename _C> void serialTest(const std::string &testname ) {
+  std::cout << "---- serialTest: " << testname << std::endl;
+  using Narrow = lxutil::dynamicbitstring<>;
+  bool roundTrip = true;
+  bool crossWidth = true;
+  unsigned int seed = 19;
+  std::vector<unsigned char> all;
+  for( unsigned int len = 0; len < 300; len += 7 ) {
+    Narrow n;
+    for( unsigned int i = 0; i < len; ++i ) {
+      seed = seed * 1103515245 + 12345;
+      n.addBits( seed >> 31, 1 );
+    }
+    std::vector<unsigned char> bytes;
+    lxutil::serialize( n, bytes );
+    all.insert( all.end(), bytes.begin(), bytes.end() );
+    roundTrip = roundTrip && ( bytes.size() == lxutil::serializedSize( n ) );
+
+    _C c;
+    size_t used = lxutil::deserialize( c, std::span<const unsigned char>( bytes ) );
+    roundTrip = roundTrip && ( used == bytes.size() ) && ( c.sizeInBits() == len );
+    for( unsigned int i = 0; crossWidth && i < len; ++i ) {
+      crossWidth = ( c.bitAt( i ) == n.bitAt( i ) );
+    }
+    std::vector<unsigned char> again;
+    lxutil::serialize( c, again );
+    roundTrip = roundTrip && ( again == bytes );
+  }
+  check_true( "roundtrip", roundTrip ) << std::endl;
+  check_true( "cross_width", crossWidth ) << std::endl;
+
+  // one after the other, through a stream
+  std::stringstream stream;
+  stream.write( reinterpret_cast<const char *>( all.data() ), all.size() );
+  unsigned int count = 0;
+  _C c;
+  while( lxutil::deserialize( c, stream ) ) {
+    ++count;
+  }
+  check_eq( "stream.count", count, 43 ) << std::endl;
+}
+
+void serialFormatTest() {
+  std::cout << "---- serialFormatTest" << std::endl;
+  lxutil::dynamicbitstring<> a;
+  a.addBits( 0xABC, 12 );
+  a.addBits( 1, 1 );
+  std::vector<unsigned char> bytes;
+  lxutil::serialize( a, bytes );
+  std::vector<unsigned char> expect { 13, 0, 0, 0, 0xAB, 0xC8 };
+  check_true( "layout", bytes == expect ) << std::endl;
+
+  lxutil::dynamicbitstring<> b;
+  check_eq( "short", lxutil::deserialize( b, std::span<const unsigned char>( bytes.data(), 5 ) ), 0 ) << std::endl;
+  lxutil::staticbitstring<8> tiny; // room for a few blocks
+  lxutil::dynamicbitstring<> big;
+  big.resize( 1000 );
+  std::vector<unsigned char> bigBytes;
+  lxutil::serialize( big, bigBytes );
+  check_eq( "no_room", lxutil::deserialize( tiny, std::span<const unsigned char>( bigBytes ) ), 0 ) << std::endl;
+  unsigned char small[5];
+  check_eq( "out_small", lxutil::serialize( a, std::span<unsigned char>( small ) ), 0 ) << std::endl;
+
+  // a pack: views in place, loads into any width
+  lxutil::packwriter writer;
+  std::vector< lxutil::dynamicbitstring<> > keys( 50 );
+  for( unsigned int i = 0; i < keys.size(); ++i ) {
+    for( unsigned int j = 0; j < i; ++j ) {
+      keys[i].addBits( i * 7 + j, 5 );
+    }
+    writer.add( keys[i] );
+  }
+  std::vector<unsigned char> pack;
+  writer.writeTo( pack );
+  lxutil::packreader reader;
+  check_true( "pack.open", reader.open( pack ) ) << std::endl;
+  check_eq( "pack.count", reader.count(), keys.size() ) << std::endl;
+  bool views = true;
+  bool loads = true;
+  for( unsigned int i = 0; i < keys.size(); ++i ) {
+    auto view = reader.view( i );
+    views = views && ( view.sizeInBits() == keys[i].sizeInBits() );
+    for( unsigned int b = 0; views && b < keys[i].sizeInBits(); ++b ) {
+      views = ( view.bitAt( b ) == keys[i].bitAt( b ) );
+    }
+    lxutil::dynamicbitstring< std::vector<unsigned char> > bytesKey;
+    views = views && reader.load( i, bytesKey ) && ( reader.view( i ) == bytesKey );
+    lxutil::dynamicbitstring< std::vector<uint64_t> > wideKey;
+    loads = loads && reader.load( i, wideKey ) && ( wideKey.sizeInBits() == keys[i].sizeInBits() );
+    for( unsigned int b = 0; loads && b < keys[i].sizeInBits(); ++b ) {
+      loads = ( wideKey.bitAt( b ) == keys[i].bitAt( b ) );
+    }
+  }
+  check_true( "pack.view", views ) << std::endl;
+  check_true( "pack.load", loads ) << std::endl;
+
+  std::vector<unsigned char> damaged( pack.begin(), pack.end() - 1 );
+  check_false( "pack.damaged", reader.open( damaged ) ) << std::endl;
+  damaged.assign( pack.begin(), pack.begin() + 10 );
+  check_false( "pack.header", reader.open( damaged ) ) << std::endl;
+}
+
+void mappedTest() {
+  std::cout << "---- mappedTest" << std::endl;
+  std::string path = "/tmp/bitsringtest." + std::to_string( getpid() ) + ".lxbm";
+  auto pattern = []( unsigned int i ) {
+    return ( (i * 2654435761u) >> 7 ) & 1;
+  };
+  {
+    lxutil::mappedbitstring<> m;
+    check_true( "create", m.create( path.c_str() ) ) << std::endl;
+    check_true( "file", m.fileBacked() ) << std::endl;
+    for( unsigned int i = 0; i < 100000; ++i ) { // a few pages
+      m.addBits( pattern( i ), 1 );
+    }
+    check_true( "flush", m.flush() ) << std::endl;
+  }
+
+  lxutil::mappedview<> reader;
+  check_true( "view.open", reader.open( path.c_str() ) ) << std::endl;
+  check_eq( "view.size", reader.sizeInBits(), 100000 ) << std::endl;
+  bool same = true;
+  auto v = reader.view();
+  for( unsigned int i = 0; same && i < 100000; ++i ) {
+    same = ( v.bitAt( i ) == bool( pattern( i ) ) );
+  }
+  check_true( "view.bits", same ) << std::endl;
+  reader.close();
+
+  {
+    // the length comes back from the header, more goes on the end
+    lxutil::mappedbitstring<> m;
+    check_true( "reopen", m.open( path.c_str() ) ) << std::endl;
+    check_eq( "reopen.size", m.sizeInBits(), 100000 ) << std::endl;
+    check_eq( "reopen.ones", m.countOnes(), v.countOnes() ) << std::endl;
+    m.addBits( 0x2A, 6 );
+  } // the destructor records the length
+  check_true( "view.reopen", reader.open( path.c_str() ) ) << std::endl;
+  check_eq( "view.grown", reader.sizeInBits(), 100006 ) << std::endl;
+  check_eq( "view.tail", reader.view().read( 100000, 6 ), 0x2Au ) << std::endl;
+
+  lxutil::mappedview<unsigned int> narrow;
+  check_false( "wrong_width", narrow.open( path.c_str() ) ) << std::endl;
+  check_false( "missing", narrow.open( "/nonexistent/bitsringtest.lxbm" ) ) << std::endl;
+  unlink( path.c_str() );
+
+  // no file: an anonymous mapping
+  lxutil::mappedbitstring<unsigned char> anon;
+  for( unsigned int i = 0; i < 3000; ++i ) {
+    anon.addBits( 0xBC, 8 );
+  }
+  check_false( "anon.file", anon.fileBacked() ) << std::endl;
+  check_eq( "anon.read", anon.read( 23984, 16 ), 0xBCBCu ) << std::endl;
+}
+
+template<typename _BlockType> void atomicTest(const std::string &testname ) {
+  std::cout << "---- atomicTest: " << testname << std::endl;
+  const unsigned int nBits = 10007; // a partial last block
+  lxutil::atomic_bitstring<_BlockType> a( nBits );
+  check_eq( "empty", a.countOnes(), 0 ) << std::endl;
+
+  // threads race for every bit: each is won exactly once
+  const unsigned int nThreads = 4;
+  std::vector<unsigned int> won( nThreads, 0 );
+  std::vector<std::thread> pool;
+  for( unsigned int t = 0; t < nThreads; ++t ) {
+    pool.emplace_back( [&a, &won, t, nBits]() {
+      for( unsigned int i = 0; i < nBits; ++i ) {
+        unsigned int pos = (i * 7 + t * 13) % nBits;
+        if( !a.testAndSet( pos ) ) {
+          ++won[t];
+        }
+      }
+    } );
+  }
+  for( auto &th: pool ) {
+    th.join();
+  }
+  unsigned int total = 0;
+  for( auto w: won ) {
+    total += w;
+  }
+  check_eq( "race.won", total, nBits ) << std::endl;
+  check_eq( "race.ones", a.countOnes(), nBits ) << std::endl;
+
+  // the same layout as bitstring
+  a.clear();
+  lxutil::dynamicbitstring< std::vector<_BlockType> > expect;
+  expect.resize( nBits );
+  for( unsigned int pos = 0; pos < nBits; pos += 3 ) {
+    a.setBit( pos );
+    expect.write( 1, pos, 1 );
+  }
+  a.clearBit( 9999 );
+  expect.write( 0, 9999, 1 );
+  check_true( "snapshot", a.snapshot() == expect ) << std::endl;
+  check_true( "test", a.testBit( 10005 ) && !a.testBit( 10006 ) && !a.testBit( 9999 ) ) << std::endl;
+  check_false( "testAndClear", a.testAndClear( 10004 ) ) << std::endl;
+  check_true( "testAndClear.set", a.testAndClear( 10005 ) ) << std::endl;
+
+  // ranges across blocks, and into the partial last one
+  a.clear();
+  uint64_t was = a.fetchOr( 60, 0xF0F0F0F0F, 36 );
+  check_eq( "fetchOr.was", was, 0u ) << std::endl;
+  was = a.fetchOr( 56, 0xFFFF, 16 );
+  check_eq( "fetchOr.old", was, 0x0F0Fu ) << std::endl;
+  a.setRange( 9900, 107 );
+  lxutil::staticbitstring<10240, std::array<_BlockType, 10240 / (sizeof(_BlockType) * 8)> > fixed;
+  check_true( "snapshotTo", a.snapshotTo( fixed ) ) << std::endl;
+  check_eq( "snapshotTo.size", fixed.sizeInBits(), nBits ) << std::endl;
+  check_eq( "snapshotTo.read", fixed.read( 56, 40 ), 0xFFFF0F0F0Fu ) << std::endl;
+  check_eq( "setRange", fixed.countOnes(), 16 + 4 * 3 + 107 ) << std::endl;
+  check_true( "setRange.last", fixed.bitAt( nBits - 1 ) && !fixed.bitAt( 9899 ) ) << std::endl;
+  a.clearRange( 9901, 105 );
+  check_eq( "clearRange", a.countOnes(), 16 + 4 * 3 + 2 ) << std::endl;
+
+  // ranges running past the end stop there
+  lxutil::atomic_bitstring<_BlockType> shortOne( 64 );
+  shortOne.setRange( 60, 10 );
+  check_eq( "end.setRange", shortOne.countOnes(), 4 ) << std::endl;
+  shortOne.setRange( 64, 10 );
+  shortOne.clearRange( 62, 100 );
+  check_eq( "end.clearRange", shortOne.countOnes(), 2 ) << std::endl;
+  was = shortOne.fetchOr( 56, 0xABCD, 16 ); // 0xAB fits, 0xCD would be past the end
+  check_eq( "end.fetchOr.was", was, 0x0Cu ) << std::endl;
+  check_true( "end.fetchOr", shortOne.testBit( 56 ) && !shortOne.testBit( 57 ) && shortOne.testBit( 63 ) ) << std::endl;
+  check_eq( "end.fetchOr.past", shortOne.fetchOr( 64, 0xFF, 8 ), 0u ) << std::endl;
+  check_eq( "end.ones", shortOne.countOnes(), 6 ) << std::endl; // 0x0C | 0xAB
+}
+
+template<typename _C, typename _Array> void cursorTest(const std::string &testname, const _Array &test1 ) {
+  std::cout << "---- cursorTest: " << testname << std::endl;
+  _C a;
+  {
+    typename _C::writer w(a);
+    for( int rep = 0; rep < 3; ++rep ) {
+      for( auto &oneTest: test1 ) {
+        w.writeBits( oneTest[0], oneTest[1] );
+      }
+    }
+    w.writeBits( 0xa000b000, 32 );
+  }
+  _C b;
+  for( int rep = 0; rep < 3; ++rep ) {
+    for( auto &oneTest: test1 ) {
+      b.addBits( oneTest[0], oneTest[1] );
+    }
+  }
+  b.addBits( 0xa000b000, 32 );
+  check_true( "writer.eq", a == b ) << std::endl;
+
+  typename _C::reader r(a);
+  for( int rep = 0; rep < 3; ++rep ) {
+    for( auto &oneTest: test1 ) {
+      check_eq( (std::stringstream() << "reader." << oneTest[0]).str(),
+                r.readBits( oneTest[1] ), oneTest[0] ) << std::endl;
+    }
+  }
+  check_eq( "reader.peek", r.peek(16), 0xa000 ) << std::endl;
+  check_eq( "reader.remaining", r.remaining(), 32 ) << std::endl;
+  r.consume( 16 );
+  check_eq( "reader.last", r.readBits(16), 0xb000 ) << std::endl;
+  check_true( "reader.end", r.atEnd() ) << std::endl;
+  check_eq( "reader.past", r.readBits(8), 0 ) << std::endl;
+
+  r.seek( 7 );
+  check_eq( "reader.seek", r.readBits(8), 234 ) << std::endl;
+  r.consume( 14 + 5 + 20 + 2 + 7 );
+  check_eq( "reader.skip", r.readBits(8), 234 ) << std::endl;
+  check_eq( "reader.pos", r.position(), 56 + 15 ) << std::endl;
+}
+
+// runs the tasks in order on the caller's thread
+struct inlineExecutor {
+  unsigned int tasks = 0;
+  unsigned int concurrency() const {
+    return 3;
+  }
+  template<typename _Fn> void run( unsigned int nTasks, _Fn &&fn ) {
+    for( unsigned int t = 0; t < nTasks; ++t ) {
+      fn( t );
+    }
+    tasks += nTasks;
+  }
+};
+
+template<typename _C> void parallelTest(const std::string &testname ) {
+  std::cout << "---- parallelTest: " << testname << std::endl;
+  size_t threshold = lxutil::parallel::threshold();
+  lxutil::parallel::setThreshold( 0 ); // threads for anything
+  lxutil::parallel::threadpool pool( 4 );
+  check_eq( "concurrency", pool.concurrency(), 4 ) << std::endl;
+
+  // rounds back to back, of different sizes: every task runs once, in its round
+  bool once = true;
+  for( unsigned int r = 0; r < 2000; ++r ) {
+    std::vector<std::atomic<unsigned int> > ran( 2 + r % 7 );
+    pool.run( (unsigned int)ran.size(), [&]( unsigned int t ) { ran[t].fetch_add( 1 ); } );
+    for( auto &n: ran ) {
+      once = once && (n.load() == 1);
+    }
+  }
+  check_true( "rounds", once ) << std::endl;
+
+  // lengths off the block and cache line boundaries
+  auto pattern = []( unsigned int nBits, unsigned int seed ) {
+    _C c;
+    for( unsigned int i = 0; i < nBits; i += 8 ) {
+      seed = seed * 1103515245 + 12345;
+      c.addBits( (seed >> 16) & 0xFF, ( nBits - i < 8 ) ? (nBits - i) : 8 );
+    }
+    return c;
+  };
+  _C a = pattern( 70001, 1 );
+  _C b = pattern( 70001, 2 );
+  _C shorter = pattern( 30011, 3 );
+
+  _C serial = a;
+  _C par = a;
+  serial &= b;
+  lxutil::parallel::andWith( par, b, pool );
+  check_true( "and", par == serial ) << std::endl;
+  serial |= shorter;
+  lxutil::parallel::orWith( par, shorter, pool );
+  check_true( "or.shorter", par == serial ) << std::endl;
+  serial ^= b;
+  lxutil::parallel::xorWith( par, b, pool );
+  check_true( "xor", par == serial ) << std::endl;
+  serial.andNot( a );
+  lxutil::parallel::andNot( par, a, pool );
+  check_true( "andNot", par == serial ) << std::endl;
+  lxutil::parallel::orWith( par, lxutil::bitstring_view<typename _C::BlockType>( b ) );
+  serial |= b;
+  check_true( "or.view", par == serial ) << std::endl;
+  check_eq( "countOnes", lxutil::parallel::countOnes( par, pool ), serial.countOnes() ) << std::endl;
+
+  // several differences: the first one wins, wherever its chunk runs
+  _C c = a;
+  check_eq( "prefix.same", lxutil::parallel::commonPrefixLength( a, c, pool ), 70001 ) << std::endl;
+  check_true( "compare.same", lxutil::parallel::compare( a, c, pool ) == 0 ) << std::endl;
+  for( unsigned int pos: { 69000u, 41234u, 20001u, 5003u } ) {
+    c.write( a.bitAt( pos ) ? 0 : 1, pos, 1 );
+    check_eq( "prefix", lxutil::parallel::commonPrefixLength( a, c, pool ), pos ) << std::endl;
+    check_true( "compare", lxutil::parallel::compare( a, c, pool ) == (a <=> c) ) << std::endl;
+  }
+  c = a;
+  c.write( a.bitAt( 70000 ) ? 0 : 1, 70000, 1 );
+  check_eq( "prefix.last", lxutil::parallel::commonPrefixLength( a, c, pool ), 70000 ) << std::endl;
+  _C head = a;
+  head.resize( 40000 );
+  check_eq( "prefix.head", lxutil::parallel::commonPrefixLength( a, head, pool ), 40000 ) << std::endl;
+  check_true( "compare.head", lxutil::parallel::compare( head, a, pool ) < 0 ) << std::endl;
+  check_eq( "prefix.other", lxutil::parallel::commonPrefixLength( a, shorter, pool ),
+            lxutil::commonPrefixLength( a, shorter ) ) << std::endl;
+
+  // the same bytes as serialize(), and back
+  std::vector<unsigned char> expect;
+  lxutil::serialize( a, expect );
+  std::vector<unsigned char> bytes( lxutil::serializedSize( a ) );
+  check_eq( "serialize", lxutil::parallel::serialize( a, std::span<unsigned char>( bytes ), pool ),
+            bytes.size() ) << std::endl;
+  check_true( "serialize.bytes", bytes == expect ) << std::endl;
+  _C back;
+  check_eq( "deserialize", lxutil::parallel::deserialize( back, std::span<const unsigned char>( bytes ), pool ),
+            bytes.size() ) << std::endl;
+  check_true( "deserialize.same", back == a ) << std::endl;
+
+  // any executor will do
+  inlineExecutor inl;
+  par = a;
+  lxutil::parallel::xorWith( par, b, inl );
+  check_true( "executor", (par == (a ^ b)) && (inl.tasks > 1) ) << std::endl;
+
+  // under the threshold: the serial code, no tasks
+  lxutil::parallel::setThreshold( threshold );
+  inl.tasks = 0;
+  lxutil::parallel::andWith( par, b, inl );
+  check_eq( "threshold", inl.tasks, 0 ) << std::endl;
+}
+
+template<typename _C> void compressedTest(const std::string &testname ) {
+  std::cout << "---- compressedTest: " << testname << std::endl;
+  using Kind = lxutil::compresseddetail::Kind;
+  // over several chunks, the last one partial: sparse ones, a dense
+  // stretch and runs, so every kind of container turns up
+  auto pattern = []( unsigned int nBits, unsigned int seed ) {
+    _C c;
+    c.resize( nBits );
+    for( unsigned int i = 0; i < 300; ++i ) {
+      seed = seed * 1103515245 + 12345;
+      c.write( 1, (seed >> 4) % nBits, 1 );
+    }
+    for( unsigned int pos = 70000; pos < 120000 && pos < nBits; ++pos ) {
+      seed = seed * 1103515245 + 12345;
+      c.write( (seed >> 16) & 1, pos, 1 );
+    }
+    for( unsigned int pos = 140000 + seed % 50; pos + 20 < nBits; pos += 997 ) {
+      c.write( 0xFFFFF, pos, 20 );
+    }
+    return c;
+  };
+  _C a = pattern( 300001, 1 );
+  _C b = pattern( 300001, 2 );
+  _C shorter = pattern( 150013, 3 );
+
+  lxutil::compressedbitmap ca( a );
+  lxutil::compressedbitmap cb( b );
+  lxutil::compressedbitmap cs( shorter );
+  check_eq( "size", ca.sizeInBits(), a.sizeInBits() ) << std::endl;
+  check_eq( "countOnes", ca.countOnes(), a.countOnes() ) << std::endl;
+  check_true( "kinds", (ca.containerCount( Kind::Array ) > 0) && (ca.containerCount( Kind::Bitmap ) > 0) &&
+                       (ca.containerCount( Kind::Run ) > 0) ) << std::endl;
+  _C back;
+  check_true( "toBits", ca.toBits( back ) && (back == a) ) << std::endl;
+  bool same = true;
+  for( unsigned int pos = 0; pos < a.sizeInBits(); pos += 7 ) {
+    same = same && (ca.bitAt( pos ) == a.bitAt( pos ));
+  }
+  check_true( "bitAt", same ) << std::endl;
+  unsigned int seen = 0;
+  bool inOrder = true;
+  unsigned int last = 0;
+  ca.forEachOne( [&]( unsigned int pos ) {
+    inOrder = inOrder && a.bitAt( pos ) && (seen == 0 || pos > last);
+    last = pos;
+    ++seen;
+  } );
+  check_true( "forEachOne", inOrder && (seen == a.countOnes()) ) << std::endl;
+
+  // the operations match bitstring's, lengths and all
+  auto matches = []( const lxutil::compressedbitmap &c, const _C &expect ) {
+    _C got;
+    return c.toBits( got ) && (got == expect) && (c.countOnes() == expect.countOnes());
+  };
+  check_true( "and", matches( ca & cb, a & b ) ) << std::endl;
+  check_true( "or", matches( ca | cb, a | b ) ) << std::endl;
+  check_true( "xor", matches( ca ^ cb, a ^ b ) ) << std::endl;
+  check_true( "andNot", matches( lxutil::compressedbitmap( ca ).andNot( cb ), _C( a ).andNot( b ) ) ) << std::endl;
+  check_true( "and.shorter", matches( ca & cs, a & shorter ) ) << std::endl;
+  check_true( "or.shorter", matches( ca | cs, a | shorter ) ) << std::endl;
+  check_true( "and.longer", matches( cs & ca, shorter & a ) ) << std::endl;
+  check_true( "xor.longer", matches( cs ^ ca, shorter ^ a ) ) << std::endl;
+  check_true( "andNot.longer", matches( lxutil::compressedbitmap( cs ).andNot( ca ), _C( shorter ).andNot( a ) ) ) << std::endl;
+  check_true( "xor.self", (ca ^ ca).countOnes() == 0 ) << std::endl;
+  check_true( "equal", (lxutil::compressedbitmap( a ) == ca) && (ca != cb) ) << std::endl;
+
+  // bit by bit, through every kind of container
+  lxutil::compressedbitmap grown;
+  std::vector<bool> expect( 200000 );
+  for( unsigned int pos = 0; pos < 200000; pos += ( pos < 70000 ) ? 13 : (( pos < 140000 ) ? 1 : 3) ) {
+    grown.setBit( pos );
+    expect[pos] = true;
+  }
+  for( unsigned int pos = 0; pos < 200000; pos += 5 ) {
+    grown.clearBit( pos );
+    expect[pos] = false;
+  }
+  bool right = true;
+  for( unsigned int pos = 0; pos < 200000; ++pos ) {
+    right = right && (grown.bitAt( pos ) == expect[pos]);
+  }
+  check_true( "setBit", right ) << std::endl;
+  _C grownBits;
+  check_true( "setBit.same", grown.toBits( grownBits ) && (lxutil::compressedbitmap( grownBits ) == grown) ) << std::endl;
+
+  // resize drops the bits past the end
+  lxutil::compressedbitmap cut( a );
+  cut.resize( 100003 );
+  _C acut = a;
+  acut.resize( 100003 );
+  check_true( "resize", matches( cut, acut ) ) << std::endl;
+  cut.resize( 300001 );
+  acut.resize( 300001 );
+  check_true( "resize.grow", matches( cut, acut ) ) << std::endl;
+
+  // a sparse bitmap takes little room
+  lxutil::compressedbitmap sparse;
+  for( unsigned int i = 0; i < 1000; ++i ) {
+    sparse.setBit( i * 4000037u );
+  }
+  check_eq( "sparse.ones", sparse.countOnes(), 1000 ) << std::endl;
+  check_true( "sparse.bytes", sparse.bytesUsed() < 100000 ) << std::endl;
+}
+
+template<typename _C> void exprTest(const std::string &testname ) {
+  std::cout << "---- exprTest: " << testname << std::endl;
+  using lxutil::lazy;
+  auto pattern = []( unsigned int nBits, unsigned int seed ) {
+    _C c;
+    for( unsigned int i = 0; i < nBits; i += 8 ) {
+      seed = seed * 1103515245 + 12345;
+      c.addBits( (seed >> 16) & 0xFF, ( nBits - i < 8 ) ? (nBits - i) : 8 );
+    }
+    return c;
+  };
+  // equal lengths, then every side shorter or longer than the others
+  const unsigned int lengths[][4] = { { 4096, 4096, 4096, 4096 }, { 1001, 1001, 1001, 1001 },
+                                      { 1000, 700, 1300, 37 }, { 300, 2000, 5, 999 }, { 0, 64, 65, 63 } };
+  for( auto &l: lengths ) {
+    std::string n = std::to_string( l[0] ) + "/" + std::to_string( l[1] ) + "/" +
+                    std::to_string( l[2] ) + "/" + std::to_string( l[3] );
+    _C a = pattern( l[0], 1 );
+    _C b = pattern( l[1], 2 );
+    _C c = pattern( l[2], 3 );
+    _C d = pattern( l[3], 4 );
+    _C expect = (a & b) | (c & ~d);
+    _C r = (lazy( a ) & b) | (lazy( c ) & ~lazy( d ));
+    check_true( "fused." + n, r == expect ) << std::endl;
+    check_eq( "countOnes." + n, ((lazy( a ) & b) | (lazy( c ) & ~lazy( d ))).countOnes(), expect.countOnes() ) << std::endl;
+    check_eq( "any." + n, (lazy( a ) & b & c).any(), (a & b & c).countOnes() > 0 ) << std::endl;
+    r = lxutil::andNot( lazy( a ) ^ c, d ) | b;
+    check_true( "andNot." + n, r == ((a ^ c).andNot( d ) | b) ) << std::endl;
+    r = ~(lazy( b ) ^ lxutil::bitstring_view<typename _C::BlockType>( c ));
+    check_true( "view." + n, r == ~(b ^ c) ) << std::endl;
+    // the result as an operand, in place or growing
+    r = a;
+    r = lazy( r ) & b;
+    check_true( "alias." + n, r == (a & b) ) << std::endl;
+    r = d;
+    r = lazy( c ) | r;
+    check_true( "alias.grow." + n, r == (c | d) ) << std::endl;
+  }
+
+  // a static result too small for the expression
+  _C big = pattern( 2000, 5 );
+  lxutil::staticbitstring<512, std::array<typename _C::BlockType, 4> > small;
+  check_false( "static.small", (lazy( big ) | big).evaluateInto( small ) ) << std::endl;
+}
+
+// growth policies, with a counting tag per run so the counts start at zero
+template<typename _Storage> void growthTest(const std::string &testname ) {
+  std::cout << "---- growthTest: " << testname << std::endl;
+  struct exactTag {};
+  struct geometricTag {};
+  struct neverTag {};
+  using Exact = lxutil::growth::counting<lxutil::growth::exact, exactTag>;
+  using Geometric = lxutil::growth::counting<lxutil::growth::geometric, geometricTag>;
+  using Never = lxutil::growth::counting<lxutil::growth::nevershrink, neverTag>;
+  using BlockType = typename _Storage::value_type;
+  const unsigned int bitsInBlock = sizeof(BlockType) * 8;
+  const unsigned int nBlocks = 200;
+
+  // the same contents whatever the policy
+  lxutil::dynamicbitstring<_Storage> expect;
+  lxutil::dynamicbitstring<_Storage, Exact> exact;
+  lxutil::dynamicbitstring<_Storage, Geometric> geometric;
+  lxutil::dynamicbitstring<_Storage, Never> never;
+  for( unsigned int i = 0; i < nBlocks * bitsInBlock; i += 7 ) {
+    expect.addBits( i * 2654435761u, 7 );
+    exact.addBits( i * 2654435761u, 7 );
+    geometric.addBits( i * 2654435761u, 7 );
+    never.addBits( i * 2654435761u, 7 );
+  }
+  auto same = [&]( const auto &bits ) {
+    return lxutil::bitstring_view<BlockType>( bits ) == lxutil::bitstring_view<BlockType>( expect );
+  };
+  check_true( "contents", same( exact ) && same( geometric ) && same( never ) ) << std::endl;
+  // a reallocation per block past what storage starts with, against a handful
+  unsigned int initial = lxutil::dynamicbitstring<_Storage>().capacityInBlocks();
+  check_eq( "exact.grows", Exact::counts().grows.load(), exact.sizeInBlocks() - initial ) << std::endl;
+  check_true( "geometric.grows", Geometric::counts().grows.load() < 12 ) << std::endl;
+  check_true( "never.grows", Never::counts().grows.load() < 12 ) << std::endl;
+  check_eq( "exact.capacity", exact.capacityInBlocks(), exact.sizeInBlocks() ) << std::endl;
+
+  // shorter: exact and geometric give memory back, nevershrink keeps it
+  unsigned int geometricCapacity = geometric.capacityInBlocks();
+  unsigned int neverCapacity = never.capacityInBlocks();
+  expect.resize( 3 * bitsInBlock + 5 );
+  exact.resize( 3 * bitsInBlock + 5 );
+  geometric.resize( 3 * bitsInBlock + 5 );
+  never.resize( 3 * bitsInBlock + 5 );
+  check_true( "shorter.contents", same( exact ) && same( geometric ) && same( never ) ) << std::endl;
+  check_true( "exact.shrinks", Exact::counts().shrinks.load() > 0 ) << std::endl;
+  check_true( "geometric.shrinks", (Geometric::counts().shrinks.load() > 0) &&
+                                   (geometric.capacityInBlocks() < geometricCapacity) ) << std::endl;
+  check_eq( "never.shrinks", Never::counts().shrinks.load(), 0 ) << std::endl;
+  check_eq( "never.capacity", never.capacityInBlocks(), neverCapacity ) << std::endl;
+  never.shrink_to_fit();
+  check_true( "shrink_to_fit", never.capacityInBlocks() < neverCapacity && same( never ) ) << std::endl;
+
+  // reserveBits: no reallocation while appending up to it
+  Exact::reset();
+  exact.reserveBits( exact.sizeInBits() + 5000 );
+  uint64_t grows = Exact::counts().grows.load();
+  for( unsigned int i = 0; i < 5000; ++i ) {
+    exact.addBits( i, 1 );
+  }
+  check_eq( "reserveBits.grows", Exact::counts().grows.load(), grows ) << std::endl;
+  check_eq( "reserveBits.counts", Exact::counts().grows.load(), 0 ) << std::endl;
+
+  // clear keeps the capacity, and the string can be used again
+  unsigned int capacity = exact.capacityInBlocks();
+  exact.clear();
+  check_eq( "clear.size", exact.sizeInBits(), 0 ) << std::endl;
+  check_eq( "clear.capacity", exact.capacityInBlocks(), capacity ) << std::endl;
+  exact.addBits( 5, 3 );
+  exact.resize( 40 );
+  check_eq( "clear.reuse", exact.read( 0, 3 ), 5 ) << std::endl;
+  check_eq( "clear.zeroed", exact.countOnes(), 2 ) << std::endl;
+
+  // the runtime constructor reserves what it is asked for
+  lxutil::dynamicbitstring<_Storage> sized( 1000 );
+  check_true( "constructor.reserve", sized.capacityInBits() >= 1000 ) << std::endl;
+  lxutil::dynamicbitstring<_Storage> tiny( 3 );
+  check_true( "constructor.small", (tiny.capacityInBits() >= 3) && (tiny.capacityInBits() < 1000) ) << std::endl;
+}
+
+template<typename _C> void codesTest(const std::string &testname ) {
+  std::cout << "---- codesTest: " << testname << std::endl;
+  using namespace lxutil::codes;
+
+  // the bits of a few codes
+  _C bits;
+  {
+    encoder<_C> e( bits );
+    e.gamma( 1 );
+    e.gamma( 5 );
+    e.delta( 5 );
+    e.rice( 9, 2 );
+    e.leb128( 300 );
+  }
+  check_eq( "size", bits.sizeInBits(), 1 + 5 + 5 + 5 + 16 ) << std::endl;
+  check_eq( "gamma.1", bits.read( 0, 1 ), 1 ) << std::endl;
+  check_eq( "gamma.5", bits.read( 1, 5 ), 0x05 ) << std::endl;   // 00101
+  check_eq( "delta.5", bits.read( 6, 5 ), 0x0D ) << std::endl;   // 011 01
+  check_eq( "rice.9", bits.read( 11, 5 ), 0x05 ) << std::endl;   // 001 01
+  check_eq( "leb128.300", bits.read( 16, 16 ), 0xAC02 ) << std::endl;
+
+  // every code, small and huge values, through the batch calls
+  std::vector<uint64_t> values;
+  uint64_t seed = 7;
+  for( unsigned int i = 0; i < 3000; ++i ) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    values.push_back( (seed >> (i % 64)) | 1 );
+  }
+  values.push_back( ~uint64_t(0) );
+  values.push_back( uint64_t(1) << 63 );
+  values.push_back( 1 );
+  auto roundTrip = [&]<code _Code>( const std::string &name, const std::vector<uint64_t> &in, unsigned int k ) {
+    _C coded;
+    coded.addBits( 3, 2 ); // not at the start of the string
+    check_true( name + ".encode", encode<_Code>( coded, std::span<const uint64_t>( in ), k ) ) << std::endl;
+    std::vector<uint64_t> out( in.size() + 1 );
+    check_eq( name + ".count", decode<_Code>( coded, std::span<uint64_t>( out ), k, 2 ), in.size() ) << std::endl;
+    out.pop_back();
+    check_true( name + ".values", out == in ) << std::endl;
+    lxutil::bitstring_view<typename _C::BlockType> view( coded );
+    std::fill( out.begin(), out.end(), 0 );
+    check_eq( name + ".view", decode<_Code>( view, std::span<uint64_t>( out ), k, 2 ), in.size() ) << std::endl;
+    check_true( name + ".view.values", out == in ) << std::endl;
+  };
+  roundTrip.template operator()<code::Gamma>( "gamma", values, 0 );
+  roundTrip.template operator()<code::Delta>( "delta", values, 0 );
+  roundTrip.template operator()<code::Leb128>( "leb128", values, 0 );
+  std::vector<uint64_t> zeros( values.size() );
+  for( size_t i = 0; i < values.size(); ++i ) {
+    zeros[i] = values[i] - 1;
+  }
+  roundTrip.template operator()<code::Leb128>( "leb128.zero", zeros, 0 );
+  // Rice values near 2^k, and some with unary parts longer than the buffer
+  for( unsigned int k: { 0u, 1u, 5u, 13u, 40u, 63u } ) {
+    std::vector<uint64_t> rice;
+    for( size_t i = 0; i < values.size(); ++i ) {
+      rice.push_back( (values[i] & ((uint64_t(1) << k) - 1 + (uint64_t(1) << k) * 3)) + ( (i % 500 == 0) ? (uint64_t(200) << k) : 0 ) );
+    }
+    roundTrip.template operator()<code::Rice>( "rice." + std::to_string( k ), rice, k );
+  }
+
+  // codes mixed in one stream, with plain fields in between
+  _C mixed;
+  {
+    encoder<_C> e( mixed );
+    for( unsigned int i = 1; i < 500; ++i ) {
+      e.gamma( i );
+      e.put( i, 9 );
+      e.delta( uint64_t(i) << (i % 50) );
+      e.rice( i * 3, 4 );
+      e.leb128( uint64_t(i) << (i % 60) );
+    }
+  }
+  decoder<_C> d( mixed );
+  bool same = true;
+  for( unsigned int i = 1; same && (i < 500); ++i ) {
+    uint64_t g, f, dl, r, l;
+    same = d.gamma( g ) && d.get( f, 9 ) && d.delta( dl ) && d.rice( r, 4 ) && d.leb128( l ) &&
+           (g == i) && (f == i) && (dl == uint64_t(i) << (i % 50)) && (r == i * 3) && (l == uint64_t(i) << (i % 60));
+  }
+  check_true( "mixed", same && d.atEnd() ) << std::endl;
+
+  // what the codes can't take, and codes cut short
+  _C bad;
+  encoder<_C> e( bad );
+  check_false( "gamma.zero", e.gamma( 0 ) ) << std::endl;
+  check_false( "delta.zero", e.delta( 0 ) ) << std::endl;
+  check_false( "rice.k", e.rice( 1, 64 ) ) << std::endl;
+  {
+    _C huge;
+    encoder<_C> h( huge );
+    check_false( "rice.max.k0", h.rice( ~uint64_t(0), 0 ) ) << std::endl;
+    check_false( "rice.big_q", h.rice( uint64_t(1) << 40, 4 ) ) << std::endl;
+    h.flush();
+    check_eq( "rice.rejected.size", huge.sizeInBits(), 0 ) << std::endl;
+    check_true( "rice.max.k63", h.rice( ~uint64_t(0), 63 ) ) << std::endl; // 01 and 63 ones
+    h.flush();
+    uint64_t back = 0;
+    check_true( "rice.max.k63.back", decoder<_C>( huge ).rice( back, 63 ) && (back == ~uint64_t(0)) ) << std::endl;
+  }
+  e.gamma( 1000 );
+  e.leb128( 100000 );
+  e.flush();
+  bad.resize( bad.sizeInBits() - 3 );
+  decoder<_C> cut( bad );
+  uint64_t v = 0;
+  check_true( "cut.first", cut.gamma( v ) && (v == 1000) ) << std::endl;
+  check_false( "cut.leb128", cut.leb128( v ) ) << std::endl;
+  check_false( "cut.end", decoder<_C>( bad, bad.sizeInBits() ).gamma( v ) ) << std::endl;
+
+  check_true( "zigzag", (zigzagEncode( 0 ) == 0) && (zigzagEncode( -1 ) == 1) && (zigzagEncode( 1 ) == 2) &&
+                        (zigzagDecode( zigzagEncode( INT64_MIN ) ) == INT64_MIN) &&
+                        (zigzagDecode( zigzagEncode( INT64_MAX ) ) == INT64_MAX) ) << std::endl;
+}
+
+// 0 to 299, small values far more often
+unsigned int skewedSymbol( uint64_t r ) {
+  return (unsigned int)( (r >> 40) % (1u << ((r >> 20) % 9)) ) % 300;
+}
+
+template<typename _C> void huffmanTest(const std::string &testname ) {
+  std::cout << "---- huffmanTest: " << testname << std::endl;
+
+  // the textbook example: a 45, b 13, c 12, d 16, e 9, f 5
+  lxutil::huffman h;
+  std::vector<uint64_t> freqs = { 45, 13, 12, 16, 9, 5 };
+  check_true( "build", h.build( freqs ) ) << std::endl;
+  const unsigned int lengths[] = { 1, 3, 3, 3, 4, 4 };
+  const uint32_t codes[] = { 0x0, 0x4, 0x5, 0x6, 0xE, 0xF }; // 0, 100, 101, 110, 1110, 1111
+  bool same = true;
+  for( unsigned int s = 0; s < 6; ++s ) {
+    same = same && (h.codeLength( s ) == lengths[s]) && (h.code( s ) == codes[s]);
+  }
+  check_true( "canonical", same ) << std::endl;
+  _C bits;
+  std::vector<uint8_t> word = { 0, 5, 3, 1 };
+  check_true( "encode", h.encode( bits, std::span<const uint8_t>( word ) ) ) << std::endl;
+  check_eq( "encode.size", bits.sizeInBits(), 1 + 4 + 3 + 3 ) << std::endl;
+  check_eq( "encode.bits", bits.read( 0, 11 ), 0x3F4 ) << std::endl; // 0 1111 110 100
+
+  // skewed text, decoded from a decoder that only has the lengths
+  std::vector<uint16_t> text;
+  std::vector<uint64_t> counts( 300, 0 );
+  uint64_t seed = 11;
+  for( unsigned int i = 0; i < 20000; ++i ) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    uint16_t s = uint16_t( skewedSymbol( seed ) );
+    text.push_back( s );
+    ++counts[s];
+  }
+  lxutil::huffman enc;
+  check_true( "text.build", enc.build( counts ) ) << std::endl;
+  _C coded;
+  coded.addBits( 5, 3 ); // not at the start of the string
+  check_true( "text.encode", enc.encode( coded, std::span<const uint16_t>( text ) ) ) << std::endl;
+  lxutil::huffman dec;
+  check_true( "text.assign", dec.assign( enc.lengths() ) ) << std::endl;
+  std::vector<uint16_t> out( text.size() + 1 );
+  check_eq( "text.count", dec.decode( coded, std::span<uint16_t>( out ), 3 ), text.size() ) << std::endl;
+  out.pop_back();
+  check_true( "text.values", out == text ) << std::endl;
+  std::fill( out.begin(), out.end(), 0 );
+  lxutil::bitstring_view<typename _C::BlockType> view( coded );
+  check_eq( "text.view", dec.decode( view, std::span<uint16_t>( out ), 3 ), text.size() ) << std::endl;
+  check_true( "text.view.values", out == text ) << std::endl;
+  std::vector<uint16_t> some( 1001 ); // fewer than there are
+  check_eq( "text.part", dec.decode( coded, std::span<uint16_t>( some ), 3 ), some.size() ) << std::endl;
+  check_true( "text.part.values", std::equal( some.begin(), some.end(), text.begin() ) ) << std::endl;
+
+  // Fibonacci counts make codes as long as there are symbols; limited
+  // to 12 bits they still decode, through the second level tables
+  std::vector<uint64_t> fib( 40 );
+  fib[0] = fib[1] = 1;
+  for( size_t i = 2; i < fib.size(); ++i ) {
+    fib[i] = fib[i - 1] + fib[i - 2];
+  }
+  lxutil::huffman limited;
+  check_true( "limit.build", limited.build( fib, 12 ) ) << std::endl;
+  unsigned int longest = 0;
+  uint64_t space = 0;
+  for( unsigned int s = 0; s < fib.size(); ++s ) {
+    longest = std::max( longest, limited.codeLength( s ) );
+    space += uint64_t(1) << (12 - limited.codeLength( s ));
+  }
+  check_eq( "limit.longest", longest, 12 ) << std::endl;
+  check_true( "limit.kraft", space <= 4096 ) << std::endl;
+  std::vector<uint8_t> all;
+  for( unsigned int i = 0; i < 3000; ++i ) {
+    all.push_back( uint8_t( (i * 7) % 40 ) );
+  }
+  _C limitedBits;
+  limited.encode( limitedBits, std::span<const uint8_t>( all ) );
+  std::vector<uint8_t> allOut( all.size() );
+  check_eq( "limit.count", limited.decode( limitedBits, std::span<uint8_t>( allOut ) ), all.size() ) << std::endl;
+  check_true( "limit.values", allOut == all ) << std::endl;
+  check_false( "limit.too_short", limited.build( fib, 5 ) ) << std::endl;
+  lxutil::staticbitstring<512, std::array<typename _C::BlockType, 4> > full;
+  check_false( "limit.full", limited.encode( full, std::span<const uint8_t>( all ) ) ) << std::endl;
+
+  // one symbol, none, and what isn't a code
+  lxutil::huffman one;
+  std::vector<uint64_t> single( 10, 0 );
+  single[7] = 100;
+  check_true( "single.build", one.build( single ) && (one.codeLength( 7 ) == 1) ) << std::endl;
+  _C singleBits;
+  std::vector<uint8_t> sevens( 50, 7 );
+  one.encode( singleBits, std::span<const uint8_t>( sevens ) );
+  std::vector<uint8_t> sevensOut( 50 );
+  check_true( "single.decode", (one.decode( singleBits, std::span<uint8_t>( sevensOut ) ) == 50) &&
+                               (sevensOut == sevens) ) << std::endl;
+  std::vector<uint8_t> six = { 6 };
+  check_false( "no_code", one.encode( singleBits, std::span<const uint8_t>( six ) ) ) << std::endl;
+  check_eq( "empty", lxutil::huffman().decode( singleBits, std::span<uint8_t>( sevensOut ) ), 0 ) << std::endl;
+  std::vector<uint8_t> notPrefix = { 1, 1, 1 };
+  check_false( "kraft", lxutil::huffman().assign( notPrefix ) ) << std::endl;
+  _C ones;
+  ones.addBits( 0xFF, 8 );
+  check_eq( "invalid", one.decode( ones, std::span<uint8_t>( sevensOut ) ), 0 ) << std::endl;
+  _C stop; // 300 codes, then no code at all
+  std::vector<uint8_t> more( 300, 7 );
+  one.encode( stop, std::span<const uint8_t>( more ) );
+  for( unsigned int i = 0; i < 128; ++i ) {
+    stop.addBits( 0xFF, 8 );
+  }
+  std::vector<uint8_t> stopOut( 400, 0xEE );
+  check_eq( "invalid.count", one.decode( stop, std::span<uint8_t>( stopOut ) ), 300 ) << std::endl;
+  check_true( "invalid.untouched", std::count( stopOut.begin() + 300, stopOut.end(), 0xEE ) == 100 ) << std::endl;
+}
+
 int main() {
   std::cout << "newest version" << std::endl;
   std::array test1 {
@@ -468,6 +2184,141 @@ int main() {
     logicTest("A", a );
   }
 
+  orderTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  orderTest< lxutil::staticbitstring<3000> >( "static" );
+  orderTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+
+  bulkTest< lxutil::dynamicbitstring<> >( "dynamic", test1 );
+  bulkTest< lxutil::staticbitstring<300> >( "static", test1 );
+
+  moreLogicTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  moreLogicTest< lxutil::staticbitstring<10000> >( "static" );
+
+  shiftTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  shiftTest< lxutil::staticbitstring<2000> >( "static" );
+  shiftTest< lxutil::smalldynamicbitstring<> >( "small" );
+
+  appendTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  appendTest< lxutil::staticbitstring<2000> >( "static" );
+  appendTest< lxutil::smalldynamicbitstring<> >( "small" );
+
+  editTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  editTest< lxutil::staticbitstring<2000> >( "static" );
+  editTest< lxutil::smalldynamicbitstring<> >( "small" );
+  editTest< lxutil::pmr_dynamicbitstring<> >( "pmr" );
+
+  {
+    lxutil::staticbitstring<128> a;
+    lxutil::staticbitstring<128> big;
+    while( big.addBits( 0xFFFFFFFF, 32 ) );
+    a.addBits( 5, 32 );
+    check_false( "insert_overflow", a.insert( 3, big ) ) << std::endl;
+    check_eq( "insert_overflow.size", a.sizeInBits(), 32 ) << std::endl;
+    check_eq( "insert_overflow.val", a.read(0,32), 5 ) << std::endl;
+  }
+
+  rankTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  rankTest< lxutil::staticbitstring<100000> >( "static" );
+
+  findTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  findTest< lxutil::staticbitstring<10000> >( "static" );
+
+  hashTest();
+
+  critbitTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  critbitTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  critbitTest< lxutil::staticbitstring<64> >( "static" );
+
+  smallTest();
+  pmrTest();
+
+  viewTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  viewTest< lxutil::staticbitstring<1000> >( "static" );
+  viewTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  streamViewTest();
+
+  serialTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  serialTest< lxutil::staticbitstring<400> >( "static" );
+  serialTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  serialTest< lxutil::smalldynamicbitstring<> >( "small" );
+  serialFormatTest();
+  mappedTest();
+
+  atomicTest<unsigned char>( "8" );
+  atomicTest<unsigned int>( "32" );
+  atomicTest<uint64_t>( "64" );
+  parallelTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  parallelTest< lxutil::dynamicbitstring< std::vector<uint64_t> > >( "64" );
+  compressedTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  compressedTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  exprTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  exprTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  exprTest< lxutil::staticbitstring<8192> >( "static" );
+  codesTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  codesTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  huffmanTest< lxutil::dynamicbitstring<> >( "dynamic" );
+  huffmanTest< lxutil::dynamicbitstring< std::vector<unsigned char> > >( "bytes" );
+  growthTest< std::vector<unsigned int> >( "dynamic" );
+  growthTest< std::vector<uint64_t> >( "64" );
+  growthTest< lxutil::inlineblocks<unsigned int, 4> >( "small" );
+  {
+    lxutil::staticbitstring<256> s;
+    s.addBits( 0xAB, 8 );
+    check_true( "static.reserveBits", s.reserveBits( s.capacityInBits() ) ) << std::endl;
+    check_false( "static.reserveBits.over", s.reserveBits( s.capacityInBits() + 1 ) ) << std::endl;
+    s.clear();
+    s.addBits( 1, 1 );
+    check_true( "static.clear", (s.sizeInBits() == 1) && (s.read( 0, 1 ) == 1) ) << std::endl;
+  }
+
+  using Wide64 = lxutil::dynamicbitstring< std::vector<uint64_t> >;
+  wideTest< Wide64 >( "64" );
+  moreLogicTest< Wide64 >( "64" );
+  shiftTest< Wide64 >( "64" );
+  appendTest< Wide64 >( "64" );
+  editTest< Wide64 >( "64" );
+  rankTest< Wide64 >( "64" );
+  findTest< Wide64 >( "64" );
+  critbitTest< Wide64 >( "64" );
+  orderTest< Wide64 >( "64" );
+  viewTest< Wide64 >( "64" );
+  serialTest< Wide64 >( "64" );
+  compressedTest< Wide64 >( "64" );
+  exprTest< Wide64 >( "64" );
+  codesTest< Wide64 >( "64" );
+  huffmanTest< Wide64 >( "64" );
+  cursorTest< Wide64 >( "64", test1 );
+#ifdef __SIZEOF_INT128__
+  using Wide128 = lxutil::dynamicbitstring< std::vector<unsigned __int128> >;
+  wideTest< Wide128 >( "128" );
+  moreLogicTest< Wide128 >( "128" );
+  shiftTest< Wide128 >( "128" );
+  appendTest< Wide128 >( "128" );
+  editTest< Wide128 >( "128" );
+  rankTest< Wide128 >( "128" );
+  findTest< Wide128 >( "128" );
+  critbitTest< Wide128 >( "128" );
+  orderTest< Wide128 >( "128" );
+  viewTest< Wide128 >( "128" );
+  serialTest< Wide128 >( "128" );
+  compressedTest< Wide128 >( "128" );
+  exprTest< Wide128 >( "128" );
+  codesTest< Wide128 >( "128" );
+  huffmanTest< Wide128 >( "128" );
+  cursorTest< Wide128 >( "128", test1 );
+#endif
+
+  cursorTest< lxutil::dynamicbitstring<> >( "dynamic", test1 );
+  cursorTest< lxutil::staticbitstring<300> >( "static", test1 );
+
+  {
+    lxutil::staticbitstring<64> a;
+    std::vector<unsigned int> values( 100, 0xFFFFFFFF );
+    a.addBits( 1, 1 );
+    check_false( "bulk_overflow", a.addBits( values, 32 ) ) << std::endl;
+    check_eq( "bulk_overflow.size", a.sizeInBits(), 1 ) << std::endl;
+  }
+
   if( allPass ) {
     std::cout << "### OVERALL: PASS ###" << std::endl;
     return 0;